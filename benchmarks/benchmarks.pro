@@ -0,0 +1,27 @@
+#-------------------------------------------------
+#
+# Benchmarks of the QtDropbox JSON classes
+#
+#-------------------------------------------------
+
+QT       += network testlib
+QT       -= gui
+
+TARGET = qtdropboxbenchmark
+CONFIG   += console C++11
+CONFIG   -= app_bundle
+
+TEMPLATE = app
+
+SOURCES += \
+    qtdropboxbenchmark.cpp
+
+HEADERS += \
+    qtdropboxbenchmark.hpp
+
+# link against the library built by qtdropbox.pro
+LIBS += -L$$OUT_PWD/..
+QMAKE_RPATHDIR += $$OUT_PWD/..
+INCLUDEPATH += $$PWD/../src/
+
+include(../libqtdropbox.pri)
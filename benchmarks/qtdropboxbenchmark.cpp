@@ -0,0 +1,386 @@
+#include "qtdropboxbenchmark.hpp"
+
+#include <cstdlib>
+#include <new>
+
+/*
+ * Heap allocations are counted by replacing the allocator of the process. With
+ * glibc malloc() itself is interposed, so the data of Qt containers (which is
+ * allocated with malloc) is counted as well. Other C libraries only count
+ * operator new.
+ */
+static bool   countAllocations = false;
+static qint64 allocationCount  = 0;
+
+#if defined(__GLIBC__)
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t count, size_t size);
+extern "C" void *__libc_realloc(void *ptr, size_t size);
+
+extern "C" void *malloc(size_t size)
+{
+    if(countAllocations)
+        allocationCount++;
+    return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t count, size_t size)
+{
+    if(countAllocations)
+        allocationCount++;
+    return __libc_calloc(count, size);
+}
+
+extern "C" void *realloc(void *ptr, size_t size)
+{
+    if(countAllocations)
+        allocationCount++;
+    return __libc_realloc(ptr, size);
+}
+#else
+void *operator new(size_t size)
+{
+    if(countAllocations)
+        allocationCount++;
+    void *ptr = std::malloc(size == 0? 1 : size);
+    if(ptr == NULL)
+        throw std::bad_alloc();
+    return ptr;
+}
+
+void operator delete(void *ptr) noexcept
+{
+    std::free(ptr);
+}
+#endif
+
+static const char *MODIFIED = "Tue, 19 Jul 2011 21:55:38 +0000";
+
+/*!
+ * Metadata of a single file as sent by the Dropbox API.
+ */
+static QString fileJson(QString path, qint64 bytes, int revision)
+{
+    return QString("{\"size\": \"%1 KB\", \"rev\": \"%2\", \"thumb_exists\": false, "
+                   "\"bytes\": %3, \"modified\": \"%4\", \"client_mtime\": \"%4\", "
+                   "\"path\": \"%5\", \"is_dir\": false, \"icon\": \"page_white_text\", "
+                   "\"root\": \"dropbox\", \"mime_type\": \"text/plain\", \"revision\": %6}")
+            .arg(bytes/1024)
+            .arg(QString("%1%2").arg(revision, 0, 16).arg("0c6d6f2b"))
+            .arg(bytes)
+            .arg(MODIFIED)
+            .arg(path)
+            .arg(revision);
+}
+
+static QString listingPayload(int entries)
+{
+    QString json = QString("{\"hash\": \"37eb1ba1849d4b0fb0b28caf7ef3af52\", \"thumb_exists\": false, "
+                           "\"bytes\": 0, \"path\": \"/Projects\", \"is_dir\": true, \"icon\": \"folder\", "
+                           "\"root\": \"dropbox\", \"size\": \"0 bytes\", \"rev\": \"714f029684fe\", "
+                           "\"modified\": \"%1\", \"revision\": 29007, \"contents\": [").arg(MODIFIED);
+    for(int i=0; i<entries; ++i)
+    {
+        if(i > 0)
+            json += ", ";
+        json += fileJson(QString("/Projects/report %1.txt").arg(i), 1024 + i*37, i+1);
+    }
+    json += "]}";
+    return json;
+}
+
+static QString deltaPayload(int entries)
+{
+    QString json = "{\"entries\": [";
+    for(int i=0; i<entries; ++i)
+    {
+        QString path = QString("/Projects/Delta/file %1.txt").arg(i);
+        if(i > 0)
+            json += ", ";
+        // every tenth entry was deleted
+        json += QString("[\"%1\", %2]").arg(path.toLower())
+                .arg(i%10 == 9? QString("null") : fileJson(path, 2048 + i*13, i+1));
+    }
+    json += "], \"reset\": false, \"cursor\": \"AAGCw9SbEa0UN1WAjFo3qDRl4IkTLFpBvtI6QoKmmyQlrf\", "
+            "\"has_more\": true}";
+    return json;
+}
+
+static QString revisionsPayload(int revisions)
+{
+    QString json = "[";
+    for(int i=revisions; i>0; --i)
+    {
+        if(i < revisions)
+            json += ", ";
+        json += fileJson("/Projects/report.txt", 4096 + i*11, i);
+    }
+    json += "]";
+    return json;
+}
+
+/*!
+ * Parses a payload into the classes QDropbox hands to the application and
+ * returns the number of entries found.
+ */
+static int parseDocument(int type, const QString &payload)
+{
+    switch(type)
+    {
+    case QtDropboxBenchmark::Listing:
+    {
+        QDropboxFileInfo info(payload);
+        return info.contents().size();
+    }
+    case QtDropboxBenchmark::Delta:
+    {
+        QDropboxDeltaResponse delta(payload);
+        return delta.getEntries().size();
+    }
+    case QtDropboxBenchmark::Revisions:
+    {
+        QDropboxJson json(payload);
+        QList<QDropboxJson> list = json.getJsonArray();
+        QList<QDropboxFileInfo> revisions;
+        for(int i=0; i<list.size(); ++i)
+            revisions.append(QDropboxFileInfo(list.at(i)));
+        return revisions.size();
+    }
+    default:
+        return 0;
+    }
+}
+
+/*!
+ * Reads all fields of a file's metadata.
+ */
+static qint64 readFields(QDropboxFileInfo &info)
+{
+    qint64 sum = info.bytes() + info.revision();
+    sum += info.size().size() + info.icon().size() + info.root().size();
+    sum += info.path().size() + info.mimeType().size() + info.revisionHash().size();
+    sum += info.modified().toMSecsSinceEpoch() + info.clientModified().toMSecsSinceEpoch();
+    sum += info.isDir() + info.isDeleted() + info.thumbExists();
+    return sum;
+}
+
+QtDropboxBenchmark::QtDropboxBenchmark()
+{
+}
+
+void QtDropboxBenchmark::initTestCase()
+{
+    _payloads["listing 10"]    = listingPayload(10);
+    _payloads["listing 1k"]    = listingPayload(1000);
+    _payloads["listing 100k"]  = listingPayload(100000);
+    _payloads["delta 2k"]      = deltaPayload(2000);
+    _payloads["revisions 100"] = revisionsPayload(100);
+
+    // check that the payloads are understood before measuring them
+    QVERIFY(parseDocument(Listing, _payloads["listing 1k"]) == 1000);
+    QVERIFY(parseDocument(Delta, _payloads["delta 2k"]) == 2000);
+    QVERIFY(parseDocument(Revisions, _payloads["revisions 100"]) == 100);
+    return;
+}
+
+void QtDropboxBenchmark::addPayloadRows()
+{
+    QTest::addColumn<int>("type");
+    QTest::addColumn<QString>("payload");
+
+    QTest::newRow("listing 10")    << int(Listing)   << "listing 10";
+    QTest::newRow("listing 1k")    << int(Listing)   << "listing 1k";
+    QTest::newRow("listing 100k")  << int(Listing)   << "listing 100k";
+    QTest::newRow("delta 2k")      << int(Delta)     << "delta 2k";
+    QTest::newRow("revisions 100") << int(Revisions) << "revisions 100";
+    return;
+}
+
+void QtDropboxBenchmark::parse_data()
+{
+    addPayloadRows();
+}
+
+/**
+ * @brief Time to parse a document and release it again.
+ */
+void QtDropboxBenchmark::parse()
+{
+    QFETCH(int, type);
+    QFETCH(QString, payload);
+    const QString &json = _payloads[payload];
+
+    int entries = 0;
+    QBENCHMARK { entries = parseDocument(type, json); }
+    QVERIFY(entries > 0);
+    return;
+}
+
+void QtDropboxBenchmark::throughput_data()
+{
+    addPayloadRows();
+}
+
+/**
+ * @brief Parsed UTF-8 bytes per second.
+ * Reported with the BytesPerSecond metric, divide by 10^6 for MB/s.
+ */
+void QtDropboxBenchmark::throughput()
+{
+    QFETCH(int, type);
+    QFETCH(QString, payload);
+    const QString &json = _payloads[payload];
+    qint64 bytes = json.toUtf8().size();
+
+    QElapsedTimer timer;
+    int iterations = 0;
+    timer.start();
+    do
+    {
+        parseDocument(type, json);
+        iterations++;
+    } while(iterations < 3 || timer.elapsed() < 500);
+    qint64 nsecs = qMax(qint64(1), timer.nsecsElapsed());
+
+    QTest::setBenchmarkResult(qreal(bytes)*iterations*1e9/nsecs, QTest::BytesPerSecond);
+    return;
+}
+
+void QtDropboxBenchmark::allocations_data()
+{
+    addPayloadRows();
+}
+
+/**
+ * @brief Heap allocations while parsing and releasing one document.
+ * Reported with the Events metric.
+ */
+void QtDropboxBenchmark::allocations()
+{
+    QFETCH(int, type);
+    QFETCH(QString, payload);
+    const QString &json = _payloads[payload];
+
+    // the first run may initialize static data
+    parseDocument(type, json);
+
+    allocationCount  = 0;
+    countAllocations = true;
+    parseDocument(type, json);
+    countAllocations = false;
+
+    QTest::setBenchmarkResult(allocationCount, QTest::Events);
+    return;
+}
+
+void QtDropboxBenchmark::getters_data()
+{
+    addPayloadRows();
+}
+
+/**
+ * @brief Time to read all fields of every entry of a parsed document.
+ */
+void QtDropboxBenchmark::getters()
+{
+    QFETCH(int, type);
+    QFETCH(QString, payload);
+    const QString &json = _payloads[payload];
+
+    qint64 sum = 0;
+    switch(type)
+    {
+    case Listing:
+    {
+        QDropboxFileInfo info(json);
+        QBENCHMARK
+        {
+            QList<QDropboxFileInfo> contents = info.contents();
+            for(int i=0; i<contents.size(); ++i)
+                sum += readFields(contents[i]);
+        }
+        break;
+    }
+    case Delta:
+    {
+        QDropboxDeltaResponse delta(json);
+        QBENCHMARK
+        {
+            const QDropboxDeltaEntryMap entries = delta.getEntries();
+            for(QDropboxDeltaEntryMap::const_iterator i = entries.begin(); i != entries.end(); ++i)
+            {
+                if(!i.value().isNull())
+                    sum += readFields(*i.value());
+            }
+        }
+        break;
+    }
+    case Revisions:
+    {
+        QDropboxJson document(json);
+        QList<QDropboxJson> list = document.getJsonArray();
+        QList<QDropboxFileInfo> revisions;
+        for(int i=0; i<list.size(); ++i)
+            revisions.append(QDropboxFileInfo(list.at(i)));
+        QBENCHMARK
+        {
+            for(int i=0; i<revisions.size(); ++i)
+                sum += readFields(revisions[i]);
+        }
+        break;
+    }
+    }
+    QVERIFY(sum != 0);
+    return;
+}
+
+void QtDropboxBenchmark::copy_data()
+{
+    addPayloadRows();
+}
+
+/**
+ * @brief Time to copy a parsed document.
+ * Listings are copied as QDropboxFileInfo, delta pages as QDropboxDeltaResponse
+ * and revision lists as QDropboxJson. Only the copy is timed, the last copy is
+ * checked after the measurement.
+ */
+void QtDropboxBenchmark::copy()
+{
+    QFETCH(int, type);
+    QFETCH(QString, payload);
+    const QString &json = _payloads[payload];
+
+    int entries = 0;
+    switch(type)
+    {
+    case Listing:
+    {
+        QDropboxFileInfo info(json);
+        QDropboxFileInfo copy;
+        QBENCHMARK { copy = info; }
+        entries = copy.contents().size();
+        break;
+    }
+    case Delta:
+    {
+        QDropboxDeltaResponse delta(json);
+        QDropboxDeltaResponse copy;
+        QBENCHMARK { copy = delta; }
+        entries = copy.getEntries().size();
+        break;
+    }
+    case Revisions:
+    {
+        QDropboxJson document(json);
+        QDropboxJson copy;
+        QBENCHMARK { copy = document; }
+        entries = copy.isValid()? 1 : 0;
+        break;
+    }
+    }
+    QVERIFY(entries > 0);
+    return;
+}
+
+QTEST_GUILESS_MAIN(QtDropboxBenchmark)
@@ -0,0 +1,51 @@
+#ifndef QTDROPBOXBENCHMARK_H
+#define QTDROPBOXBENCHMARK_H
+
+#include <QtTest>
+#include "qtdropbox.h"
+
+class QtDropboxBenchmark : public QObject
+{
+    Q_OBJECT
+
+public:
+    //! Kinds of generated payloads
+    enum PayloadType
+    {
+        Listing,   //!< metadata of a folder, parsed into QDropboxFileInfo
+        Delta,     //!< delta page, parsed into QDropboxDeltaResponse
+        Revisions  //!< revision list, parsed into QDropboxJson and QDropboxFileInfo
+    };
+
+    QtDropboxBenchmark();
+
+private Q_SLOTS:
+    void initTestCase();
+
+  /* wall time to parse and release a document */
+    void parse_data();
+    void parse();
+
+  /* parsed bytes per second */
+    void throughput_data();
+    void throughput();
+
+  /* heap allocations while parsing one document */
+    void allocations_data();
+    void allocations();
+
+  /* reading all fields of a parsed document */
+    void getters_data();
+    void getters();
+
+  /* copying a parsed document */
+    void copy_data();
+    void copy();
+
+private:
+    void addPayloadRows();
+
+    QMap<QString,QString> _payloads;
+};
+
+#endif // QTDROPBOXBENCHMARK_H
@@ -5,9 +5,13 @@ HEADERS += qtdropbox_global.h\
            qdropbox.h \
            qtdropbox.h \
            qdropboxjson.h \
+           qdropboxjsonarena.h \
            qdropboxaccount.h \
            qdropboxfile.h \
+           qdropboxfilebuffer.h \
            qdropboxfileinfo.h \
-           qdropboxdeltaresponse.h
+           qdropboxdeltaresponse.h \
+           qdropboxstatistics.h \
+           qdropboxtracer.h
 
 CONFIG += network
@@ -1,4 +1,5 @@
-OTHER_FILES += libqtdropbox.pri
+OTHER_FILES += libqtdropbox.pri \
+               benchmarks/benchmarks.pro
 
 !unix {
     target.path = lib/
@@ -14,6 +15,16 @@ unix {
 documentation.commands = doxygen doc/doxygen.conf
 QMAKE_EXTRA_TARGETS += documentation
 
+#-------------------------------------------------
+# Benchmark target
+#-------------------------------------------------
+# built in the benchmarks directory of the build tree, so shadow builds work
+benchmark.commands = $(MKDIR) $$OUT_PWD/benchmarks && cd $$OUT_PWD/benchmarks && \
+                     $(QMAKE) $$PWD/benchmarks/benchmarks.pro && $(MAKE) && \
+                     ./qtdropboxbenchmark -o benchmark.xml,xml -o -,txt
+benchmark.depends = all
+QMAKE_EXTRA_TARGETS += benchmark
+
 #-------------------------------------------------
 # Package target
 #-------------------------------------------------
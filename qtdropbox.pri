@@ -5,19 +5,27 @@ INCLUDEPATH += $$PWD/src
 SOURCES += \
     $$PWD/src/qdropbox.cpp \
     $$PWD/src/qdropboxjson.cpp \
+    $$PWD/src/qdropboxjsonarena.cpp \
     $$PWD/src/qdropboxaccount.cpp \
     $$PWD/src/qdropboxfile.cpp \
+    $$PWD/src/qdropboxfilebuffer.cpp \
     $$PWD/src/qdropboxfileinfo.cpp \
-    $$PWD/src/qdropboxdeltaresponse.cpp
+    $$PWD/src/qdropboxdeltaresponse.cpp \
+    $$PWD/src/qdropboxstatistics.cpp \
+    $$PWD/src/qdropboxtracer.cpp
 
 HEADERS += \
     $$PWD/src/qtdropbox_global.h \
     $$PWD/src/qdropbox.h \
     $$PWD/src/qdropboxjson.h \
+    $$PWD/src/qdropboxjsonarena.h \
     $$PWD/src/qdropboxaccount.h \
     $$PWD/src/qdropboxfile.h \
+    $$PWD/src/qdropboxfilebuffer.h \
     $$PWD/src/qtdropbox.h \
     $$PWD/src/qdropboxfileinfo.h \
-    $$PWD/src/qdropboxdeltaresponse.h
+    $$PWD/src/qdropboxdeltaresponse.h \
+    $$PWD/src/qdropboxstatistics.h \
+    $$PWD/src/qdropboxtracer.h
 
 CONFIG += network
@@ -16,20 +16,28 @@ DEFINES += QTDROPBOX_LIBRARY
 SOURCES += \
     src/qdropbox.cpp \
     src/qdropboxjson.cpp \
+    src/qdropboxjsonarena.cpp \
     src/qdropboxaccount.cpp \
     src/qdropboxfile.cpp \
+    src/qdropboxfilebuffer.cpp \
     src/qdropboxfileinfo.cpp \
-    src/qdropboxdeltaresponse.cpp
+    src/qdropboxdeltaresponse.cpp \
+    src/qdropboxstatistics.cpp \
+    src/qdropboxtracer.cpp
 
 HEADERS += \
     src/qtdropbox_global.h \
     src/qdropbox.h \
     src/qdropboxjson.h \
+    src/qdropboxjsonarena.h \
     src/qdropboxaccount.h \
     src/qdropboxfile.h \
+    src/qdropboxfilebuffer.h \
     src/qtdropbox.h \
     src/qdropboxfileinfo.h \
-    src/qdropboxdeltaresponse.h
+    src/qdropboxdeltaresponse.h \
+    src/qdropboxstatistics.h \
+    src/qdropboxtracer.h
 
 TARGET = QtDropbox
 
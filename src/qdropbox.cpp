@@ -1,5 +1,12 @@
 #include "qdropbox.h"
 
+#include <climits>
+#include <QVarLengthArray>
+#include <QElapsedTimer>
+#if QT_VERSION >= QT_VERSION_CHECK(5, 10, 0)
+#include <QRandomGenerator>
+#endif
+
 QDropbox::QDropbox(QObject *parent) :
     QObject(parent),
     conManager(this)
@@ -8,24 +15,11 @@ QDropbox::QDropbox(QObject *parent) :
     qDebug() << "creating dropbox api" << endl;
 #endif
 
-    errorState = QDropbox::NoError;
-    errorText  = "";
+    _init();
     setApiVersion("1.0");
     setApiUrl("api.dropbox.com");
+    setContentUrl("api-content.dropbox.com");
     setAuthMethod(QDropbox::Plaintext);
-
-    oauthToken = "";
-    oauthTokenSecret = "";
-
-    lastreply = 0;
-
-    connect(&conManager, SIGNAL(finished(QNetworkReply*)), this, SLOT(networkReplyFinished(QNetworkReply*)));
-
-    // needed for nonce generation
-    qsrand(QDateTime::currentMSecsSinceEpoch());
-
-    _evLoop = NULL;
-	_saveFinishedRequests = false;
 }
 
 QDropbox::QDropbox(QString key, QString sharedSecret, OAuthMethod method, QString url, QObject *parent) :
@@ -36,26 +30,72 @@ QDropbox::QDropbox(QString key, QString sharedSecret, OAuthMethod method, QStrin
     qDebug() << "creating api with key, shared secret and method" << endl;
 #endif
 
-    errorState      = QDropbox::NoError;
-    errorText       = "";
+    _init();
     setKey(key);
     setSharedSecret(sharedSecret);
     setAuthMethod(method);
     setApiVersion("1.0");
     setApiUrl(url);
+    setContentUrl("api-content.dropbox.com");
+}
+
+QDropbox::~QDropbox()
+{
+    // replies are deleted with the network access manager after this
+    // object is gone already
+    QList<QNetworkReply*> running = _replyHostMap.keys();
+    for(int i=0; i<running.size(); ++i)
+        disconnect(running.at(i), 0, this, 0);
 
-    oauthToken = "";
+    // do not leave anybody waiting on a future that will never finish
+    QList<int> pending = _completionMap.keys();
+    for(int i=0; i<pending.size(); ++i)
+        _completionMap.take(pending.at(i))(QDropboxJson());
+}
+
+void QDropbox::_init()
+{
+    errorState = QDropbox::NoError;
+    errorText  = "";
+
+    oauthToken       = "";
     oauthTokenSecret = "";
 
     lastreply = 0;
 
-    connect(&conManager, SIGNAL(finished(QNetworkReply*)), this, SLOT(networkReplyFinished(QNetworkReply*)));
-
-    // needed for nonce generation
+#if QT_VERSION < QT_VERSION_CHECK(5, 10, 0)
+    // generateNonce() falls back to qrand() without QRandomGenerator
     qsrand(QDateTime::currentMSecsSinceEpoch());
+#endif
 
-    _evLoop = NULL;
-	_saveFinishedRequests = false;
+    _historySize = 0;
+    _historyNext = 0;
+    _tracer      = NULL;
+    connect(&_statisticsTimer, &QTimer::timeout, this, &QDropbox::reportStatistics);
+    _signing.valid         = false;
+    _maxConnectionsPerHost = 6;
+    _requestPriority       = QDropbox::NormalPriority;
+
+    _maxRetries       = 5;
+    _retryBaseDelay   = 1000;
+    _retryCount       = 0;
+    _retryBackoffTime = 0;
+    _requestRate      = 0;
+    _requestRateMax   = 0;
+    _bucketTokens     = 0;
+    _bucketUpdated    = 0;
+    _rateChanged      = 0;
+    _rateWindowStart  = 0;
+    _rateWindowCount  = 0;
+    _lastWindowCount  = 0;
+    _bucketTimer.setSingleShot(true);
+    connect(&_bucketTimer, &QTimer::timeout, this, &QDropbox::processPendingRequests);
+
+    _metadataCache.setMaxCost(1000);
+    _metadataCacheTtl    = 0;
+    _metadataCacheHits   = 0;
+    _metadataCacheMisses = 0;
+    return;
 }
 
 QDropbox::Error QDropbox::error()
@@ -70,7 +110,12 @@ QString QDropbox::errorString()
 
 void QDropbox::setApiUrl(QString url)
 {
-    apiurl.setUrl(QString("//%1").arg(url));
+    // a URL with scheme (e.g. http://127.0.0.1:8080 for a local test server)
+    // is taken as it is, a plain host name is accessed via https
+    if(url.contains("://"))
+        apiurl.setUrl(url);
+    else
+        apiurl.setUrl(QString("//%1").arg(url));
     prepareApiUrl();
     return;
 }
@@ -80,6 +125,23 @@ QString QDropbox::apiUrl()
     return apiurl.toString();
 }
 
+void QDropbox::setContentUrl(QString url)
+{
+    if(url.contains("://"))
+        contenturl.setUrl(url);
+    else
+        contenturl.setUrl(QString("//%1").arg(url));
+
+    if(contenturl.scheme().isEmpty())
+        contenturl.setScheme("https");
+    return;
+}
+
+QString QDropbox::contentUrl()
+{
+    return contenturl.toString();
+}
+
 void QDropbox::setAuthMethod(OAuthMethod m)
 {
     oauthMethod = m;
@@ -131,47 +193,49 @@ void QDropbox::requestFinished(int nr, QNetworkReply *rply)
         errorState = QDropbox::BadInput;
         errorText  = "";
         emit errorOccured(errorState);
-        checkReleaseEventLoop(nr);
+        requestFailed(nr);
         return;
         break;
     case QDROPBOX_ERROR_EXPIRED_TOKEN:
         errorState = QDropbox::TokenExpired;
         errorText  = "";
         emit tokenExpired();
-        checkReleaseEventLoop(nr);
+        requestFailed(nr);
         return;
         break;
     case QDROPBOX_ERROR_BAD_OAUTH_REQUEST:
         errorState = QDropbox::BadOAuthRequest;
         errorText  = "";
         emit errorOccured(errorState);
-        checkReleaseEventLoop(nr);
+        requestFailed(nr);
         return;
         break;
     case QDROPBOX_ERROR_FILE_NOT_FOUND:
+        // reported by fileNotFound(), the waiting caller only gets no result
+        clearError();
         emit fileNotFound();
-        checkReleaseEventLoop(nr);
+        requestFailed(nr);
         return;
         break;
     case QDROPBOX_ERROR_WRONG_METHOD:
         errorState = QDropbox::WrongHttpMethod;
         errorText  = "";
         emit errorOccured(errorState);
-        checkReleaseEventLoop(nr);
+        requestFailed(nr);
         return;
         break;
     case QDROPBOX_ERROR_REQUEST_CAP:
         errorState = QDropbox::MaxRequestsExceeded;
         errorText = "";
         emit errorOccured(errorState);
-        checkReleaseEventLoop(nr);
+        requestFailed(nr);
         return;
         break;
     case QDROPBOX_ERROR_USER_OVER_QUOTA:
         errorState = QDropbox::UserOverQuota;
         errorText = "";
         emit errorOccured(errorState);
-        checkReleaseEventLoop(nr);
+        requestFailed(nr);
         return;
         break;
     default:
@@ -187,7 +251,7 @@ void QDropbox::requestFinished(int nr, QNetworkReply *rply)
         qDebug() << "error " << errorState << "(" << errorText << ") in request" << endl;
 #endif
         emit errorOccured(errorState);
-		checkReleaseEventLoop(nr);
+		requestFailed(nr);
         return;
     }
 
@@ -215,7 +279,7 @@ void QDropbox::requestFinished(int nr, QNetworkReply *rply)
         qDebug() << "new url: " << newlocation.toString() << endl;
 #endif
         int oldnr = nr;
-        nr = sendRequest(newlocation, requestMap[nr].method, 0, requestMap[nr].host);
+        nr = sendRequest(newlocation, requestMap[nr].method, 0, requestMap[nr].host, false);
         requestMap[nr].type = QDROPBOX_REQ_REDIREC;
         requestMap[nr].linked = oldnr;
         return;
@@ -224,16 +288,27 @@ void QDropbox::requestFinished(int nr, QNetworkReply *rply)
     {
         if(requestMap[nr].type == QDROPBOX_REQ_REDIREC)
         {
-            // change values if this is the answert to a redirect
+            // the answer to the redirect is the answer to the original request
             qdropbox_request redir = requestMap[nr];
-            qdropbox_request orig  = requestMap[redir.linked];
-            requestMap[nr] = orig;
+            qdropbox_request &orig = requestMap[redir.linked];
+            orig.status         = redir.status;
+            orig.finished       = redir.finished;
+            orig.bytesReceived += redir.bytesReceived;
 			removeRequestFromMap(nr);
             nr = redir.linked;
         }
 
-        // standard handling depending on message type
-        switch(requestMap[nr].type)
+        QElapsedTimer parseTimer;
+        parseTimer.start();
+        QDropboxTraceSpan parseSpan(_tracer, "parse", "QDropbox", nr);
+        if(tracing())
+            _tracer->flow('t', "QDropbox", nr);
+
+        // conditional requests that were answered with 304 are served from
+        // the cache, otherwise standard handling depending on message type
+        if(rply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() == QDROPBOX_NOT_MODIFIED)
+            responseNotModified(nr);
+        else switch(requestMap[nr].type)
         {
         case QDROPBOX_REQ_CONNECT:
             // was only a connect request - so drop it
@@ -243,7 +318,7 @@ void QDropbox::requestFinished(int nr, QNetworkReply *rply)
             responseTokenRequest(response);
             break;
         case QDROPBOX_REQ_RQBTOKN:
-            responseBlockedTokenRequest(response);
+            responseBlockedTokenRequest(response, nr);
             break;
         case QDROPBOX_REQ_AULOGIN:
             delayed_nr = responseDropboxLogin(response, nr);
@@ -253,37 +328,37 @@ void QDropbox::requestFinished(int nr, QNetworkReply *rply)
             responseAccessToken(response);
             break;
         case QDROPBOX_REQ_METADAT:
-            parseMetadata(response);
+            parseMetadata(response, nr);
             break;
         case QDROPBOX_REQ_BMETADA:
-            parseBlockingMetadata(response);
+            parseBlockingMetadata(response, nr);
 			break;
         case QDROPBOX_REQ_BACCTOK:
-            responseBlockingAccessToken(response);
+            responseBlockingAccessToken(response, nr);
             break;
         case QDROPBOX_REQ_ACCINFO:
-            parseAccountInfo(response);
+            parseAccountInfo(response, nr);
             break;
         case QDROPBOX_REQ_BACCINF:
-            parseBlockingAccountInfo(response);
+            parseBlockingAccountInfo(response, nr);
             break;
         case QDROPBOX_REQ_SHRDLNK:
-            parseSharedLink(response);
+            parseSharedLink(response, nr);
             break;
         case QDROPBOX_REQ_BSHRDLN:
-            parseBlockingSharedLink(response);
+            parseBlockingSharedLink(response, nr);
             break;
 		case QDROPBOX_REQ_REVISIO:
-			parseRevisions(response);
+			parseRevisions(response, nr);
 			break;
 		case QDROPBOX_REQ_BREVISI:
-			parseBlockingRevisions(response);
+			parseBlockingRevisions(response, nr);
 			break;
         case QDROPBOX_REQ_DELTA:
-            parseDelta(response);
+            parseDelta(response, nr);
             break;
         case QDROPBOX_REQ_BDELTA:
-            parseBlockingDelta(response);
+            parseBlockingDelta(response, nr);
             break;
         default:
             errorState  = QDropbox::ResponseToUnknownRequest;
@@ -291,12 +366,22 @@ void QDropbox::requestFinished(int nr, QNetworkReply *rply)
             emit errorOccured(errorState);
             break;
         }
+
+        if(requestMap.contains(nr))
+            requestMap[nr].parseTime += parseTimer.nsecsElapsed()/1000;
+
+        // release callers whose response could not be parsed
+        checkReleaseEventLoop(nr);
     }
 
     if(delayed_finish)
         delayMap[delayed_nr] = nr;
     else
     {
+        QDropboxTraceSpan emitSpan(_tracer, "emit", "QDropbox", nr);
+        if(tracing())
+            _tracer->flow('f', "QDropbox", nr);
+
         if(delayMap[nr])
         {
             int drq = delayMap[nr];
@@ -310,6 +395,14 @@ void QDropbox::requestFinished(int nr, QNetworkReply *rply)
 
 		removeRequestFromMap(nr);
         emit operationFinished(nr);
+
+        // requests coalesced into this one are finished with it
+        QList<int> coalesced = _coalescedMap.value(nr);
+        for(int i=0; i<coalesced.size(); ++i)
+        {
+            removeRequestFromMap(coalesced.at(i));
+            emit operationFinished(coalesced.at(i));
+        }
     }
 
     return;
@@ -320,53 +413,168 @@ void QDropbox::networkReplyFinished(QNetworkReply *rply)
 #ifdef QTDROPBOX_DEBUG
     qDebug() << "reply finished" << endl;
 #endif
-    int reqnr = replynrMap[rply];
+    int reqnr = replynrMap.take(rply);
+    if(tracing())
+        _tracer->asyncEnd("network", "QDropbox", reqnr);
+    if(requestMap.contains(reqnr))
+    {
+        requestMap[reqnr].status        = rply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+        requestMap[reqnr].bytesReceived = rply->bytesAvailable();
+        requestMap[reqnr].finished      = QDateTime::currentMSecsSinceEpoch();
+    }
+
+    // throttled requests are sent again after a backoff delay
+    if(rply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() == QDROPBOX_ERROR_REQUEST_CAP
+       && retryRequest(reqnr, rply))
+    {
+        rply->deleteLater();
+        return;
+    }
+
+    // a listing that left the cache while it was revalidated is requested again
+    if(rply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() == QDROPBOX_NOT_MODIFIED
+       && resendUncachedMetadata(reqnr, rply))
+    {
+        rply->deleteLater();
+        return;
+    }
+
+    // the answer to a redirect answers the request it was forwarded from
+    int origin = reqnr;
+    if(requestMap.contains(reqnr) && requestMap[reqnr].type == QDROPBOX_REQ_REDIREC)
+        origin = requestMap[reqnr].linked;
+    bool answered = (rply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() != 302);
+
+    // identical requests sent from now on need a reply of their own
+    QString key = _inflightMap.key(origin);
+    if(answered && !key.isNull())
+        _inflightMap.remove(key);
+
     requestFinished(reqnr, rply);
+
+    if(answered)
+        _coalescedMap.remove(origin);
     rply->deleteLater(); // release memory
 }
 
 
-QString QDropbox::hmacsha1(QString baseString, QString key)
+QString QDropbox::hmacsha1(QByteArray key, QByteArray message)
+{
+    qdropbox_signing_context context;
+    hmacsha1Pads(key, &context.innerPad, &context.outerPad);
+    return hmacsha1(message, context);
+}
+
+QString QDropbox::hmacsha1(QByteArray baseString, const qdropbox_signing_context &context)
+{
+    // result = hash ( outerPadding CONCAT hash ( innerPadding CONCAT baseString ) ).toBase64
+    // both paddings were XORed with the key when the signing context was built
+    QCryptographicHash inner(QCryptographicHash::Sha1);
+    inner.addData(context.innerPad);
+    inner.addData(baseString);
+
+    QCryptographicHash outer(QCryptographicHash::Sha1);
+    outer.addData(context.outerPad);
+    outer.addData(inner.result());
+    return outer.result().toBase64();
+}
+
+const qdropbox_signing_context &QDropbox::signingContext()
+{
+    if(_signing.valid && _signing.method == oauthMethod
+       && _signing.appKey == _appKey && _signing.appSecret == _appSharedSecret
+       && _signing.token == oauthToken && _signing.tokenSecret == oauthTokenSecret
+       && _signing.version == _version)
+        return _signing;
+
+#ifdef QTDROPBOX_DEBUG
+    qDebug() << "signingContext() -> rebuilding" << endl;
+#endif
+
+    _signing.method      = oauthMethod;
+    _signing.appKey      = _appKey;
+    _signing.appSecret   = _appSharedSecret;
+    _signing.token       = oauthToken;
+    _signing.tokenSecret = oauthTokenSecret;
+    _signing.version     = _version;
+    _signing.signatureMethod = signatureMethodString();
+    // an unknown method is reported again with the next request
+    _signing.valid       = !_signing.signatureMethod.isEmpty();
+
+    QString key = QString("%1&%2").arg(_appSharedSecret).arg(oauthTokenSecret);
+    _signing.plaintextSignature = key;
+    hmacsha1Pads(key.toLatin1(), &_signing.innerPad, &_signing.outerPad);
+
+    QUrlQuery query;
+    query.addQueryItem("oauth_consumer_key", _appKey);
+    query.addQueryItem("oauth_signature_method", _signing.signatureMethod);
+    query.addQueryItem("oauth_version", _version);
+    _signing.tokenlessQuery = query;
+    query.addQueryItem("oauth_token", oauthToken);
+    _signing.query = query;
+
+    return _signing;
+}
+
+void QDropbox::hmacsha1Pads(QByteArray key, QByteArray *innerPad, QByteArray *outerPad)
 {
-    int blockSize = 64; // HMAC-::hmacsha1SHA-1 block size, defined in SHA-1 standard
+    int blockSize = 64; // HMAC-SHA-1 block size, defined in SHA-1 standard
     if (key.length() > blockSize) { // if key is longer than block size (64), reduce key length with SHA-1 compression
-        key = QCryptographicHash::hash(key.toLatin1(), QCryptographicHash::Sha1);
+        key = QCryptographicHash::hash(key, QCryptographicHash::Sha1);
     }
 
-    QByteArray innerPadding(blockSize, char(0x36)); // initialize inner padding with char "6"
-    QByteArray outerPadding(blockSize, char(0x5c)); // initialize outer padding with char "\"
+    *innerPad = QByteArray(blockSize, char(0x36)); // initialize inner padding with char "6"
+    *outerPad = QByteArray(blockSize, char(0x5c)); // initialize outer padding with char "\"
     // ascii characters 0x36 ("6") and 0x5c ("\") are selected because they have large
     // Hamming distance (http://en.wikipedia.org/wiki/Hamming_distance)
-
     for (int i = 0; i < key.length(); i++) {
-        innerPadding[i] = innerPadding[i] ^ key.toLatin1().at(i); // XOR operation between every byte in key and innerpadding, of key length
-        outerPadding[i] = outerPadding[i] ^ key.toLatin1().at(i); // XOR operation between every byte in key and outerpadding, of key length
+        (*innerPad)[i] = innerPad->at(i) ^ key.at(i);
+        (*outerPad)[i] = outerPad->at(i) ^ key.at(i);
     }
+    return;
+}
 
-    // result = hash ( outerPadding CONCAT hash ( innerPadding CONCAT baseString ) ).toBase64
-    QByteArray total = outerPadding;
-    QByteArray part = innerPadding;
-    part.append(baseString.toLatin1());
-    total.append(QCryptographicHash::hash(part, QCryptographicHash::Sha1));
-    QByteArray hashed = QCryptographicHash::hash(total, QCryptographicHash::Sha1);
-    return hashed.toBase64();
+QUrlQuery QDropbox::oAuthQuery(QString requestNonce, qint64 requestTimestamp, bool withToken)
+{
+    const qdropbox_signing_context &context = signingContext();
+    QUrlQuery query = withToken? context.query : context.tokenlessQuery;
+    query.addQueryItem("oauth_nonce", requestNonce);
+    query.addQueryItem("oauth_timestamp", QString::number(requestTimestamp));
+    return query;
 }
 
 QString QDropbox::generateNonce(qint32 length)
 {
-    QString clng = "";
+    static const char hexDigits[] = "0123456789ABCDEF";
+    if(length <= 0)
+        return QString();
+
+    // every random word yields eight hex digits
+    QVarLengthArray<quint32, 16> random((length+7)/8);
+#if QT_VERSION >= QT_VERSION_CHECK(5, 10, 0)
+    QRandomGenerator::system()->fillRange(random.data(), random.size());
+#else
+    // qrand() only guarantees 15 random bits per call
+    for(int i=0; i<random.size(); ++i)
+        random[i] = (quint32(qrand()) << 30) ^ (quint32(qrand()) << 15) ^ quint32(qrand());
+#endif
+
+    QString nonce(length, Qt::Uninitialized);
+    QChar *out = nonce.data();
     for(int i=0; i<length; ++i)
-        clng += QString::number(int( qrand() / (RAND_MAX + 1.0) * (16 + 1 - 0) + 0 ), 16).toUpper();
-    return clng;
+        out[i] = QLatin1Char(hexDigits[(random[i/8] >> ((i%8)*4)) & 0xF]);
+    return nonce;
 }
 
 QString QDropbox::oAuthSign(QUrl base, QString method)
 {
+    QDropboxTraceSpan span(_tracer, "sign", "QDropbox");
+    const qdropbox_signing_context &context = signingContext();
     if(oauthMethod == QDropbox::Plaintext){
 #ifdef QTDROPBOX_DEBUG
         qDebug() << "oauthMethod = Plaintext";
 #endif
-        return QString("%1&%2").arg(_appSharedSecret).arg(oauthTokenSecret);
+        return context.plaintextSignature;
     }
 
     QString param   = base.toString(QUrl::RemoveAuthority|QUrl::RemovePath|QUrl::RemoveScheme).mid(1);
@@ -377,93 +585,747 @@ QString QDropbox::oAuthSign(QUrl base, QString method)
     qDebug() << "param = " << param << endl << "requrl = " << requrl << endl;
 #endif
     QString baseurl = method+"&"+requrl+"&"+param;
-    QString key     = QString("%1&%2").arg(_appSharedSecret).arg(oauthTokenSecret);
 #ifdef QTDROPBOX_DEBUG
     qDebug() << "baseurl = " << baseurl << " endbase";
-    qDebug() << "key = " << key << " endkey";
+    qDebug() << "key = " << context.plaintextSignature << " endkey";
+#endif
+
+    QString signature = "";
+    if(oauthMethod == QDropbox::HMACSHA1)
+        signature = hmacsha1(baseurl.toUtf8(), context);
+    else
+    {
+        errorState = QDropbox::UnknownAuthMethod;
+        errorText  = QString("Authentication method %1 is unknown").arg(oauthMethod);
+        emit errorOccured(errorState);
+#ifdef QTDROPBOX_DEBUG
+        qDebug() << "Authentication method " << oauthMethod << " is unknown";
 #endif
+        return "";
+    }
+
+#ifdef QTDROPBOX_DEBUG
+    qDebug() << "key = " << context.plaintextSignature << endl;
+    qDebug() << "signature = " << signature << "(base64 = " << QByteArray(signature.toUtf8()).toBase64() << endl;
+
+#endif
+    return signature.toUtf8();
+}
+
+void QDropbox::prepareApiUrl()
+{
+    //if(oauthMethod == QDropbox::Plaintext)
+    if(apiurl.scheme().isEmpty())
+        apiurl.setScheme("https");
+    //else
+    //  apiurl.setScheme("http");
+}
+
+int QDropbox::sendRequest(QUrl request, QString type, QByteArray postdata, QString host, bool coalesce)
+{
+    QDropboxTraceSpan span(_tracer, "send", "QDropbox");
+    if(!host.trimmed().compare(""))
+        host = apiurl.toString(QUrl::RemoveScheme).mid(2);
+
+#ifdef QTDROPBOX_DEBUG
+    qDebug() << "sendRequest() host = " << host << endl;
+#endif
+
+    /*if(oauthMethod == QDropbox::Plaintext)
+        reqnr = conManager.setHost(host, QHttp::ConnectionModeHttps);
+    else
+        reqnr = conManager.setHost(host, QHttp::ConnectionModeHttp);
+    requestMap[reqnr].type   = QDROPBOX_REQ_CONNECT;
+    requestMap[reqnr].method = "";*/
+
+    QString req_str = request.toString(QUrl::RemoveAuthority|QUrl::RemoveScheme);
+    if(!req_str.startsWith("/"))
+        req_str = QString("/%1").arg(req_str);
+
+    QNetworkRequest rq(request);
+
+    if(!type.compare("POST"))
+        rq.setHeader( QNetworkRequest::ContentTypeHeader, "application/x-www-form-urlencoded" );
+    else if(type.compare("GET"))
+    {
+        errorState = QDropbox::UnknownQueryMethod;
+        errorText  = "The provided query method is unknown.";
+        emit errorOccured(errorState);
+#ifdef QTDROPBOX_DEBUG
+        qDebug() << "error " << errorState << "(" << errorText << ") in request" << endl;
+#endif
+        return -1;
+    }
+
+    int reqnr = ++lastreply;
+    requestMap[reqnr].method   = type;
+    requestMap[reqnr].host     = host;
+    requestMap[reqnr].data     = postdata;
+    requestMap[reqnr].priority = _requestPriority;
+    requestMap[reqnr].number   = reqnr;
+    requestMap[reqnr].queued   = QDateTime::currentMSecsSinceEpoch();
+
+    span.setId(reqnr);
+    if(tracing())
+        _tracer->flow('s', "QDropbox", reqnr);
+
+    // an identical GET that is still running answers this request as well
+    if(coalesce && !type.compare("GET"))
+    {
+        QString key = coalescingKey(request);
+        if(_inflightMap.contains(key))
+        {
+#ifdef QTDROPBOX_DEBUG
+            qDebug() << "sendRequest() -> request #" << reqnr << " attached to #" << _inflightMap[key] << endl;
+#endif
+            _coalescedMap[_inflightMap[key]].append(reqnr);
+
+            // the shared request must not wait behind work less important
+            // than the request that is attached to it
+            raisePriority(_inflightMap[key], _requestPriority);
+            emit operationStarted(reqnr);
+            return reqnr;
+        }
+        _inflightMap[key] = reqnr;
+    }
+
+    dispatchRequest(reqnr, rq);
+
+#ifdef QTDROPBOX_DEBUG
+    qDebug() << "sendRequest() -> request #" << reqnr << " queued." << endl;
+#endif
+	emit operationStarted(reqnr); // fire signal for operation start
+    return reqnr;
+}
+
+void QDropbox::dispatchRequest(int reqnr, QNetworkRequest rq)
+{
+    qdropbox_request r = requestMap.value(reqnr);
+    if(tracing())
+        _tracer->asyncBegin("queue", "QDropbox", reqnr);
+    sendNetworkRequest(this, rq, r.method.toLatin1(), r.data, RequestPriority(r.priority),
+                       [this, reqnr](QNetworkReply *rply){
+        if(tracing())
+        {
+            _tracer->asyncEnd("queue", "QDropbox", reqnr);
+            _tracer->asyncBegin("network", "QDropbox", reqnr);
+        }
+        replynrMap[rply] = reqnr;
+        if(requestMap.contains(reqnr))
+        {
+            requestMap[reqnr].sent      = QDateTime::currentMSecsSinceEpoch();
+            requestMap[reqnr].firstByte = 0;
+            requestMap[reqnr].bytesSent = requestMap[reqnr].data.size();
+        }
+        connect(rply, &QNetworkReply::metaDataChanged, this, [this, reqnr]{
+            if(requestMap.contains(reqnr) && requestMap[reqnr].firstByte == 0)
+                requestMap[reqnr].firstByte = QDateTime::currentMSecsSinceEpoch();
+        });
+        connect(rply, &QNetworkReply::finished, this, [this, rply]{ networkReplyFinished(rply); });
+    }, reqnr);
+    return;
+}
+
+void QDropbox::raisePriority(int reqnr, int priority)
+{
+    if(!requestMap.contains(reqnr) || requestMap[reqnr].priority <= priority)
+        return;
+
+    int old = requestMap[reqnr].priority;
+    requestMap[reqnr].priority = priority;
+
+#ifdef QTDROPBOX_DEBUG
+    qDebug() << "raisePriority() -> request #" << reqnr << " priority " << old << " -> " << priority << endl;
+#endif
+
+    // nothing to do if the request was sent already
+    QList<qdropbox_pending_request> &queue = _pendingRequests[old];
+    for(int i=0; i<queue.size(); ++i)
+    {
+        if(queue.at(i).number != reqnr)
+            continue;
+
+        qdropbox_pending_request pending = queue.takeAt(i);
+        pending.request.setPriority(priority == QDropbox::InteractivePriority?
+                                        QNetworkRequest::HighPriority : QNetworkRequest::NormalPriority);
+        _pendingRequests[priority].append(pending);
+        processPendingRequests();
+        return;
+    }
+    return;
+}
+
+void QDropbox::sendNetworkRequest(QObject *owner, QNetworkRequest request, QByteArray verb, QByteArray data,
+                                  RequestPriority priority, std::function<void(QNetworkReply*)> started,
+                                  int number)
+{
+    // let QNetworkAccessManager prefer the request on its connections as well
+    if(priority == QDropbox::InteractivePriority)
+        request.setPriority(QNetworkRequest::HighPriority);
+    else if(priority == QDropbox::BackgroundPriority)
+        request.setPriority(QNetworkRequest::LowPriority);
+
+    qdropbox_pending_request pending{ request, verb, data, owner, started, number };
+    _pendingRequests[priority].append(pending);
+    processPendingRequests();
+    return;
+}
+
+int QDropbox::cancelNetworkRequests(QObject *owner)
+{
+    int removed = 0;
+    for(int p=InteractivePriority; p<=BackgroundPriority; ++p)
+    {
+        for(int i=_pendingRequests[p].size()-1; i>=0; --i)
+        {
+            if(_pendingRequests[p].at(i).owner != owner)
+                continue;
+            _pendingRequests[p].removeAt(i);
+            removed++;
+        }
+    }
+    return removed;
+}
+
+void QDropbox::processPendingRequests()
+{
+    // higher priority classes are served first, within a class requests are
+    // sent in the order they were queued. A busy host does not hold back
+    // requests to other hosts.
+    for(int p=InteractivePriority; p<=BackgroundPriority; ++p)
+    {
+        QList<qdropbox_pending_request> &queue = _pendingRequests[p];
+        int i = 0;
+        while(i < queue.size())
+        {
+            QString host = queue.at(i).request.url().host();
+            int limit    = maxConnectionsPerHost(host);
+            // keep the last connection free for more important requests
+            if(p == BackgroundPriority && limit > 1)
+                limit--;
+            if(_activeConnections.value(host) >= limit)
+            {
+                ++i;
+                continue;
+            }
+
+            // once throttled all hosts wait for the token bucket
+            if(!requestTokenAvailable())
+                return;
+
+            qdropbox_pending_request pending = queue.takeAt(i);
+            if(pending.owner.isNull())
+                continue; // nobody is interested anymore
+            if(_requestRate > 0)
+                _bucketTokens -= 1.0;
+
+            // count sent requests per second to know the rate throttling starts at
+            qint64 now = QDateTime::currentMSecsSinceEpoch();
+            if(now - _rateWindowStart >= 1000)
+            {
+                _lastWindowCount = (now - _rateWindowStart < 2000)? _rateWindowCount : 0;
+                _rateWindowStart = now;
+                _rateWindowCount = 0;
+            }
+            _rateWindowCount++;
+
+            QNetworkReply *rply;
+            if(pending.verb == "GET")
+                rply = conManager.get(pending.request);
+            else if(pending.verb == "PUT")
+                rply = conManager.put(pending.request, pending.data);
+            else if(pending.verb == "POST")
+                rply = conManager.post(pending.request, pending.data);
+            else
+                rply = conManager.sendCustomRequest(pending.request, pending.verb);
+
+#ifdef QTDROPBOX_DEBUG
+            qDebug() << "processPendingRequests() -> " << pending.verb << " to " << host
+                     << " (priority " << p << ", " << _activeConnections.value(host)+1 << " connections)" << endl;
+#endif
+
+            _activeConnections[host]++;
+            _replyHostMap[rply] = host;
+            connect(rply, &QNetworkReply::finished, this, [this, rply]{
+                adaptRequestRate(rply);
+                releaseConnection(rply);
+            });
+            connect(rply, &QObject::destroyed, this, [this, rply]{ releaseConnection(rply); });
+
+            pending.started(rply);
+        }
+    }
+    return;
+}
+
+void QDropbox::releaseConnection(QNetworkReply *rply)
+{
+    // finished and destroyed both release - only count once
+    if(!_replyHostMap.contains(rply))
+        return;
+
+    QString host = _replyHostMap.take(rply);
+    _activeConnections[host]--;
+    processPendingRequests();
+    return;
+}
+
+bool QDropbox::requestTokenAvailable()
+{
+    if(_requestRate <= 0)
+        return true;
+
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    if(now > _bucketUpdated)
+    {
+        // allow bursts of up to one second worth of requests
+        _bucketTokens  = qMin(qMax(1.0, _requestRate),
+                              _bucketTokens + (now - _bucketUpdated)*_requestRate/1000.0);
+        _bucketUpdated = now;
+    }
+    if(_bucketTokens >= 1.0)
+        return true;
+
+    // come back as soon as the next token is available
+    if(!_bucketTimer.isActive())
+        _bucketTimer.start(int(_bucketUpdated - now + (1.0-_bucketTokens)*1000.0/_requestRate) + 1);
+    return false;
+}
+
+void QDropbox::adaptRequestRate(QNetworkReply *rply)
+{
+    if(!_replyHostMap.contains(rply))
+        return;
+
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    if(rply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() == QDROPBOX_ERROR_REQUEST_CAP)
+    {
+        // requests that were sent together are throttled together,
+        // so the rate is only halved once per second
+        if(now - _rateChanged < 1000)
+            return;
+        _rateChanged = now;
+
+        if(_requestRate <= 0)
+        {
+            _requestRateMax = qMax(2.0, 2.0*qMax(_lastWindowCount, _rateWindowCount));
+            _requestRate    = _requestRateMax/4;
+            _bucketTokens   = 0;
+            _bucketUpdated  = now;
+        }
+        else
+            _requestRate = qMax(0.1, _requestRate/2);
+#ifdef QTDROPBOX_DEBUG
+        qDebug() << "adaptRequestRate() -> throttled, " << _requestRate << " requests per second" << endl;
+#endif
+    }
+    else if(_requestRate > 0 && rply->error() == QNetworkReply::NoError)
+    {
+        // about one request per second more for every second without throttling
+        _requestRate += 1.0/_requestRate;
+        if(_requestRate >= _requestRateMax)
+        {
+            _requestRate = 0;
+#ifdef QTDROPBOX_DEBUG
+            qDebug() << "adaptRequestRate() -> throttling ended" << endl;
+#endif
+        }
+    }
+    return;
+}
+
+bool QDropbox::retryRequest(int reqnr, QNetworkReply *rply)
+{
+    if(!requestMap.contains(reqnr) || requestMap[reqnr].retries >= _maxRetries)
+        return false;
+
+    int delay = retryDelay(requestMap[reqnr].retries, rply);
+    requestMap[reqnr].retries++;
+    _retryCount++;
+    _retryBackoffTime += delay;
+
+    // nothing is sent to the account before the server wants to see us again
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    if(_requestRate > 0 && !rply->rawHeader("Retry-After").isEmpty())
+    {
+        _bucketTokens  = 0;
+        _bucketUpdated = qMax(_bucketUpdated, now + delay);
+    }
+
+#ifdef QTDROPBOX_DEBUG
+    qDebug() << "retryRequest() -> request #" << reqnr << " throttled, retry "
+             << requestMap[reqnr].retries << " in " << delay << "ms" << endl;
+#endif
+
+    // the request keeps its number, so waiting callers and coalesced
+    // requests get the answer to the retry
+    QNetworkRequest rq = rply->request();
+    QTimer::singleShot(delay, this, [this, reqnr, rq]{
+        if(!requestMap.contains(reqnr))
+            return;
+
+        // the server rejects a nonce it has seen before, so the retry is
+        // signed again with a new nonce and timestamp
+        QNetworkRequest retry = rq;
+        QUrl url = retry.url();
+        if(url.hasQuery())
+        {
+            url.setQuery(renewOAuthQuery(QUrlQuery(url), url));
+            retry.setUrl(url);
+        }
+        QByteArray &data = requestMap[reqnr].data;
+        if(!data.isEmpty())
+            data = renewOAuthQuery(QUrlQuery(QString(data)), url).toString().toUtf8();
+
+        dispatchRequest(reqnr, retry);
+    });
+    return true;
+}
+
+QUrlQuery QDropbox::renewOAuthQuery(QUrlQuery query, QUrl url)
+{
+    if(!query.hasQueryItem("oauth_nonce"))
+        return query;
+
+    query.removeAllQueryItems("oauth_nonce");
+    query.removeAllQueryItems("oauth_timestamp");
+    query.removeAllQueryItems("oauth_signature");
+    query.addQueryItem("oauth_nonce", generateNonce());
+    query.addQueryItem("oauth_timestamp", QString::number(QDateTime::currentMSecsSinceEpoch()/1000));
+
+    // requests are signed without their query
+    QString signature = oAuthSign(QUrl(url.toString(QUrl::RemoveQuery)));
+    query.addQueryItem("oauth_signature", QUrl::toPercentEncoding(signature));
+    return query;
+}
+
+int QDropbox::retryDelay(int attempt, QNetworkReply *rply)
+{
+    // exponential backoff, randomized between half and the full delay
+    qint64 backoff = qMin(qint64(60000), qint64(_retryBaseDelay) << qMin(attempt, 16));
+#if QT_VERSION >= QT_VERSION_CHECK(5, 10, 0)
+    qint64 delay   = backoff/2 + QRandomGenerator::global()->bounded(int(backoff/2+1));
+#else
+    // qrand() only guarantees 15 random bits per call, 30 bits keep the modulo bias small
+    qint64 delay   = backoff/2 + ((quint32(qrand()) << 15) ^ quint32(qrand()))%quint32(backoff/2+1);
+#endif
+
+    // Retry-After is either a number of seconds or a HTTP date
+    QByteArray retryAfter = rply->rawHeader("Retry-After").trimmed();
+    if(!retryAfter.isEmpty())
+    {
+        bool ok;
+        qint64 wait = retryAfter.toLongLong(&ok)*1000;
+        if(!ok)
+        {
+            QDateTime date = QDateTime::fromString(QString(retryAfter), Qt::RFC2822Date);
+            wait = date.isValid()? QDateTime::currentDateTimeUtc().msecsTo(date) : 0;
+        }
+        delay = qMax(delay, wait);
+    }
+    return int(qMin(delay, qint64(INT_MAX)));
+}
+
+void QDropbox::setMetadataCacheTtl(int msecs)
+{
+    _metadataCacheTtl = qMax(0, msecs);
+    return;
+}
+
+int QDropbox::metadataCacheTtl()
+{
+    return _metadataCacheTtl;
+}
+
+void QDropbox::setMetadataCacheSize(int entries)
+{
+    _metadataCache.setMaxCost(qMax(0, entries));
+    return;
+}
+
+int QDropbox::metadataCacheSize()
+{
+    return _metadataCache.maxCost();
+}
+
+void QDropbox::invalidateMetadataCache(QString file)
+{
+    invalidateMetadataKey(metadataCacheKey(file));
+    return;
+}
+
+void QDropbox::clearMetadataCache()
+{
+    _metadataCache.clear();
+    return;
+}
+
+int QDropbox::metadataCacheHits()
+{
+    return _metadataCacheHits;
+}
+
+int QDropbox::metadataCacheMisses()
+{
+    return _metadataCacheMisses;
+}
+
+void QDropbox::setMaxRetries(int retries)
+{
+    _maxRetries = qMax(0, retries);
+    return;
+}
+
+int QDropbox::maxRetries()
+{
+    return _maxRetries;
+}
+
+void QDropbox::setRetryBaseDelay(int msecs)
+{
+    _retryBaseDelay = qMax(1, msecs);
+    return;
+}
+
+int QDropbox::retryBaseDelay()
+{
+    return _retryBaseDelay;
+}
+
+int QDropbox::retryCount()
+{
+    return _retryCount;
+}
+
+qint64 QDropbox::retryBackoffTime()
+{
+    return _retryBackoffTime;
+}
+
+double QDropbox::requestRateLimit()
+{
+    return _requestRate;
+}
+
+QString QDropbox::metadataCacheKey(QString path, bool stripRoot)
+{
+    // Dropbox paths are case insensitive and requests carry the root
+    // (dropbox or sandbox) in front of the path while delta entries don't
+    QStringList parts = path.toLower().split('/', QString::SkipEmptyParts);
+    if(stripRoot && !parts.isEmpty() &&
+       (parts.first() == "dropbox" || parts.first() == "sandbox" || parts.first() == "auto"))
+        parts.removeFirst();
+    return QString("/%1").arg(parts.join('/'));
+}
+
+bool QDropbox::cachedMetadata(QString file, QDropboxFileInfo *info)
+{
+    if(_metadataCacheTtl <= 0)
+        return false;
+
+    // expired directory listings stay in the cache, their hash is
+    // used to revalidate them (see requestMetadata())
+    qdropbox_cached_metadata *entry = _metadataCache.object(metadataCacheKey(file));
+    if(entry != NULL && QDateTime::currentMSecsSinceEpoch()-entry->received > _metadataCacheTtl)
+        entry = NULL;
+
+    if(entry == NULL)
+    {
+        _metadataCacheMisses++;
+        return false;
+    }
+
+#ifdef QTDROPBOX_DEBUG
+    qDebug() << "metadata of " << file << " taken from cache" << endl;
+#endif
+    _metadataCacheHits++;
+    *info = entry->info;
+    return true;
+}
+
+void QDropbox::cacheMetadata(QString file, const QDropboxFileInfo &info)
+{
+    QDropboxFileInfo fi(info);
+    if(!fi.isValid())
+        return;
+
+    // without a time to live only listings that can be revalidated are kept
+    if(_metadataCacheTtl <= 0 && fi.hash().isEmpty())
+        return;
+
+    qdropbox_cached_metadata *entry = new qdropbox_cached_metadata{ fi, QDateTime::currentMSecsSinceEpoch() };
+    _metadataCache.insert(metadataCacheKey(file), entry);
+    return;
+}
+
+void QDropbox::responseNotModified(int reqnr)
+{
+    int type = requestMap.value(reqnr).type;
+    if(type != QDROPBOX_REQ_METADAT && type != QDROPBOX_REQ_BMETADA)
+    {
+        errorState  = QDropbox::ResponseToUnknownRequest;
+        errorText   = "Received a 304 response to a request that was not conditional";
+        emit errorOccured(errorState);
+        return;
+    }
 
-    QString signature = "";
-    if(oauthMethod == QDropbox::HMACSHA1)
-        signature = hmacsha1(baseurl.toUtf8(), key.toUtf8());
-    else
+    if(type == QDROPBOX_REQ_BMETADA)
+        clearError();
+
+    qdropbox_cached_metadata *cached = _metadataCache.object(metadataCacheKey(requestMap.value(reqnr).path));
+    if(cached == NULL)
     {
-        errorState = QDropbox::UnknownAuthMethod;
-        errorText  = QString("Authentication method %1 is unknown").arg(oauthMethod);
+        // the listing was dropped from the cache and could not be requested again
+        errorState = QDropbox::APIError;
+        errorText  = "Dropbox API answered 304 for metadata that is not cached anymore.";
         emit errorOccured(errorState);
-#ifdef QTDROPBOX_DEBUG
-        qDebug() << "Authentication method " << oauthMethod << " is unknown";
-#endif
-        return "";
+        storeError(reqnr);
+        return;
     }
 
 #ifdef QTDROPBOX_DEBUG
-    qDebug() << "key = " << key << endl;
-    qDebug() << "signature = " << signature << "(base64 = " << QByteArray(signature.toUtf8()).toBase64() << endl;
-
+    qDebug() << "metadata of " << requestMap.value(reqnr).path << " not modified" << endl;
 #endif
-    return signature.toUtf8();
-}
+    cached->received = QDateTime::currentMSecsSinceEpoch();
+    storeResponse(reqnr, cached->info);
 
-void QDropbox::prepareApiUrl()
-{
-    //if(oauthMethod == QDropbox::Plaintext)
-    apiurl.setScheme("https");
-    //else
-    //  apiurl.setScheme("http");
+    // only serialize the listing if somebody listens to the raw JSON
+    if(receivers(SIGNAL(metadataReceived(QString))) > 0)
+        emit metadataReceived(cached->info.strContent());
+    return;
 }
 
-int QDropbox::sendRequest(QUrl request, QString type, QByteArray postdata, QString host)
+bool QDropbox::resendUncachedMetadata(int reqnr, QNetworkReply *rply)
 {
-    if(!host.trimmed().compare(""))
-        host = apiurl.toString(QUrl::RemoveScheme).mid(2);
+    if(!requestMap.contains(reqnr))
+        return false;
+
+    qdropbox_request r = requestMap.value(reqnr);
+    if(r.type != QDROPBOX_REQ_METADAT && r.type != QDROPBOX_REQ_BMETADA)
+        return false;
+    if(_metadataCache.contains(metadataCacheKey(r.path)))
+        return false;
+
+    QNetworkRequest rq = rply->request();
+    QUrl url = rq.url();
+    QUrlQuery query(url);
+    if(!query.hasQueryItem("hash"))
+        return false;
 
 #ifdef QTDROPBOX_DEBUG
-    qDebug() << "sendRequest() host = " << host << endl;
+    qDebug() << "resendUncachedMetadata() -> request #" << reqnr << " sent again without hash" << endl;
 #endif
 
-    /*if(oauthMethod == QDropbox::Plaintext)
-        reqnr = conManager.setHost(host, QHttp::ConnectionModeHttps);
-    else
-        reqnr = conManager.setHost(host, QHttp::ConnectionModeHttp);
-    requestMap[reqnr].type   = QDROPBOX_REQ_CONNECT;
-    requestMap[reqnr].method = "";*/
+    // the request keeps its number, so waiting callers and coalesced
+    // requests get the full listing
+    query.removeAllQueryItems("hash");
+    url.setQuery(renewOAuthQuery(query, url));
+    rq.setUrl(url);
+    dispatchRequest(reqnr, rq);
+    return true;
+}
 
-    QString req_str = request.toString(QUrl::RemoveAuthority|QUrl::RemoveScheme);
-    if(!req_str.startsWith("/"))
-        req_str = QString("/%1").arg(req_str);
+void QDropbox::invalidateMetadataKey(QString key)
+{
+    if(_metadataCache.isEmpty())
+        return;
 
-    QNetworkRequest rq(request);
-    QNetworkReply *rply;
+    _metadataCache.remove(key);
 
-    if(!type.compare("GET"))
-        rply = conManager.get(rq);
-    else if(!type.compare("POST"))
+    // the listing of the parent directory contains the path
+    QString parent = key.section('/', 0, -2);
+    _metadataCache.remove(parent.isEmpty() ? QString("/") : parent);
+
+    // and a changed directory invalidates everything below it
+    QString prefix = (key == "/") ? key : key+"/";
+    QList<QString> keys = _metadataCache.keys();
+    for(int i=0; i<keys.size(); ++i)
     {
-        rq.setHeader( QNetworkRequest::ContentTypeHeader, "application/x-www-form-urlencoded" );
-        rply = conManager.post(rq, postdata);
+        if(keys.at(i).startsWith(prefix))
+            _metadataCache.remove(keys.at(i));
     }
+    return;
+}
+
+QString QDropbox::coalescingKey(QUrl request)
+{
+    // nonce, timestamp and signature differ for every request even if
+    // the requests are identical otherwise
+    QUrlQuery query(request);
+    query.removeAllQueryItems("oauth_nonce");
+    query.removeAllQueryItems("oauth_timestamp");
+    query.removeAllQueryItems("oauth_signature");
+    request.setQuery(query);
+    return request.toString();
+}
+
+QList<int> QDropbox::requestGroup(int reqnr)
+{
+    QList<int> group;
+    group.append(reqnr);
+    group.append(_coalescedMap.value(reqnr));
+    return group;
+}
+
+QNetworkAccessManager *QDropbox::networkAccessManager()
+{
+    return &conManager;
+}
+
+void QDropbox::setMaxConnectionsPerHost(int max)
+{
+    _maxConnectionsPerHost = qMax(1, max);
+    processPendingRequests();
+    return;
+}
+
+int QDropbox::maxConnectionsPerHost()
+{
+    return _maxConnectionsPerHost;
+}
+
+void QDropbox::setMaxConnectionsPerHost(QString host, int max)
+{
+    if(max < 0)
+        _hostConnectionLimits.remove(host);
     else
-    {
-        errorState = QDropbox::UnknownQueryMethod;
-        errorText  = "The provided query method is unknown.";
-        emit errorOccured(errorState);
-#ifdef QTDROPBOX_DEBUG
-        qDebug() << "error " << errorState << "(" << errorText << ") in request" << endl;
-#endif
-        return -1;
-    }
+        _hostConnectionLimits[host] = qMax(1, max);
+    processPendingRequests();
+    return;
+}
+
+int QDropbox::maxConnectionsPerHost(QString host)
+{
+    return _hostConnectionLimits.value(host, _maxConnectionsPerHost);
+}
+
+void QDropbox::setRequestPriority(RequestPriority priority)
+{
+    _requestPriority = priority;
+    return;
+}
 
-    replynrMap[rply] = ++lastreply;
+QDropbox::RequestPriority QDropbox::requestPriority()
+{
+    return _requestPriority;
+}
 
-    requestMap[lastreply].method = type;
-    requestMap[lastreply].host   = host;
+int QDropbox::queuedRequests()
+{
+    int count = 0;
+    for(int p=InteractivePriority; p<=BackgroundPriority; ++p)
+        count += _pendingRequests[p].size();
+    return count;
+}
 
-#ifdef QTDROPBOX_DEBUG
-    qDebug() << "sendRequest() -> request #" << lastreply << " sent." << endl;
-#endif
-	emit operationStarted(lastreply); // fire signal for operation start
-    return lastreply;
+int QDropbox::queuedRequests(RequestPriority priority)
+{
+    return _pendingRequests[priority].size();
+}
+
+int QDropbox::activeConnections(QString host)
+{
+    return _activeConnections.value(host);
 }
 
 void QDropbox::responseTokenRequest(QString response)
@@ -564,15 +1426,13 @@ void QDropbox::parseToken(QString response)
     return;
 }
 
-void QDropbox::parseAccountInfo(QString response)
+void QDropbox::parseAccountInfo(QString response, int reqnr)
 {
 #ifdef QTDROPBOX_DEBUG
     qDebug() << "== account info ==" << response << "== account info end ==";
 #endif
 
-    QDropboxJson json;
-    json.parseString(response);
-    _tempJson.parseString(response);
+    QDropboxJson json(response);
     if(!json.isValid())
     {
         errorState = QDropbox::APIError;
@@ -581,23 +1441,23 @@ void QDropbox::parseAccountInfo(QString response)
         qDebug() << "error: " << errorText << endl;
 #endif
         emit errorOccured(errorState);
+        storeError(reqnr);
         return;
     }
 
+    storeResponse(reqnr, json);
     emit accountInfoReceived(response);
     return;
 }
 
-void QDropbox::parseSharedLink(QString response)
+void QDropbox::parseSharedLink(QString response, int reqnr)
 {
 #ifdef QTDROPBOX_DEBUG
     qDebug() << "== shared link ==" << response << "== shared link end ==";
 #endif
 
-    //QDropboxJson json;
-    //json.parseString(response);
-    _tempJson.parseString(response);
-    if(!_tempJson.isValid())
+    QDropboxJson json(response);
+    if(!json.isValid())
     {
         errorState = QDropbox::APIError;
         errorText  = "Dropbox API did not send correct answer for file/directory shared link.";
@@ -605,21 +1465,21 @@ void QDropbox::parseSharedLink(QString response)
         qDebug() << "error: " << errorText << endl;
 #endif
         emit errorOccured(errorState);
-        stopEventLoop();
+        storeError(reqnr);
+        stopEventLoop(reqnr);
         return;
     }
+    storeResponse(reqnr, json);
     emit sharedLinkReceived(response);
 }
 
-void QDropbox::parseMetadata(QString response)
+void QDropbox::parseMetadata(QString response, int reqnr)
 {
 #ifdef QTDROPBOX_DEBUG
     qDebug() << "== metadata ==" << response << "== metadata end ==";
 #endif
 
-    QDropboxJson json;
-    json.parseString(response);
-    _tempJson.parseString(response);
+    QDropboxJson json(response);
     if(!json.isValid())
     {
         errorState = QDropbox::APIError;
@@ -628,23 +1488,25 @@ void QDropbox::parseMetadata(QString response)
         qDebug() << "error: " << errorText << endl;
 #endif
         emit errorOccured(errorState);
-        stopEventLoop();
+        storeError(reqnr);
+        stopEventLoop(reqnr);
         return;
     }
 
+    cacheMetadata(requestMap.value(reqnr).path, QDropboxFileInfo(json));
+
+    storeResponse(reqnr, json);
     emit metadataReceived(response);
     return;
 }
 
-void QDropbox::parseDelta(QString response)
+void QDropbox::parseDelta(QString response, int reqnr)
 {
 #ifdef QTDROPBOX_DEBUG
     qDebug() << "== metadata ==" << response << "== metadata end ==";
 #endif
 
-    QDropboxJson json;
-    json.parseString(response);
-    _tempJson.parseString(response);
+    QDropboxJson json(response);
     if(!json.isValid())
     {
         errorState = QDropbox::APIError;
@@ -653,10 +1515,26 @@ void QDropbox::parseDelta(QString response)
         qDebug() << "error: " << errorText << endl;
 #endif
         emit errorOccured(errorState);
-        stopEventLoop();
+        storeError(reqnr);
+        stopEventLoop(reqnr);
         return;
     }
 
+    // keep the metadata cache in line with the changes reported by the server
+    if(!_metadataCache.isEmpty())
+    {
+        if(json.getBool("reset"))
+            clearMetadataCache();
+        else
+        {
+            // the paths are read from the parsed tree, no entry is parsed again
+            QStringList paths = json.getArrayColumn("entries", 0);
+            for(int i=0; i<paths.size(); ++i)
+                invalidateMetadataKey(metadataCacheKey(paths.at(i), false));
+        }
+    }
+
+    storeResponse(reqnr, json);
     emit deltaReceived(response);
     return;
 }
@@ -728,21 +1606,15 @@ QString QDropbox::apiVersion()
 int QDropbox::requestToken(bool blocking)
 {
 	clearError();
-    QString sigmeth = signatureMethodString();
 
     timestamp = QDateTime::currentMSecsSinceEpoch()/1000;
-    nonce = generateNonce(128);
+    nonce = generateNonce();
 
     QUrl url;
     url.setUrl(apiurl.toString());
     url.setPath(QString("/%1/oauth/request_token").arg(_version.left(1)));
 
-    QUrlQuery query;
-    query.addQueryItem("oauth_consumer_key",_appKey);
-    query.addQueryItem("oauth_nonce", nonce);
-    query.addQueryItem("oauth_signature_method", sigmeth);
-    query.addQueryItem("oauth_timestamp", QString::number(timestamp));
-    query.addQueryItem("oauth_version", _version);
+    QUrlQuery query = oAuthQuery(nonce, timestamp, false);
 
     QString signature = oAuthSign(url);
     query.addQueryItem("oauth_signature", QUrl::toPercentEncoding(signature));
@@ -757,7 +1629,7 @@ int QDropbox::requestToken(bool blocking)
     if(blocking)
     {
         requestMap[reqnr].type = QDROPBOX_REQ_RQBTOKN;
-        startEventLoop();
+        startEventLoop(reqnr);
     }
     else
         requestMap[reqnr].type = QDROPBOX_REQ_RQTOKEN;
@@ -811,13 +1683,7 @@ int QDropbox::requestAccessToken(bool blocking)
     QUrl url;
     url.setUrl(apiurl.toString());
 
-    QUrlQuery query;
-    query.addQueryItem("oauth_consumer_key",_appKey);
-    query.addQueryItem("oauth_nonce", nonce);
-    query.addQueryItem("oauth_signature_method", signatureMethodString());
-    query.addQueryItem("oauth_timestamp", QString::number(timestamp));
-    query.addQueryItem("oauth_token", oauthToken);
-    query.addQueryItem("oauth_version", _version);
+    QUrlQuery query = oAuthQuery(nonce, timestamp);
 
     url.setPath(QString("/%1/oauth/access_token").
                 arg(_version.left(1)));
@@ -846,7 +1712,7 @@ int QDropbox::requestAccessToken(bool blocking)
     if(blocking)
     {
         requestMap[reqnr].type = QDROPBOX_REQ_BACCTOK;
-        startEventLoop();
+        startEventLoop(reqnr);
     }
     else
         requestMap[reqnr].type = QDROPBOX_REQ_ACCTOKN;
@@ -863,7 +1729,7 @@ bool QDropbox::requestAccessTokenAndWait()
     return (error() == NoError);
 }
 
-void QDropbox::requestAccountInfo(bool blocking)
+int QDropbox::requestAccountInfo(bool blocking)
 {
     clearError();
 
@@ -872,13 +1738,7 @@ void QDropbox::requestAccountInfo(bool blocking)
     QUrl url;
     url.setUrl(apiurl.toString());
 
-    QUrlQuery urlQuery;
-    urlQuery.addQueryItem("oauth_consumer_key",_appKey);
-    urlQuery.addQueryItem("oauth_nonce", nonce);
-    urlQuery.addQueryItem("oauth_signature_method", signatureMethodString());
-    urlQuery.addQueryItem("oauth_timestamp", QString::number(timestamp));
-    urlQuery.addQueryItem("oauth_token", oauthToken);
-    urlQuery.addQueryItem("oauth_version", _version);
+    QUrlQuery urlQuery = oAuthQuery(nonce, timestamp);
 
     QString signature = oAuthSign(url);
     urlQuery.addQueryItem("oauth_signature", QUrl::toPercentEncoding(signature));
@@ -890,30 +1750,42 @@ void QDropbox::requestAccountInfo(bool blocking)
     if(blocking)
     {
         requestMap[reqnr].type = QDROPBOX_REQ_BACCINF;
-        startEventLoop();
+        startEventLoop(reqnr);
     }
     else
         requestMap[reqnr].type = QDROPBOX_REQ_ACCINFO;
-    return;
+    return reqnr;
 }
 
 QDropboxAccount QDropbox::requestAccountInfoAndWait()
 {
-    requestAccountInfo(true);
-    QDropboxAccount a(_tempJson.strContent(), this);
-    _account = a;
-    return _account;
+    int reqnr = requestAccountInfo(true);
+    QDropboxAccount a(takeResponse(reqnr).json, this);
+    return a;
+}
+
+QFuture<QDropboxAccount> QDropbox::requestAccountInfoAsync()
+{
+    QFutureInterface<QDropboxAccount> promise;
+    promise.reportStarted();
+
+    int reqnr = requestAccountInfo();
+    addCompletion(reqnr, [promise](QDropboxJson json) mutable {
+        QDropboxAccount a(json);
+        promise.reportFinished(&a);
+    });
+    return promise.future();
 }
 
-void QDropbox::parseBlockingAccountInfo(QString response)
+void QDropbox::parseBlockingAccountInfo(QString response, int reqnr)
 {
     clearError();
-    parseAccountInfo(response);
-    stopEventLoop();
+    parseAccountInfo(response, reqnr);
+    stopEventLoop(reqnr);
     return;
 }
 
-void QDropbox::requestMetadata(QString file, bool blocking)
+int QDropbox::requestMetadata(QString file, bool blocking)
 {
     clearError();
 
@@ -922,13 +1794,12 @@ void QDropbox::requestMetadata(QString file, bool blocking)
     QUrl url;
     url.setUrl(apiurl.toString());
 
-    QUrlQuery urlQuery;
-    urlQuery.addQueryItem("oauth_consumer_key",_appKey);
-    urlQuery.addQueryItem("oauth_nonce", nonce);
-    urlQuery.addQueryItem("oauth_signature_method", signatureMethodString());
-    urlQuery.addQueryItem("oauth_timestamp", QString::number(timestamp));
-    urlQuery.addQueryItem("oauth_token", oauthToken);
-    urlQuery.addQueryItem("oauth_version", _version);
+    QUrlQuery urlQuery = oAuthQuery(nonce, timestamp);
+
+    // a cached directory listing is only sent again if it changed
+    qdropbox_cached_metadata *cached = _metadataCache.object(metadataCacheKey(file));
+    if(cached != NULL && !cached->info.hash().isEmpty())
+        urlQuery.addQueryItem("hash", cached->info.hash());
 
     QString signature = oAuthSign(url);
     urlQuery.addQueryItem("oauth_signature", QUrl::toPercentEncoding(signature));
@@ -937,38 +1808,60 @@ void QDropbox::requestMetadata(QString file, bool blocking)
     url.setPath(QString("/%1/metadata/%2").arg(_version.left(1), file));
 
     int reqnr = sendRequest(url);
+    if(reqnr >= 0)
+        requestMap[reqnr].path = file;
     if(blocking)
     {
         requestMap[reqnr].type = QDROPBOX_REQ_BMETADA;
-        startEventLoop();
+        startEventLoop(reqnr);
     }
     else
         requestMap[reqnr].type = QDROPBOX_REQ_METADAT;
-    //QDropboxFileInfo fi(_tempJson.strContent(), this);
-    return;
+    return reqnr;
 }
 
 QDropboxFileInfo QDropbox::requestMetadataAndWait(QString file)
 {
-    requestMetadata(file, true);
-    QDropboxFileInfo fi(_tempJson.strContent(), this);
+    QDropboxFileInfo cached(this);
+    if(cachedMetadata(file, &cached))
+    {
+        clearError();
+        return cached;
+    }
+
+    int reqnr = requestMetadata(file, true);
+    QDropboxFileInfo fi(takeResponse(reqnr).json, this);
     return fi;
 }
 
-void QDropbox::requestSharedLink(QString file, bool blocking)
+QFuture<QDropboxFileInfo> QDropbox::requestMetadataAsync(QString file)
+{
+    QFutureInterface<QDropboxFileInfo> promise;
+    promise.reportStarted();
+
+    QDropboxFileInfo cached;
+    if(cachedMetadata(file, &cached))
+    {
+        promise.reportFinished(&cached);
+        return promise.future();
+    }
+
+    int reqnr = requestMetadata(file);
+    addCompletion(reqnr, [promise](QDropboxJson json) mutable {
+        QDropboxFileInfo fi(json);
+        promise.reportFinished(&fi);
+    });
+    return promise.future();
+}
+
+int QDropbox::requestSharedLink(QString file, bool blocking)
 {
 	clearError();
 
     QUrl url;
     url.setUrl(apiurl.toString());
 
-    QUrlQuery urlQuery;
-    urlQuery.addQueryItem("oauth_consumer_key",_appKey);
-    urlQuery.addQueryItem("oauth_nonce", nonce);
-    urlQuery.addQueryItem("oauth_signature_method", signatureMethodString());
-    urlQuery.addQueryItem("oauth_timestamp", QString::number(timestamp));
-    urlQuery.addQueryItem("oauth_token", oauthToken);
-    urlQuery.addQueryItem("oauth_version", _version);
+    QUrlQuery urlQuery = oAuthQuery(nonce, timestamp);
 
     QString signature = oAuthSign(url);
     urlQuery.addQueryItem("oauth_signature", QUrl::toPercentEncoding(signature));
@@ -980,23 +1873,41 @@ void QDropbox::requestSharedLink(QString file, bool blocking)
     if(blocking)
     {
         requestMap[reqnr].type = QDROPBOX_REQ_BSHRDLN;
-        startEventLoop();
+        startEventLoop(reqnr);
     }
     else
         requestMap[reqnr].type = QDROPBOX_REQ_SHRDLNK;
 
-    return;
+    return reqnr;
 }
 
 QUrl QDropbox::requestSharedLinkAndWait(QString file)
 {
-    requestSharedLink(file,true);
-    QDropboxJson json(_tempJson.strContent());
-    QString urlString = json.getString("url");
+    int reqnr = requestSharedLink(file,true);
+    qdropbox_response response = takeResponse(reqnr);
+    if(response.error != QDropbox::NoError)
+        return QUrl();
+
+    QString urlString = response.json.getString("url");
     return QUrl(urlString);
 }
 
-void QDropbox::requestDelta(QString cursor, QString path_prefix, bool blocking)
+QFuture<QUrl> QDropbox::requestSharedLinkAsync(QString file)
+{
+    QFutureInterface<QUrl> promise;
+    promise.reportStarted();
+
+    int reqnr = requestSharedLink(file);
+    addCompletion(reqnr, [promise](QDropboxJson json) mutable {
+        QUrl url;
+        if(json.isValid())
+            url = QUrl(json.getString("url"));
+        promise.reportFinished(&url);
+    });
+    return promise.future();
+}
+
+int QDropbox::requestDelta(QString cursor, QString path_prefix, bool blocking)
 {
     clearError();
 
@@ -1005,13 +1916,7 @@ void QDropbox::requestDelta(QString cursor, QString path_prefix, bool blocking)
     QUrl url;
     url.setUrl(apiurl.toString());
 
-    QUrlQuery urlQuery;
-    urlQuery.addQueryItem("oauth_consumer_key",_appKey);
-    urlQuery.addQueryItem("oauth_nonce", nonce);
-    urlQuery.addQueryItem("oauth_signature_method", signatureMethodString());
-    urlQuery.addQueryItem("oauth_timestamp", QString::number(timestamp));
-    urlQuery.addQueryItem("oauth_token", oauthToken);
-    urlQuery.addQueryItem("oauth_version", _version);
+    QUrlQuery urlQuery = oAuthQuery(nonce, timestamp);
     if(cursor.length() > 0)
     {
         urlQuery.addQueryItem("cursor", cursor);
@@ -1042,118 +1947,207 @@ void QDropbox::requestDelta(QString cursor, QString path_prefix, bool blocking)
     if(blocking)
     {
         requestMap[reqnr].type = QDROPBOX_REQ_BDELTA;
-        startEventLoop();
+        startEventLoop(reqnr);
     }
     else
         requestMap[reqnr].type = QDROPBOX_REQ_DELTA;
-    return;
+    return reqnr;
 }
 
 QDropboxDeltaResponse QDropbox::requestDeltaAndWait(QString cursor, QString path_prefix)
 {
-    requestDelta(cursor, path_prefix, true);
-    QDropboxDeltaResponse r(_tempJson.strContent());
+    int reqnr = requestDelta(cursor, path_prefix, true);
+    QDropboxDeltaResponse r(takeResponse(reqnr).json.strContent());
 
     return r;
 }
 
-void QDropbox::startEventLoop()
+QFuture<QDropboxDeltaResponse> QDropbox::requestDeltaAsync(QString cursor, QString path_prefix)
+{
+    QFutureInterface<QDropboxDeltaResponse> promise;
+    promise.reportStarted();
+
+    int reqnr = requestDelta(cursor, path_prefix);
+    addCompletion(reqnr, [promise](QDropboxJson json) mutable {
+        QDropboxDeltaResponse r;
+        if(json.isValid())
+            r = QDropboxDeltaResponse(json.strContent());
+        promise.reportFinished(&r);
+    });
+    return promise.future();
+}
+
+void QDropbox::startEventLoop(int reqnr)
 {
 #ifdef QTDROPBOX_DEBUG
-    qDebug() << "QDropbox::startEventLoop()" << endl;
+    qDebug() << "QDropbox::startEventLoop(" << reqnr << ")" << endl;
 #endif
-    if(_evLoop == NULL)
-        _evLoop = new QEventLoop(this);
-    _evLoop->exec();
+    if(reqnr < 0)
+        return;
+
+    QDropboxTraceSpan span(_tracer, "wait", "QDropbox", reqnr);
+
+    // every blocking call waits on its own loop so overlapping requests
+    // do not release each other
+    QEventLoop loop;
+    _evLoopMap[reqnr] = &loop;
+    loop.exec();
+    _evLoopMap.remove(reqnr);
     return;
 }
 
-void QDropbox::stopEventLoop()
+void QDropbox::stopEventLoop(int reqnr)
 {
 #ifdef QTDROPBOX_DEBUG
-    qDebug() << "QDropbox::stopEventLoop()" << endl;
+    qDebug() << "QDropbox::stopEventLoop(" << reqnr << ")" << endl;
 #endif
-    if(_evLoop == NULL)
+    if(!_evLoopMap.contains(reqnr))
         return;
 #ifdef QTDROPBOX_DEBUG
     qDebug() << "loop ended" << endl;
 #endif
-    _evLoop->exit();
+    _evLoopMap[reqnr]->exit();
+    return;
+}
+
+void QDropbox::storeResponse(int reqnr, const QDropboxJson &json)
+{
+    // coalesced requests share the parsed response
+    QList<int> group = requestGroup(reqnr);
+    for(int i=0; i<group.size(); ++i)
+    {
+        int nr = group.at(i);
+        if(_completionMap.contains(nr))
+            _completionMap.take(nr)(json);
+
+        // only keep responses somebody is waiting for
+        if(_evLoopMap.contains(nr))
+        {
+            qdropbox_response &r = _responseMap[nr];
+            r.json      = json;
+            r.error     = QDropbox::NoError;
+            r.errorText = "";
+        }
+    }
+    return;
+}
+
+void QDropbox::storeError(int reqnr)
+{
+    QList<int> group = requestGroup(reqnr);
+    for(int i=0; i<group.size(); ++i)
+    {
+        int nr = group.at(i);
+        if(!_evLoopMap.contains(nr))
+            continue;
+
+        qdropbox_response &r = _responseMap[nr];
+        r.json      = QDropboxJson();
+        r.error     = errorState;
+        r.errorText = errorText;
+    }
+    return;
+}
+
+qdropbox_response QDropbox::takeResponse(int reqnr)
+{
+    // requests that could not be sent never get a response
+    if(!_responseMap.contains(reqnr))
+    {
+        qdropbox_response r;
+        r.error     = errorState;
+        r.errorText = errorText;
+        return r;
+    }
+
+    // error() reports the error of the request that was waited for, even if
+    // other requests failed or succeeded in the meantime
+    qdropbox_response r = _responseMap.take(reqnr);
+    errorState = Error(r.error);
+    errorText  = r.errorText;
+    return r;
+}
+
+void QDropbox::addCompletion(int reqnr, std::function<void(QDropboxJson)> handler)
+{
+    // the request could not even be sent
+    if(reqnr < 0)
+    {
+        handler(QDropboxJson());
+        return;
+    }
+
+    _completionMap[reqnr] = handler;
     return;
 }
 
-void QDropbox::responseBlockedTokenRequest(QString response)
+void QDropbox::responseBlockedTokenRequest(QString response, int reqnr)
 {
     clearError();
     responseTokenRequest(response);
-    stopEventLoop();
+    stopEventLoop(reqnr);
     return;
 }
 
-void QDropbox::responseBlockingAccessToken(QString response)
+void QDropbox::responseBlockingAccessToken(QString response, int reqnr)
 {
     clearError();
     responseAccessToken(response);
-    stopEventLoop();
+    stopEventLoop(reqnr);
     return;
 }
 
-void QDropbox::parseBlockingMetadata(QString response)
+void QDropbox::parseBlockingMetadata(QString response, int reqnr)
 {
     clearError();
-    parseMetadata(response);
-    stopEventLoop();
+    parseMetadata(response, reqnr);
+    stopEventLoop(reqnr);
     return;
 }
 
-void QDropbox::parseBlockingDelta(QString response)
+void QDropbox::parseBlockingDelta(QString response, int reqnr)
 {
     clearError();
-    parseDelta(response);
-    stopEventLoop();
+    parseDelta(response, reqnr);
+    stopEventLoop(reqnr);
     return;
 }
 
-void QDropbox::parseBlockingSharedLink(QString response)
+void QDropbox::parseBlockingSharedLink(QString response, int reqnr)
 {
     clearError();
-    parseSharedLink(response);
-    stopEventLoop();
+    parseSharedLink(response, reqnr);
+    stopEventLoop(reqnr);
 	return;
 }
 
 // check if the event loop has to be stopped after a blocking request was sent
 void QDropbox::checkReleaseEventLoop(int reqnr)
 {
-    switch(requestMap[reqnr].type)
+    // the answer to a redirect releases the request it was forwarded from
+    if(requestMap.contains(reqnr) && requestMap[reqnr].type == QDROPBOX_REQ_REDIREC)
+        reqnr = requestMap[reqnr].linked;
+
+    QList<int> group = requestGroup(reqnr);
+    for(int i=0; i<group.size(); ++i)
     {
-    case QDROPBOX_REQ_RQBTOKN:
-    case QDROPBOX_REQ_BACCTOK:
-    case QDROPBOX_REQ_BACCINF:
-    case QDROPBOX_REQ_BMETADA:
-	case QDROPBOX_REQ_BREVISI:
-        stopEventLoop(); // release local event loop
-        break;
-    default:
-        break;
+        stopEventLoop(group.at(i)); // release local event loop, if any
+
+        // a future that did not get its response by now failed
+        if(_completionMap.contains(group.at(i)))
+            _completionMap.take(group.at(i))(QDropboxJson());
     }
     return;
 }
 
-void QDropbox::requestRevisions(QString file, int max, bool blocking)
+int QDropbox::requestRevisions(QString file, int max, bool blocking)
 {
 	clearError();
 
 	QUrl url;
     url.setUrl(apiurl.toString());
 
-    QUrlQuery urlQuery;
-    urlQuery.addQueryItem("oauth_consumer_key",_appKey);
-    urlQuery.addQueryItem("oauth_nonce", nonce);
-    urlQuery.addQueryItem("oauth_signature_method", signatureMethodString());
-    urlQuery.addQueryItem("oauth_timestamp", QString::number(timestamp));
-    urlQuery.addQueryItem("oauth_token", oauthToken);
-    urlQuery.addQueryItem("oauth_version", _version);
+    QUrlQuery urlQuery = oAuthQuery(nonce, timestamp);
     urlQuery.addQueryItem("rev_limit", QString::number(max));
 
     QString signature = oAuthSign(url);
@@ -1166,56 +2160,79 @@ void QDropbox::requestRevisions(QString file, int max, bool blocking)
     if(blocking)
     {
         requestMap[reqnr].type = QDROPBOX_REQ_BREVISI;
-        startEventLoop();
+        startEventLoop(reqnr);
     }
     else
         requestMap[reqnr].type = QDROPBOX_REQ_REVISIO;
 
-    return;
+    return reqnr;
 }
 
 QList<QDropboxFileInfo> QDropbox::requestRevisionsAndWait(QString file, int max)
 {
 	clearError();
-	requestRevisions(file, max, true);
+	int reqnr = requestRevisions(file, max, true);
 	QList<QDropboxFileInfo> revisionList;
 
-	if(errorState != QDropbox::NoError || !_tempJson.isValid())
+	qdropbox_response response = takeResponse(reqnr);
+	if(response.error != QDropbox::NoError || !response.json.isValid())
 		return revisionList;
 
-	QStringList responseList = _tempJson.getArray();
+	return revisionsFromJson(response.json);
+}
+
+QFuture<QList<QDropboxFileInfo> > QDropbox::requestRevisionsAsync(QString file, int max)
+{
+	QFutureInterface<QList<QDropboxFileInfo> > promise;
+	promise.reportStarted();
+
+	int reqnr = requestRevisions(file, max);
+	addCompletion(reqnr, [promise](QDropboxJson json) mutable {
+		QList<QDropboxFileInfo> revisionList = revisionsFromJson(json);
+		promise.reportFinished(&revisionList);
+	});
+	return promise.future();
+}
+
+QList<QDropboxFileInfo> QDropbox::revisionsFromJson(QDropboxJson json)
+{
+	QList<QDropboxFileInfo> revisionList;
+	if(!json.isValid())
+		return revisionList;
+
+	QList<QDropboxJson> responseList = json.getJsonArray();
 	for(int i=0; i<responseList.size(); ++i)
 	{
-		QString revData = responseList.at(i);
-		QDropboxFileInfo revision(revData);
+		QDropboxFileInfo revision(responseList.at(i));
 		revisionList.append(revision);
 	}
 
 	return revisionList;
 }
 
-void QDropbox::parseRevisions(QString response)
+void QDropbox::parseRevisions(QString response, int reqnr)
 {
-    QDropboxJson json;
-    _tempJson.parseString(response);
-    if(!_tempJson.isValid())
+    QDropboxJson json(response);
+    if(!json.isValid())
     {
         errorState = QDropbox::APIError;
         errorText  = "Dropbox API did not send correct answer for file/directory metadata.";
         emit errorOccured(errorState);
-        stopEventLoop();
+        storeError(reqnr);
+        stopEventLoop(reqnr);
         return;
     }
 
+    storeResponse(reqnr, json);
     emit revisionsReceived(response);
     return;
 }
 
-void QDropbox::parseBlockingRevisions(QString response)
+void QDropbox::parseBlockingRevisions(QString response, int reqnr)
 {
 	clearError();
-	parseRevisions(response);
-	stopEventLoop();
+	parseRevisions(response, reqnr);
+	stopEventLoop(reqnr);
 	return;
 }
 
@@ -1230,28 +2247,190 @@ qdropbox_request QDropbox::requestInfo(int rqnr)
 {
 	qdropbox_request request{ QDROPBOX_REQ_INVALID, "", "", 0 };
 
-	if (!requestMap.contains(rqnr)) {
-		return request; // invalid request
+	if (requestMap.contains(rqnr)) {
+		return requestMap[rqnr];
+	}
+
+	if (_historyIndex.contains(rqnr)) {
+		return _history.at(_historyIndex.value(rqnr));
 	}
 
-	return requestMap[rqnr];
+	return request; // invalid request
 }
 
 void QDropbox::removeRequestFromMap(int rqnr)
 {
-	if (!saveFinishedRequests())
+	if (!requestMap.contains(rqnr))
+		return;
+
+	qdropbox_request request = requestMap.take(rqnr);
+	addToStatistics(request);
+	addToHistory(request);
+	return;
+}
+
+void QDropbox::requestFailed(int nr)
+{
+	QDropboxTraceSpan span(_tracer, "fail", "QDropbox", nr);
+	if (tracing())
+		_tracer->flow('f', "QDropbox", nr);
+
+	// everybody waiting gets the error of the request
+	if (requestMap.contains(nr) && requestMap[nr].type == QDROPBOX_REQ_REDIREC)
+		storeError(requestMap[nr].linked);
+	else
+		storeError(nr);
+
+	// release everybody waiting and forget the request and all requests
+	// that were forwarded from or coalesced into it
+	checkReleaseEventLoop(nr);
+
+	if (requestMap.contains(nr) && requestMap[nr].type == QDROPBOX_REQ_REDIREC)
+	{
+		int origin = requestMap[nr].linked;
+		removeRequestFromMap(nr);
+		nr = origin;
+	}
+
+	QList<int> group = requestGroup(nr);
+	for (int i=0; i<group.size(); ++i)
+		removeRequestFromMap(group.at(i));
+	return;
+}
+
+void QDropbox::addToHistory(const qdropbox_request &request)
+{
+	if (_historySize <= 0)
+		return;
+
+	qdropbox_request record = request;
+	record.data.clear(); // the size is recorded in bytesSent
+
+	if (_history.size() < _historySize)
+		_history.append(record);
+	else
 	{
-		requestMap.remove(rqnr);
+		_historyIndex.remove(_history.at(_historyNext).number);
+		_history[_historyNext] = record;
 	}
+	_historyIndex[record.number] = _historyNext;
+	_historyNext = (_historyNext+1) % _historySize;
+	return;
+}
+
+void QDropbox::addToStatistics(const qdropbox_request &request)
+{
+	// requests answered by another request (coalesced) were never sent
+	// and end when they are retired
+	qint64 finished = (request.finished > 0)? request.finished : QDateTime::currentMSecsSinceEpoch();
+
+	QDropboxRequestStatistics &stats = _statistics[request.type];
+	if ((request.status == 0 && request.sent > 0) || request.status >= 400)
+		stats.errors++;
+	if (request.sent > 0)
+		stats.queueTime.add((request.sent - request.queued)*1000);
+	if (request.sent > 0 && request.firstByte > 0)
+		stats.timeToFirstByte.add((request.firstByte - request.sent)*1000);
+	stats.latency.add((finished - request.queued)*1000);
+	stats.parseTime.add(request.parseTime);
+	stats.bytesIn.add(request.bytesReceived);
+	stats.bytesOut.add(request.bytesSent);
+	return;
+}
+
+QDropboxRequestStatisticsMap QDropbox::requestStatistics()
+{
+	return _statistics;
+}
+
+QDropboxRequestStatistics QDropbox::requestStatistics(qdropbox_request_type type)
+{
+	return _statistics.value(type);
+}
+
+void QDropbox::resetRequestStatistics()
+{
+	_statistics.clear();
+	return;
+}
+
+void QDropbox::setStatisticsInterval(int msecs)
+{
+	if (msecs > 0)
+		_statisticsTimer.start(msecs);
+	else
+		_statisticsTimer.stop();
+	return;
+}
+
+int QDropbox::statisticsInterval()
+{
+	return _statisticsTimer.isActive()? _statisticsTimer.interval() : 0;
+}
+
+void QDropbox::reportStatistics()
+{
+	emit requestStatisticsReport(_statistics);
+	return;
+}
+
+void QDropbox::setTracer(QDropboxTracer *tracer)
+{
+	_tracer = tracer;
 	return;
 }
 
+QDropboxTracer *QDropbox::tracer()
+{
+	return _tracer;
+}
+
+bool QDropbox::tracing()
+{
+	return (_tracer != NULL && _tracer->isOpen());
+}
+
 void QDropbox::setSaveFinishedRequests(bool save)
 {
-	_saveFinishedRequests = save;
+	if (!save)
+		setRequestHistorySize(0);
+	else if (_historySize <= 0)
+		setRequestHistorySize(1000);
+	return;
 }
 
 bool QDropbox::saveFinishedRequests()
 {
-	return _saveFinishedRequests;
+	return (_historySize > 0);
+}
+
+void QDropbox::setRequestHistorySize(int size)
+{
+	QList<qdropbox_request> records = requestHistory();
+
+	_historySize = qMax(0, size);
+	_historyNext = 0;
+	_history.clear();
+	_history.reserve(_historySize);
+	_historyIndex.clear();
+
+	// keep the most recent records
+	for (int i=qMax(0, records.size()-_historySize); i<records.size(); ++i)
+		addToHistory(records.at(i));
+	return;
+}
+
+int QDropbox::requestHistorySize()
+{
+	return _historySize;
+}
+
+QList<qdropbox_request> QDropbox::requestHistory()
+{
+	QList<qdropbox_request> records;
+	// once the buffer is full the oldest record is the one overwritten next
+	int first = (_history.size() < _historySize)? 0 : _historyNext;
+	for (int i=0; i<_history.size(); ++i)
+		records.append(_history.at((first+i) % _history.size()));
+	return records;
 }
\ No newline at end of file
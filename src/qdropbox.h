@@ -12,6 +12,14 @@
 #include <QDomDocument>
 #include <QEventLoop>
 #include <QUrlQuery>
+#include <QFuture>
+#include <QFutureInterface>
+#include <QPointer>
+#include <QCache>
+#include <QVector>
+#include <QTimer>
+
+#include <functional>
 
 #ifdef QTDROPBOX_DEBUG
 #include <QDebug>
@@ -22,6 +30,8 @@
 #include "qdropboxaccount.h"
 #include "qdropboxfileinfo.h"
 #include "qdropboxdeltaresponse.h"
+#include "qdropboxstatistics.h"
+#include "qdropboxtracer.h"
 
 typedef int qdropbox_request_type;
 
@@ -55,6 +65,72 @@ struct qdropbox_request{
     QString method;             //!< Used method to send the request (POST/GET)
     QString host;               //!< Host that received the request
     int linked;                 //!< ID of any linked request (for forwarded requests)
+    QString path;               //!< Path of the file or directory the request refers to (if any)
+    QByteArray data;            //!< Data sent with POST requests (needed to retry the request)
+    int priority;               //!< Priority class the request is scheduled with (QDropbox::RequestPriority)
+    int retries;                //!< Number of times the request was sent again after being throttled
+    int number;                 //!< Number of the request
+    qint64 queued;              //!< Time the request was started (msecs since epoch)
+    qint64 sent;                //!< Time the request was handed to the network (msecs since epoch)
+    qint64 finished;            //!< Time the answer was received (msecs since epoch)
+    qint64 bytesSent;           //!< Size of the data sent with the request
+    qint64 bytesReceived;       //!< Size of the answer
+    int status;                 //!< HTTP status code of the answer
+    qint64 firstByte;           //!< Time the headers of the answer arrived (msecs since epoch)
+    qint64 parseTime;           //!< Time spent processing the answer in microseconds
+};
+
+//! Internally used struct to hold the outcome of a blocking request
+/*!
+  Blocking requests pick up their response after their event loop was released. The
+  error is kept with the response, so a blocking call reports the error of its own
+  request and not the last error of any request.
+ */
+struct qdropbox_response{
+    QDropboxJson json;          //!< Parsed response, invalid if the request failed
+    int error;                  //!< Error of the request (QDropbox::Error)
+    QString errorText;          //!< Description of the error
+};
+
+//! Internally used struct to hold network requests waiting for a free connection
+/*!
+  QDropbox limits the number of parallel connections to a host. Requests that exceed
+  the limit are kept in this structure until a connection to their host is released.
+ */
+struct qdropbox_pending_request{
+    QNetworkRequest   request;                     //!< Request to be sent
+    QByteArray        verb;                        //!< HTTP method (GET/PUT/POST)
+    QByteArray        data;                        //!< Data sent with PUT and POST requests
+    QPointer<QObject> owner;                       //!< Object the request is sent for
+    std::function<void(QNetworkReply*)> started;   //!< Called as soon as the request was sent
+    int               number;                      //!< Number of the QDropbox request, -1 for other owners
+};
+
+//! Internally used struct to cache everything needed to sign requests that does not change between requests
+/*!
+  The context is rebuilt whenever one of the credentials it was built from changes. Signing a
+  request then only has to process the per-request nonce, timestamp and URL.
+ */
+struct qdropbox_signing_context{
+    bool       valid;               //!< The context was built for a known signature method
+    int        method;              //!< Signature method the context was built for (QDropbox::OAuthMethod)
+    QString    appKey;              //!< Consumer key the context was built for
+    QString    appSecret;           //!< Consumer secret the context was built for
+    QString    token;               //!< Token the context was built for
+    QString    tokenSecret;         //!< Token secret the context was built for
+    QString    version;             //!< API version the context was built for
+    QString    signatureMethod;     //!< Value of oauth_signature_method
+    QString    plaintextSignature;  //!< Signature of the PLAINTEXT method (consumer secret & token secret)
+    QByteArray innerPad;            //!< HMAC-SHA1 key XOR inner padding
+    QByteArray outerPad;            //!< HMAC-SHA1 key XOR outer padding
+    QUrlQuery  query;               //!< Static OAuth query items including oauth_token
+    QUrlQuery  tokenlessQuery;      //!< Static OAuth query items without oauth_token
+};
+
+//! Internally used struct to cache metadata received from Dropbox
+struct qdropbox_cached_metadata{
+    QDropboxFileInfo info;  //!< Metadata as received from the server
+    qint64 received;        //!< Time of reception in msecs since epoch
 };
 
 //! The main entry point of QtDropbox API. Provides various connection facilities and general information.
@@ -94,11 +170,15 @@ struct qdropbox_request{
   non-blocking request will return immediately. Usually a blocking function directly returns a result
   and a non-blocking function will emit an according signal as the request has finished.
 
+  Every blocking request waits for its own answer. Blocking calls that overlap (e.g. when a slot
+  issues a blocking request while another one is still waiting) do not receive each other's
+  results.
+
   \warning The use of a blocking function will reset the current error flag. So after calling a blocking
   function the function error() will return QDropbox::NoError if no error occurred or the error that
   occurred when processing the blocking request.
 
-  \bug HMAC-SHA1 authentication is not working (does not have to be in 1.0)
+  Requests are signed with PLAINTEXT (over HTTPS) or HMAC-SHA1, see setAuthMethod().
 
  */
 class QTDROPBOXSHARED_EXPORT QDropbox : public QObject
@@ -107,7 +187,6 @@ class QTDROPBOXSHARED_EXPORT QDropbox : public QObject
 public:
     //! Method for oAuth authentication
     /*! These methods are used for authentication with the oAuth protocol
-        \bug Currently HMAC-SHA1 encoding does not work. (does not have to be in 1.0)
      */
     enum OAuthMethod{
         Plaintext, /*!< Plaintext authentication, HTTPS is automatically used. */
@@ -136,6 +215,18 @@ public:
         TokenExpired                    /*!< The access token has expired. Dropbox API error 401*/
     };
 
+    /*!
+      Priority classes of the request scheduler. Queued requests of a higher class are
+      sent before all queued requests of a lower class, requests of the same class are
+      sent in the order they were started.
+     */
+    enum RequestPriority{
+        InteractivePriority,            /*!< Latency sensitive requests a user is waiting for */
+        NormalPriority,                 /*!< Default priority */
+        BackgroundPriority              /*!< Bulk work like crawling a whole Dropbox. Background requests never
+                                             occupy the last free connection to a host. */
+    };
+
     /*!
       This constructor creates an unconfigured instance of QDropbox. The server URL is set to <em>api.dropbpx.com</em>,
       the REST API version 1.0 is used (currently the only one supported) and the authentication method is
@@ -162,6 +253,12 @@ public:
                       OAuthMethod method = QDropbox::Plaintext,
                       QString url = "api.dropbox.com", QObject *parent = 0);
 
+    /*!
+      Destroys the instance. Futures of requests that are still pending are finished with
+      an empty result.
+     */
+    ~QDropbox();
+
     /*!
       If an error occured you can access the last error code by using this function.
      */
@@ -179,6 +276,9 @@ public:
       official Dropbox API server according to the request. This is usually
       http://api.dropbox.com
 
+      A host name is accessed via HTTPS. To use a different scheme or port, e.g. for a
+      local test server, pass a complete URL like <em>http://127.0.0.1:8080</em>.
+
       \param url URL of the API server. Usually this is <em>api.dropbox.com</em>
      */
     void setApiUrl(QString url);
@@ -188,6 +288,25 @@ public:
      */
     QString apiUrl();
 
+    /*!
+      Changes the URL of the content server that is used by QDropboxFile to read and
+      write files. By default this is <em>api-content.dropbox.com</em>. This allows to
+      route file transfers through a local caching proxy, a regional endpoint or a test
+      server.
+
+      A host name is accessed via HTTPS. To use a different scheme or port pass a complete
+      URL like <em>http://127.0.0.1:8080</em>. QDropboxFile instances that have their own
+      content URL set by QDropboxFile::setContentUrl() are not affected.
+
+      \param url URL of the content server
+     */
+    void setContentUrl(QString url);
+
+    /*!
+      Provides you with the address of the content server.
+     */
+    QString contentUrl();
+
     /*!
       This function is used to changed the used authentication method. You can use it
       even if you want to change the authentication method during an already existing
@@ -344,8 +463,9 @@ public:
       will be emitted.
 
       \param blocking <i>internal only</i> indidicates if the call should block
+      \return number of the request
      */
-    void requestAccountInfo(bool blocking = false);
+    int requestAccountInfo(bool blocking = false);
 
     /*!
       Works exactly like accountInfo() but blocks until the data was received from the server.
@@ -354,6 +474,14 @@ public:
      */
     QDropboxAccount requestAccountInfoAndWait();
 
+    /*!
+      Works like requestAccountInfo() but returns a future that is resolved with the account
+      information as soon as the server answered. Neither blocks nor spins an event loop.
+      If the request fails the future is resolved with an empty QDropboxAccount and error()
+      describes the failure.
+     */
+    QFuture<QDropboxAccount> requestAccountInfoAsync();
+
     /*!
       This function is public for internal QtDropbox API use. It is used to sign
       requests to the Dropbox API and thus is required by most other QtDropbox
@@ -369,13 +497,36 @@ public:
      */
     QString signatureMethodString();
 
+    /*!
+      This function is public for internal QtDropbox API use. It returns the OAuth
+      query items every request has to carry (consumer key, nonce, signature method,
+      timestamp, token and version). All items except nonce and timestamp are
+      cached until the credentials change.
+
+      \param requestNonce Nonce of the request
+      \param requestTimestamp Timestamp of the request in seconds since epoch
+      \param withToken Include the oauth_token item (not known yet when requesting a token)
+     */
+    QUrlQuery oAuthQuery(QString requestNonce, qint64 requestTimestamp, bool withToken = true);
+
     /*!
       This functions generates and returns a nonce with the given length. The
-      generated nonce is a random hex based string.
+      generated nonce is a random hex based string. With Qt 5.10 or later the
+      random data is taken from the system's cryptographically secure generator.
+
+      \param length Length of the nonce. The default of 32 hex digits carries 128 random bits.
+     */
+    static QString generateNonce(qint32 length = 32);
+
+    /*!
+      This function is public for internal QtDropbox API use. It computes the HMAC-SHA1
+      (RFC 2104) of a message that is used to sign requests with the HMAC-SHA1 method.
 
-      \param length Length of the nonce.
+      \param key Secret key, keys longer than 64 bytes are hashed first
+      \param message Signed message
+      \return base64 encoded HMAC
      */
-    static QString generateNonce(qint32 length);
+    static QString hmacsha1(QByteArray key, QByteArray message);
 
     /*!
       Get the file metadata for a file speciified by the filename. When the Dropbox
@@ -384,8 +535,9 @@ public:
 
       \param file The absoulte path of the file (e.g. <i>/dropbox/test.txt</i>)
       \param blocking <i>internal only</i> indidicates if the call should block
+      \return number of the request
     */
-    void requestMetadata(QString file, bool blocking = false);
+    int requestMetadata(QString file, bool blocking = false);
 
     /*!
       Works exactly like QDropbox::requestMetadata() but blocks until the metadata
@@ -396,12 +548,21 @@ public:
      */
     QDropboxFileInfo requestMetadataAndWait(QString file);
 
+    /*!
+      Works like requestMetadata() but returns a future that is resolved with the metadata of
+      the file as soon as the server answered. If the request fails the future is resolved with
+      an empty QDropboxFileInfo.
+      \param file The absoulte path of the file (e.g. <i>/dropbox/test.txt</i>)
+     */
+    QFuture<QDropboxFileInfo> requestMetadataAsync(QString file);
+
     /*!
      * \brief Creates and returns a Dropbox link to files or folders users can use to view a preview of the file in a web browser.
      * \param path from the file i.e. /dropbox/hello.txt
      * \param blocking
+     * \return number of the request
      */
-    void requestSharedLink(QString file, bool blocking = false);
+    int requestSharedLink(QString file, bool blocking = false);
 
     /*!
     * \brief Works exactly like QDropbox::requestSharedLink() but blocks until link
@@ -410,6 +571,13 @@ public:
     * \return Url to the file
     */
     QUrl requestSharedLinkAndWait(QString file);
+
+    /*!
+     * \brief Works like QDropbox::requestSharedLink() but returns a future that is resolved with
+     * the link as soon as the server answered. A failed request resolves with an empty QUrl.
+     * \param path from the file i.e. /dropbox/hello.txt
+     */
+    QFuture<QUrl> requestSharedLinkAsync(QString file);
     
     /*!
       Resets the last error. Use this when you reacted on an error to delete the error flag.
@@ -423,8 +591,9 @@ public:
 	  \param file The absoulte path of the file (e.g. <i>/dropbox/test.txt</i>)
 	  \param max Defines the maximum amount of revisions to be requested.
 	  \param blocking <i>internal only</i> indidicates if the call should block
+	  \return number of the request
 	 */
-	void requestRevisions(QString file, int max = 10, bool blocking = false);
+	int requestRevisions(QString file, int max = 10, bool blocking = false);
 
 	/*!
 	  Works exactly like QDropbox::requestRevisions but blocks until the list of revisisions was
@@ -435,6 +604,14 @@ public:
 	 */
 	QList<QDropboxFileInfo> requestRevisionsAndWait(QString file, int max = 10);
 
+	/*!
+	  Works like QDropbox::requestRevisions but returns a future that is resolved with the list
+	  of revisions as soon as the server answered. A failed request resolves with an empty list.
+	  \param file The absoulte path of the file (e.g. <i>/dropbox/test.txt</i>)
+	  \param max Defines the maximum amount of revisions to be requested.
+	 */
+	QFuture<QList<QDropboxFileInfo> > requestRevisionsAsync(QString file, int max = 10);
+
 
     /*!
       \brief Produces a list of delta entries. When the request is answered by the Dropbox server
@@ -442,9 +619,10 @@ public:
 
       \param cursor A string used to keep track of current delta state.
       \param path_prefix If non-empty, only include entries with given prefix.
+      \return number of the request
 
      */
-    void requestDelta(QString cursor, QString path_prefix, bool blocking = false);
+    int requestDelta(QString cursor, QString path_prefix, bool blocking = false);
 
     /*!
       \brief Works exactly like QDropbox::requestDelta but blocks until the list of delta
@@ -458,6 +636,15 @@ public:
      */
      QDropboxDeltaResponse requestDeltaAndWait(QString cursor, QString path_prefix);
 
+    /*!
+      \brief Works like QDropbox::requestDelta but returns a future that is resolved with the
+      delta response as soon as the server answered. A failed request resolves with a blank
+      QDropboxDeltaResponse.
+      \param cursor A string used to keep track of current delta state.
+      \param path_prefix If non-empty, only includes entries with given prefix.
+     */
+     QFuture<QDropboxDeltaResponse> requestDeltaAsync(QString cursor, QString path_prefix);
+
 	 /*!
 	   \brief Provides information about a request.
 
@@ -466,7 +653,8 @@ public:
 
 	   Requesting information about a request number that does not exist will return invalid information.
 
-	   Requesting information on a request that has been finished already will return an invalid record.
+	   Requesting information on a request that has been finished already will return an invalid record
+	   unless the request is still kept in the request history (see setRequestHistorySize()).
 
 	   \param rqnr number of the request
 	 */
@@ -476,12 +664,12 @@ public:
 		\brief For debugging: Save finished requests so information can be requested on them.
 
 		This function is for debugging errors. When the setting is changed to true records of already
-		finished requests to Dropbox will be saved. Usually they are deleted as soon as they are
-		processed. Saving them will allow you to use requestInfo(...) on already finished requests.
+		finished requests to Dropbox will be saved in the request history. Usually they are deleted as
+		soon as they are processed. Saving them will allow you to use requestInfo(...) on already finished
+		requests.
 
-		Activating this setting may have an impact about long-time performance and used memory.
-
-		Old records will not be deleted when the setting is turned off!
+		Turning the setting on is the same as setting the request history size to 1000 (unless a history
+		is kept already), turning it off clears the history.
 
 		\param save set to true if you want to persist request information
 	 */
@@ -492,6 +680,278 @@ public:
 	 */
 	 bool saveFinishedRequests();
 
+	 /*!
+		\brief Sets how many finished requests are kept in the request history.
+
+		The history is a ring buffer: once it is full the record of the oldest request is replaced,
+		so the memory used stays constant no matter how long the application runs. Records include
+		timing, byte counts, the HTTP status and the number of retries of a request. Changing the
+		size keeps the most recent records. The default is 0 (no history).
+
+		\param size maximum number of records
+	 */
+	 void setRequestHistorySize(int size);
+
+	 /*!
+		\brief Returns how many finished requests are kept in the request history.
+	 */
+	 int requestHistorySize();
+
+	 /*!
+		\brief Returns the records of the request history, oldest first.
+	 */
+	 QList<qdropbox_request> requestHistory();
+
+    /*!
+      \brief Returns the network access manager used for all requests of this instance.
+
+      The manager is shared with every QDropboxFile that uses this QDropbox, so connections
+      (including their TLS sessions) are kept alive and reused across files. Use it to
+      configure proxies or caches.
+     */
+    QNetworkAccessManager *networkAccessManager();
+
+    /*!
+      \brief Limits the number of parallel connections to a single host.
+
+      Requests of QDropbox and all its QDropboxFile instances that exceed the limit are
+      queued and sent as soon as a connection to the host is released. The default
+      is 6.
+      \param max maximum number of parallel connections per host (at least 1)
+     */
+    void setMaxConnectionsPerHost(int max);
+
+    /*!
+      \brief Returns the maximum number of parallel connections per host.
+     */
+    int maxConnectionsPerHost();
+
+    /*!
+      \brief Limits the number of parallel connections to the given host.
+
+      Overrides the limit set by setMaxConnectionsPerHost(int) for a single host, e.g. to
+      keep file transfers to <em>api-content.dropbox.com</em> from using all connections
+      while metadata requests to <em>api.dropbox.com</em> get a larger share.
+      \param host host name like <em>api.dropbox.com</em>
+      \param max maximum number of parallel connections to the host (at least 1) or
+                 -1 to use the default limit again
+     */
+    void setMaxConnectionsPerHost(QString host, int max);
+
+    /*!
+      \brief Returns the maximum number of parallel connections to the given host.
+     */
+    int maxConnectionsPerHost(QString host);
+
+    /*!
+      \brief Sets the priority of requests started afterwards.
+
+      All requests QDropbox starts after this call are scheduled with the given priority
+      until it is changed again. Requests of QDropboxFile use the priority set by
+      QDropboxFile::setRequestPriority(). The default is QDropbox::NormalPriority.
+      \param priority priority class of the following requests
+     */
+    void setRequestPriority(RequestPriority priority);
+
+    /*!
+      \brief Returns the priority of requests started by QDropbox.
+     */
+    RequestPriority requestPriority();
+
+    /*!
+      \brief Returns the number of requests waiting for a free connection.
+     */
+    int queuedRequests();
+
+    /*!
+      \brief Returns the number of requests of the given priority waiting for a free connection.
+     */
+    int queuedRequests(RequestPriority priority);
+
+    /*!
+      \brief Returns the number of connections to the given host currently in use.
+     */
+    int activeConnections(QString host);
+
+    /*!
+      This function is public for internal QtDropbox API use. It queues a request on the
+      shared connection pool and sends it as soon as a connection to the host is free.
+      \param owner Object the request is sent for. Queued requests of deleted owners are dropped.
+      \param request Request to be sent
+      \param verb HTTP method (GET, PUT or POST)
+      \param data Data sent with PUT and POST requests
+      \param priority Priority class used to schedule the request
+      \param started Called with the reply as soon as the request was sent
+      \param number Number of the QDropbox request that is sent, used to reschedule it
+     */
+    void sendNetworkRequest(QObject *owner, QNetworkRequest request, QByteArray verb, QByteArray data,
+                            RequestPriority priority, std::function<void(QNetworkReply*)> started,
+                            int number = -1);
+
+    /*!
+      This function is public for internal QtDropbox API use. It removes all requests of the
+      given owner that still wait for a free connection.
+      \param owner Object the requests were sent for
+      \return number of removed requests
+     */
+    int cancelNetworkRequests(QObject *owner);
+
+    /*!
+      \brief Sets how long metadata stays in the metadata cache.
+
+      requestMetadataAndWait() and requestMetadataAsync() answer from the cache as long as
+      the cached metadata is younger than the given time. Uploads through QDropboxFile and
+      entries received by requestDelta() remove changed paths from the cache.
+
+      Directory listings are kept regardless of the time to live and revalidated once they
+      expired: their hash is sent to the server which answers with 304 Not Modified if
+      nothing changed. The cached listing is used then without transferring or parsing it
+      again. The default is 0, every request is sent to the server then and never answered
+      with stale metadata. Use setMetadataCacheSize() with 0 to disable the cache entirely.
+      \param msecs time to live of cached metadata in milliseconds
+     */
+    void setMetadataCacheTtl(int msecs);
+
+    /*!
+      \brief Returns the time to live of cached metadata in milliseconds.
+     */
+    int metadataCacheTtl();
+
+    /*!
+      \brief Sets the number of paths the metadata cache holds.
+
+      If the cache is full the least recently used metadata is dropped. The default is 1000,
+      0 disables the cache and the revalidation of directory listings.
+      \param entries maximum number of cached paths
+     */
+    void setMetadataCacheSize(int entries);
+
+    /*!
+      \brief Returns the maximum number of paths in the metadata cache.
+     */
+    int metadataCacheSize();
+
+    /*!
+      \brief Removes a path, everything below it and the listing of its parent directory
+      from the metadata cache.
+      \param file The absoulte path of the file (e.g. <i>/dropbox/test.txt</i>)
+     */
+    void invalidateMetadataCache(QString file);
+
+    /*!
+      \brief Removes everything from the metadata cache.
+     */
+    void clearMetadataCache();
+
+    /*!
+      \brief Returns how many metadata requests were answered from the cache.
+     */
+    int metadataCacheHits();
+
+    /*!
+      \brief Returns how many metadata requests had to be sent to the server.
+     */
+    int metadataCacheMisses();
+
+    /*!
+      \brief Sets how often a throttled request is retried.
+
+      Requests that are answered with 503 (QDROPBOX_ERROR_REQUEST_CAP) are sent again after
+      a backoff delay. The delay grows exponentially with every retry, is randomized to keep
+      throttled clients from retrying in lockstep and is never shorter than the time the
+      server asked for in its Retry-After header. Only if all retries were throttled as well
+      the request fails with QDropbox::MaxRequestsExceeded. The default is 5, 0 disables
+      retries.
+
+      Throttling also slows down all further requests of this instance (including those of
+      its QDropboxFile instances): the request rate is halved whenever the server throttles
+      and slowly increased again with every successful request.
+      \param retries maximum number of retries per request
+     */
+    void setMaxRetries(int retries);
+
+    /*!
+      \brief Returns how often a throttled request is retried.
+     */
+    int maxRetries();
+
+    /*!
+      \brief Sets the backoff delay before the first retry of a throttled request.
+
+      The delay doubles with every further retry up to one minute. The default is 1000.
+      \param msecs delay in milliseconds
+     */
+    void setRetryBaseDelay(int msecs);
+
+    /*!
+      \brief Returns the backoff delay before the first retry of a throttled request.
+     */
+    int retryBaseDelay();
+
+    /*!
+      \brief Returns how many throttled requests were sent again.
+     */
+    int retryCount();
+
+    /*!
+      \brief Returns the total time in milliseconds throttled requests waited before they were sent again.
+     */
+    qint64 retryBackoffTime();
+
+    /*!
+      \brief Returns the current request rate limit in requests per second.
+
+      Returns 0 as long as the server did not throttle any request.
+     */
+    double requestRateLimit();
+
+    /*!
+      \brief Returns the statistics of all finished requests by operation type.
+
+      For every operation type (QDROPBOX_REQ_*) QDropbox measures queue time, time to first
+      byte, total latency, bytes sent and received and the time spent processing the
+      answer of each finished request. The measurements are collected in histograms until
+      resetRequestStatistics() is called.
+     */
+    QDropboxRequestStatisticsMap requestStatistics();
+
+    /*!
+      \brief Returns the statistics of all finished requests of the given operation type.
+      \param type operation type (QDROPBOX_REQ_*)
+     */
+    QDropboxRequestStatistics requestStatistics(qdropbox_request_type type);
+
+    /*!
+      \brief Clears the request statistics.
+     */
+    void resetRequestStatistics();
+
+    /*!
+      \brief Sets the interval of the requestStatisticsReport() signal.
+      \param msecs interval in milliseconds, 0 stops the reports (default)
+     */
+    void setStatisticsInterval(int msecs);
+
+    /*!
+      \brief Returns the interval of the requestStatisticsReport() signal.
+     */
+    int statisticsInterval();
+
+    /*!
+      \brief Sets the tracer the lifecycle of all requests is written to.
+
+      The requests of all QDropboxFile instances that use this QDropbox are traced as well.
+      The tracer is not owned by QDropbox and must stay valid until it is replaced or
+      QDropbox is deleted.
+      \param tracer open tracer or NULL to stop tracing (default)
+     */
+    void setTracer(QDropboxTracer *tracer);
+
+    /*!
+      \brief Returns the tracer set with setTracer() or NULL if tracing is disabled.
+     */
+    QDropboxTracer *tracer();
+
 signals:
     /*!
       This signal is emitted whenever an error occurs. The error is passed
@@ -586,6 +1046,14 @@ signals:
     */
     void deltaReceived(QString deltaJson);
 
+    /*!
+      Emitted periodically with the current request statistics if an interval was set
+      with setStatisticsInterval().
+
+      \param statistics Statistics of all finished requests by operation type
+     */
+    void requestStatisticsReport(QDropboxRequestStatisticsMap statistics);
+
 public slots:
 
 private slots:
@@ -608,6 +1076,7 @@ private:
     QString _appSharedSecret;
 
     QUrl        apiurl;
+    QUrl        contenturl;
     QString     nonce;
     long        timestamp;
     OAuthMethod oauthMethod;
@@ -624,41 +1093,123 @@ private:
     QString mail;
     QString password;
 
-    // for blocked functions
-    QEventLoop *_evLoop;
-    void startEventLoop();
-    void stopEventLoop();
-
-    // temporary memory
-    QDropboxJson _tempJson;
-
-    QDropboxAccount _account;
-
-	// indicates wether finished request shall be saved for debugging
-	// mind the possible performance impact!
-	bool _saveFinishedRequests;
-
-    QString hmacsha1(QString key, QString baseString);
+    // for blocked functions, one local event loop per waiting request
+    QMap<int,QEventLoop*> _evLoopMap;
+    void startEventLoop(int reqnr);
+    void stopEventLoop(int reqnr);
+
+    // parsed responses and errors of blocking requests until they are picked up
+    QMap<int,qdropbox_response> _responseMap;
+    void storeResponse(int reqnr, const QDropboxJson &json);
+    void storeError(int reqnr);
+    qdropbox_response takeResponse(int reqnr);
+
+    // completion handlers of asynchronous (future based) requests. They are
+    // called with the parsed response or an invalid json if the request failed.
+    QMap<int,std::function<void(QDropboxJson)> > _completionMap;
+    void addCompletion(int reqnr, std::function<void(QDropboxJson)> handler);
+
+    // identical GET requests in flight share one reply: the first one sent
+    // (by coalescing key) and the requests attached to it
+    QMap<QString,int> _inflightMap;
+    QMap<int,QList<int> > _coalescedMap;
+    static QString coalescingKey(QUrl request);
+    QList<int> requestGroup(int reqnr);
+
+    // connection pool shared with QDropboxFile, one queue per priority class
+    int _maxConnectionsPerHost;
+    QMap<QString,int> _hostConnectionLimits;
+    QMap<QString,int> _activeConnections;
+    QMap<QNetworkReply*,QString> _replyHostMap;
+    QList<qdropbox_pending_request> _pendingRequests[BackgroundPriority+1];
+    RequestPriority _requestPriority;
+    void dispatchRequest(int reqnr, QNetworkRequest rq);
+    void raisePriority(int reqnr, int priority);
+
+    // retries of throttled requests
+    int    _maxRetries;
+    int    _retryBaseDelay;
+    int    _retryCount;
+    qint64 _retryBackoffTime;
+    bool retryRequest(int reqnr, QNetworkReply *rply);
+    int retryDelay(int attempt, QNetworkReply *rply);
+    QUrlQuery renewOAuthQuery(QUrlQuery query, QUrl url);
+
+    // token bucket limiting the request rate once the server throttles
+    double _requestRate;     // requests per second, 0 if not throttled
+    double _requestRateMax;  // throttling ends when the rate grows beyond
+    double _bucketTokens;
+    qint64 _bucketUpdated;
+    qint64 _rateChanged;
+    qint64 _rateWindowStart;
+    int    _rateWindowCount;
+    int    _lastWindowCount;
+    QTimer _bucketTimer;
+    bool requestTokenAvailable();
+    void adaptRequestRate(QNetworkReply *rply);
+    void processPendingRequests();
+    void releaseConnection(QNetworkReply *rply);
+
+    // metadata cache, keyed by normalised path
+    QCache<QString,qdropbox_cached_metadata> _metadataCache;
+    int _metadataCacheTtl;
+    int _metadataCacheHits;
+    int _metadataCacheMisses;
+    static QString metadataCacheKey(QString path, bool stripRoot = true);
+    bool cachedMetadata(QString file, QDropboxFileInfo *info);
+    void cacheMetadata(QString file, const QDropboxFileInfo &info);
+    void invalidateMetadataKey(QString key);
+    void responseNotModified(int reqnr);
+    bool resendUncachedMetadata(int reqnr, QNetworkReply *rply);
+
+	// records of finished requests for debugging, a ring buffer with
+	// _historySize slots indexed by request number
+	int                       _historySize;
+	int                       _historyNext;
+	QVector<qdropbox_request> _history;
+	QHash<int,int>            _historyIndex;
+	void addToHistory(const qdropbox_request &request);
+
+	// measurements of finished requests by operation type
+	QDropboxRequestStatisticsMap _statistics;
+	QTimer                       _statisticsTimer;
+	void addToStatistics(const qdropbox_request &request);
+	void reportStatistics();
+
+	QDropboxTracer *_tracer;
+	bool tracing();
+
+    // static parts of the request signing, see signingContext()
+    qdropbox_signing_context _signing;
+    const qdropbox_signing_context &signingContext();
+
+    static QString hmacsha1(QByteArray baseString, const qdropbox_signing_context &context);
+    static void hmacsha1Pads(QByteArray key, QByteArray *innerPad, QByteArray *outerPad);
     void prepareApiUrl();
-    int  sendRequest(QUrl request, QString type = "GET", QByteArray postdata = 0, QString host = "");
+    int  sendRequest(QUrl request, QString type = "GET", QByteArray postdata = 0, QString host = "",
+                     bool coalesce = true);
     void responseTokenRequest(QString response);
-    void responseBlockedTokenRequest(QString response);
+    void responseBlockedTokenRequest(QString response, int reqnr);
     int  responseDropboxLogin(QString response, int reqnr);
     void responseAccessToken(QString response);
-    void responseBlockingAccessToken(QString response);
+    void responseBlockingAccessToken(QString response, int reqnr);
     void parseToken(QString response);
-    void parseAccountInfo(QString response);
-    void parseSharedLink(QString response);
+    void parseAccountInfo(QString response, int reqnr);
+    void parseSharedLink(QString response, int reqnr);
     void checkReleaseEventLoop(int reqnr);
-    void parseMetadata(QString response);
-    void parseBlockingAccountInfo(QString response);
-    void parseBlockingMetadata(QString response);
-    void parseBlockingSharedLink(QString response);
-	void parseRevisions(QString response);
-	void parseBlockingRevisions(QString response);
-    void parseDelta(QString response);
-    void parseBlockingDelta(QString response);
+    void parseMetadata(QString response, int reqnr);
+    void parseBlockingAccountInfo(QString response, int reqnr);
+    void parseBlockingMetadata(QString response, int reqnr);
+    void parseBlockingSharedLink(QString response, int reqnr);
+	void parseRevisions(QString response, int reqnr);
+	void parseBlockingRevisions(QString response, int reqnr);
+	static QList<QDropboxFileInfo> revisionsFromJson(QDropboxJson json);
+    void parseDelta(QString response, int reqnr);
+    void parseBlockingDelta(QString response, int reqnr);
 	void removeRequestFromMap(int rqnr);
+	void requestFailed(int nr);
+
+    void _init();
 };
 
 #endif // QDROPBOX_H
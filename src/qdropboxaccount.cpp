@@ -1,24 +1,55 @@
 #include "qdropboxaccount.h"
 
+//! Values of a QDropboxAccount that are shared between its copies
+class QDropboxAccountData : public QSharedData
+{
+public:
+    QDropboxAccountData() :
+        uid(0),
+        quotaShared(0),
+        quota(0),
+        quotaNormal(0)
+    {}
+
+    QUrl    referralLink;
+    QString displayName;
+    quint64 uid;
+    QString country;
+    QString email;
+    quint64 quotaShared;
+    quint64 quota;
+    quint64 quotaNormal;
+};
+
 QDropboxAccount::QDropboxAccount(QObject *parent) :
-    QDropboxJson(parent)
+    QDropboxJson(parent),
+    _data(new QDropboxAccountData())
 {
-    _quotaShared = 0;
-    _quota       = 0;
-    _quotaNormal = 0;
-    _uid         = 0;
 }
 
 QDropboxAccount::QDropboxAccount(QString jsonString, QObject *parent) :
-    QDropboxJson(jsonString, parent)
+    QDropboxJson(jsonString, parent),
+    _data(new QDropboxAccountData())
 {
 	_init();
 }
 
+QDropboxAccount::QDropboxAccount(const QDropboxJson &json, QObject *parent) :
+    QDropboxJson(json),
+    _data(new QDropboxAccountData())
+{
+    setParent(parent);
+	_init();
+}
+
 QDropboxAccount::QDropboxAccount(const QDropboxAccount& other) :
-    QDropboxJson()
+    QDropboxJson(other),
+    _data(other._data)
+{
+}
+
+QDropboxAccount::~QDropboxAccount()
 {
-    copyFrom(other);
 }
 
 void QDropboxAccount::_init()
@@ -55,28 +86,28 @@ void QDropboxAccount::_init()
         return;
     }
 
-    _referralLink.setUrl(getString("referral_link"), QUrl::StrictMode);
-    _displayName = getString("display_name");
-    _uid         = getInt("uid");
-    _country     = getString("country");
-    _email       = getString("email");
+    _data->referralLink.setUrl(getString("referral_link"), QUrl::StrictMode);
+    _data->displayName = getString("display_name");
+    _data->uid         = getInt("uid");
+    _data->country     = getString("country");
+    _data->email       = getString("email");
 
-    _quotaShared = quota->getUInt("shared", true);
-    _quota       = quota->getUInt("quota", true);
-    _quotaNormal = quota->getUInt("normal", true);
+    _data->quotaShared = quota->getUInt("shared", true);
+    _data->quota       = quota->getUInt("quota", true);
+    _data->quotaNormal = quota->getUInt("normal", true);
 
     valid = true;
 
 #ifdef QTDROPBOX_DEBUG
     qDebug() << "== account data ==" << endl;
-    qDebug() << "reflink: " << _referralLink << endl;
-    qDebug() << "displayname: " << _displayName << endl;
-    qDebug() << "uid: " << _uid << endl;
-    qDebug() << "country: " << _country << endl;
-    qDebug() << "email: " << _email << endl;
-    qDebug() << "quotaShared: " << _quotaShared << endl;
-    qDebug() << "quotaNormal: " << _quotaNormal << endl;
-    qDebug() << "quotaUsed: " << _quota << endl;
+    qDebug() << "reflink: " << _data->referralLink << endl;
+    qDebug() << "displayname: " << _data->displayName << endl;
+    qDebug() << "uid: " << _data->uid << endl;
+    qDebug() << "country: " << _data->country << endl;
+    qDebug() << "email: " << _data->email << endl;
+    qDebug() << "quotaShared: " << _data->quotaShared << endl;
+    qDebug() << "quotaNormal: " << _data->quotaNormal << endl;
+    qDebug() << "quotaUsed: " << _data->quota << endl;
     qDebug() << "== account data end ==" << endl;
 #endif
     return;
@@ -84,45 +115,45 @@ void QDropboxAccount::_init()
 
 QUrl QDropboxAccount::referralLink()  const
 {
-    return _referralLink;
+    return _data->referralLink;
 }
 
 QString QDropboxAccount::displayName()  const
 {
-    return _displayName;
+    return _data->displayName;
 }
 
 qint64 QDropboxAccount::uid()  const
 {
-    return _uid;
+    return _data->uid;
 }
 
 QString QDropboxAccount::country()  const
 {
-    return _country;
+    return _data->country;
 }
 
 QString QDropboxAccount::email()  const
 {
-    return _email;
+    return _data->email;
 }
 
 quint64 QDropboxAccount::quotaShared()  const
 {
-    return _quotaShared;
+    return _data->quotaShared;
 }
 
 quint64 QDropboxAccount::quota()  const
 {
-    return _quota;
+    return _data->quota;
 }
 
 quint64 QDropboxAccount::quotaNormal()  const
 {
-    return _quotaNormal;
+    return _data->quotaNormal;
 }
 
-QDropboxAccount &QDropboxAccount::operator =(QDropboxAccount &a)
+QDropboxAccount &QDropboxAccount::operator =(const QDropboxAccount &a)
 {
     copyFrom(a);
     return *this;
@@ -130,17 +161,11 @@ QDropboxAccount &QDropboxAccount::operator =(QDropboxAccount &a)
 
 void QDropboxAccount::copyFrom(const QDropboxAccount &other)
 {
+    QDropboxJson::operator=(other);
     this->setParent(other.parent());
 #ifdef QTDROPBOX_DEBUG
     qDebug() << "creating account from account" << endl;
     qDebug() << "taken reflink: " << other.referralLink().toString() << endl;
 #endif
-    _referralLink = other.referralLink();
-    _displayName  = other.displayName();
-    _uid          = other.uid();
-    _country      = other.country();
-    _email        = other.email();
-    _quotaShared  = other.quotaShared();
-    _quota    = other.quota();
-    _quotaNormal  = other.quotaNormal();
+    _data = other._data;
 }
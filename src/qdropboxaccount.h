@@ -3,8 +3,11 @@
 
 #include <QObject>
 #include <QUrl>
+#include <QSharedDataPointer>
 #include "qdropboxjson.h"
 
+class QDropboxAccountData;
+
 //! Stores information about a user account
 /*!
   This class is used to store user account information retrieved by using
@@ -16,6 +19,8 @@
   If any error occurs while interpreting the data the resultung QDropboxAccount
   object will be invalid. This can checked by using isValid().
 
+  QDropboxAccount is implicitly shared, copies do not parse the account data again.
+
   See https://www.dropbox.com/developers/reference/api#account-info for details.
 
  */
@@ -40,6 +45,15 @@ public:
      */
     QDropboxAccount(QString jsonString, QObject *parent = 0);
 
+    /*!
+      This constructor creates an object based on the data of an already parsed
+      JSON. The data of the JSON is shared and not parsed again.
+
+      \param json JSON data
+      \param parent Parent QObject.
+     */
+    explicit QDropboxAccount(const QDropboxJson &json, QObject *parent = 0);
+
     /*!
       Use this constructor to create a copy of an other QDropboxAccount.
 
@@ -47,6 +61,11 @@ public:
      */
     QDropboxAccount(const QDropboxAccount& other);
 
+    /*!
+      Cleans up the account on destruction.
+     */
+    ~QDropboxAccount();
+
     /*!
       Returns the referal link of the user.
      */
@@ -91,7 +110,7 @@ public:
       Overloaded operator to copy a QDropboxAccount by using =. Internally
       copyFrom() is called.
      */
-    QDropboxAccount& operator =(QDropboxAccount&);
+    QDropboxAccount& operator =(const QDropboxAccount&);
 
     /*!
       This function is used to copy the data from an other QDropboxAccount.
@@ -99,14 +118,7 @@ public:
     void copyFrom(const QDropboxAccount& a);
 
 private:  
-    QUrl    _referralLink;
-    QString _displayName;
-    quint64 _uid;
-    QString _country;
-    QString _email;
-    quint64 _quotaShared;
-    quint64 _quota;
-    quint64 _quotaNormal;
+    QSharedDataPointer<QDropboxAccountData> _data;
 
 	void _init();
 };
@@ -16,21 +16,17 @@ QDropboxDeltaResponse::QDropboxDeltaResponse(QString response)
     this->_cursor = js.getString("cursor");
     this->_has_more = js.getBool("has_more");
 
-    QStringList entriesList = js.getArray("entries");
+    // paths and metadata are taken from the parsed tree, no entry is parsed again
+    QStringList paths = js.getArrayColumn("entries", 0);
+    QList<QDropboxJson> metadata = js.getJsonArrayColumn("entries", 1);
 
-    for(QStringList::iterator i = entriesList.begin();
-        i != entriesList.end();
-        i++)
+    for(int i=0; i<paths.size(); ++i)
     {
-        QDropboxJson s(*i);
-        QStringList pair = s.getArray();
-
-        QSharedPointer<QDropboxFileInfo> val(
-                    new QDropboxFileInfo(
-                            pair.value(1)
-                        )
-                    );
-        this->_entries.insert(pair.value(0), val);
+        // deleted entries have no metadata and are mapped to a null pointer
+        QSharedPointer<QDropboxFileInfo> val;
+        if(metadata.at(i).isValid())
+            val = QSharedPointer<QDropboxFileInfo>(new QDropboxFileInfo(metadata.at(i)));
+        this->_entries.insert(paths.at(i), val);
     }
 }
 
@@ -1,33 +1,30 @@
 #include "qdropboxfile.h"
 
+#include <climits>
+
 QDropboxFile::QDropboxFile(QObject *parent) :
-    QIODevice(parent),
-    _conManager(this)
+    QIODevice(parent)
 {
     _init(NULL, "", 1024);
-    connectSignals();
 }
 
 QDropboxFile::QDropboxFile(QDropbox *api, QObject *parent) :
-    QIODevice(parent),
-    _conManager(this)
+    QIODevice(parent)
 {
     _init(api, "", 1024);
     obtainToken();
-    connectSignals();
 }
 
 QDropboxFile::QDropboxFile(QString filename, QDropbox *api, QObject *parent) :
-    QIODevice(parent),
-    _conManager(this)
+    QIODevice(parent)
 {
     _init(api, filename, 1024);
    obtainToken();
-   connectSignals();
 }
 
 QDropboxFile::~QDropboxFile()
 {
+    closeStream();
     if(_buffer != NULL)
         delete _buffer;
     if(_evLoop != NULL)
@@ -36,7 +33,7 @@ QDropboxFile::~QDropboxFile()
 
 bool QDropboxFile::isSequential() const
 {
-    return true;
+    return !_randomAccess;
 }
 
 bool QDropboxFile::open(QIODevice::OpenMode mode)
@@ -44,6 +41,9 @@ bool QDropboxFile::open(QIODevice::OpenMode mode)
 #ifdef QTDROPBOX_DEBUG
     qDebug() << "QDropboxFile::open(...)" << endl;
 #endif
+    // has to be known before QIODevice asks isSequential()
+    _randomAccess = (_readMode == RandomAccessRead && !(mode & QIODevice::WriteOnly));
+
     if(!QIODevice::open(mode))
         return false;
 
@@ -51,12 +51,64 @@ bool QDropboxFile::open(QIODevice::OpenMode mode)
         return true; */
 
     if(_buffer == NULL)
-        _buffer = new QByteArray();
+        _buffer = new QDropboxFileBuffer();
+
+    resetUploadSession();
+
+    if(_readMode == StreamingRead && !isMode(QIODevice::WriteOnly))
+    {
+#ifdef QTDROPBOX_DEBUG
+        qDebug() << "QDropboxFile: streaming file content" << endl;
+#endif
+        // the reply already buffers the data, no need for a second buffer
+        setOpenMode(openMode() | QIODevice::Unbuffered);
+        _buffer->clear();
+        _position = 0;
+        if(!openStream(_filename))
+            return false;
+
+        obtainMetadata();
+        return true;
+    }
+
+    if(_randomAccess)
+    {
+#ifdef QTDROPBOX_DEBUG
+        qDebug() << "QDropboxFile: random access to file content" << endl;
+#endif
+        // blocks are cached already, QIODevice does not need to buffer
+        setOpenMode(openMode() | QIODevice::Unbuffered);
+        _buffer->clear();
+        _blockCache.clear();
+        _fileSize = -1;
+        _position = 0;
+
+        // the first block tells us the size of the file
+        if(!fetchBlocks(0, 0))
+            return false;
+
+        if(_fileSize < 0)
+        {
+            lastErrorCode    = QDropbox::APIError;
+            lastErrorMessage = "Dropbox API did not send the size of the file.";
+#ifdef QTDROPBOX_DEBUG
+            qDebug() << "QDropboxFile: size of file unknown" << endl;
+#endif
+            return false;
+        }
+
+        obtainMetadata();
+        return true;
+    }
 
 #ifdef QTDROPBOX_DEBUG
     qDebug() << "QDropboxFile: opening file" << endl;
 #endif
 
+    // the content is kept in memory, reading it through the buffer of
+    // QIODevice would only copy it twice
+    setOpenMode(openMode() | QIODevice::Unbuffered);
+
 	// clear buffer and reset position if this file was opened in write mode
 	// with truncate - or if append was not set
 	if(isMode(QIODevice::WriteOnly) && 
@@ -91,7 +143,33 @@ bool QDropboxFile::open(QIODevice::OpenMode mode)
 void QDropboxFile::close()
 {
 	if(isMode(QIODevice::WriteOnly))
-		flush();
+    {
+        // a chunked upload session is only started once the flush threshold
+        // was reached - smaller files are still written with one files_put
+        bool written;
+        if(_chunkedUpload && !_uploadId.isEmpty())
+            written = putChunk() && commitChunkedUpload();
+        else
+            written = putFile();
+
+        if(!written)
+        {
+#ifdef QTDROPBOX_DEBUG
+            qDebug() << "QDropboxFile::close() content not written: " << lastErrorCode << lastErrorMessage << endl;
+#endif
+            closeStream();
+            _blockCache.clear();
+            QIODevice::close();
+
+            // QIODevice::close() clears the error string
+            setErrorString(QString("Content was not written: %1 %2")
+                           .arg(lastErrorCode).arg(lastErrorMessage).trimmed());
+            emit writeFailed(lastErrorCode, lastErrorMessage);
+            return;
+        }
+    }
+    closeStream();
+    _blockCache.clear();
 	QIODevice::close();
 	return;
 }
@@ -124,6 +202,9 @@ bool QDropboxFile::flush()
     qDebug() << "QDropboxFile::flush()" << endl;
 #endif
 
+    if(_chunkedUpload)
+        return putChunk();
+
     return putFile();
 }
 
@@ -159,28 +240,168 @@ bool QDropboxFile::overwrite()
     return _overwrite;
 }
 
+void QDropboxFile::setRequestPriority(QDropbox::RequestPriority priority)
+{
+    _requestPriority = priority;
+    return;
+}
+
+QDropbox::RequestPriority QDropboxFile::requestPriority()
+{
+    return _requestPriority;
+}
+
+void QDropboxFile::setContentUrl(QString url)
+{
+    _contentUrl = url;
+    return;
+}
+
+QString QDropboxFile::contentUrl()
+{
+    if(!_contentUrl.isEmpty())
+        return _contentUrl;
+    if(_api != NULL)
+        return _api->contentUrl();
+    return QDROPBOXFILE_CONTENT_URL;
+}
+
+void QDropboxFile::setChunkedUpload(bool chunked)
+{
+    _chunkedUpload = chunked;
+    return;
+}
+
+bool QDropboxFile::chunkedUpload()
+{
+    return _chunkedUpload;
+}
+
+void QDropboxFile::setReadMode(ReadMode mode)
+{
+    _readMode = mode;
+    return;
+}
+
+QDropboxFile::ReadMode QDropboxFile::readMode()
+{
+    return _readMode;
+}
+
+void QDropboxFile::setStreamBufferSize(qint64 size)
+{
+    if(size < 1)
+        size = 1;
+    _streamBufferSize = size;
+    if(_streamReply != NULL)
+        _streamReply->setReadBufferSize(size);
+    return;
+}
+
+qint64 QDropboxFile::streamBufferSize()
+{
+    return _streamBufferSize;
+}
+
+void QDropboxFile::setBlockSize(qint64 size)
+{
+    // the cost of a block is stored in an int
+    size = qBound<qint64>(1, size, INT_MAX);
+    if(size != _blockSize)
+        _blockCache.clear();
+    _blockSize = size;
+    if(_blockCache.maxCost() < _blockSize)
+        _blockCache.setMaxCost(int(_blockSize));
+    return;
+}
+
+qint64 QDropboxFile::blockSize()
+{
+    return _blockSize;
+}
+
+void QDropboxFile::setBlockCacheSize(qint64 size)
+{
+    size = qBound<qint64>(_blockSize, size, INT_MAX);
+    _blockCache.setMaxCost(int(size));
+    return;
+}
+
+qint64 QDropboxFile::blockCacheSize()
+{
+    return _blockCache.maxCost();
+}
+
+qint64 QDropboxFile::size() const
+{
+    if(_randomAccess && isOpen())
+        return qMax<qint64>(_fileSize, 0);
+
+    if(_streamReply == NULL && _buffer != NULL && isOpen())
+        return _buffer->size();
+
+    return QIODevice::size();
+}
+
+qint64 QDropboxFile::bytesAvailable() const
+{
+    if(_streamReply != NULL)
+        return QIODevice::bytesAvailable() + _streamReply->bytesAvailable();
+
+    // the content is read without buffering by QIODevice
+    if(!_randomAccess && _buffer != NULL && isOpen())
+        return QIODevice::bytesAvailable() + qMax<qint64>(_buffer->size() - _position, 0);
+
+    return QIODevice::bytesAvailable();
+}
+
+bool QDropboxFile::atEnd() const
+{
+    if(_streamReply != NULL)
+        return _streamReply->isFinished() && bytesAvailable() == 0;
+
+    return QIODevice::atEnd();
+}
+
+QByteArray QDropboxFile::peekView(qint64 maxlen) const
+{
+    if(_streamReply != NULL || _randomAccess || _buffer == NULL)
+        return QByteArray();
+
+    qint64 length;
+    const char *data = _buffer->constData(_position, &length);
+    if(data == NULL)
+        return QByteArray();
+
+    if(maxlen >= 0 && maxlen < length)
+        length = maxlen;
+    return QByteArray::fromRawData(data, int(length));
+}
+
 qint64 QDropboxFile::readData(char *data, qint64 maxlen)
 {
+    if(_streamReply != NULL)
+        return readStream(data, maxlen);
+
+    if(_randomAccess)
+        return readBlocks(data, maxlen);
+
 #ifdef QTDROPBOX_DEBUG
     qDebug() << "QDropboxFile::readData(...), maxlen = " << maxlen << endl;
-    QString buff_str = QString(*_buffer);
-    qDebug() << "old bytes = " << _buffer->toHex() << ", str: " << buff_str <<  endl;
+    QString buff_str = QString(_buffer->mid(0));
+    qDebug() << "old bytes = " << _buffer->mid(0).toHex() << ", str: " << buff_str <<  endl;
     qDebug() << "old size = " << _buffer->size() << endl;
 #endif
 
 	if(_buffer->size() == 0 || _position >= _buffer->size())
         return 0;
 
-    if(_buffer->size() < maxlen)
-        maxlen = _buffer->size();
-
-	QByteArray tmp = _buffer->mid(_position, maxlen);
-	const qint64 read = tmp.size();
-	memcpy(data, tmp.data(), read);
+    // copies straight from the pieces, clamped to the bytes behind _position
+	const qint64 read = _buffer->read(_position, data, maxlen);
    
 #ifdef QTDROPBOX_DEBUG
     qDebug() << "new size = " << _buffer->size() << endl;
-    qDebug() << "new bytes = " << _buffer->toHex() << endl;
+    qDebug() << "new bytes = " << _buffer->mid(0).toHex() << endl;
 #endif
 
 	_position += read;
@@ -191,14 +412,21 @@ qint64 QDropboxFile::readData(char *data, qint64 maxlen)
 qint64 QDropboxFile::writeData(const char *data, qint64 len)
 {
 #ifdef QTDROPBOX_DEBUG
-    qDebug() << "old content: " << _buffer->toHex() << endl;
+    qDebug() << "old content: " << _buffer->mid(0).toHex() << endl;
 #endif
 
 	qint64 oldlen = _buffer->size();
+
+    // inserting in front of already uploaded data invalidates the running
+    // upload session - the next flush has to start over
+    if(_chunkedUpload && _position < _uploadOffset)
+        resetUploadSession();
+
+    // only appends to the piece table, the content is not moved
     _buffer->insert(_position, data, len);
 
 #ifdef QTDROPBOX_DEBUG
-    qDebug() << "new content: " << _buffer->toHex() << endl;
+    qDebug() << "new content: " << _buffer->mid(0).toHex() << endl;
 #endif
 
     // flush if the threshold is reached
@@ -218,15 +446,20 @@ qint64 QDropboxFile::writeData(const char *data, qint64 len)
 
 void QDropboxFile::networkRequestFinished(QNetworkReply *rply)
 {
-    rply->deleteLater();
+    // a streamed reply is read until the file is closed
+    if(rply != _streamReply)
+        rply->deleteLater();
 
 #ifdef QTDROPBOX_DEBUG
     qDebug() << "QDropboxFile::networkRequestFinished(...)" << endl;
 #endif
 
-    if (rply->error() != QNetworkReply::NoError)
+    // range replies check the status themselves (416 for empty files), so do
+    // chunk replies (400 with the offset the server expects)
+    if (rply->error() != QNetworkReply::NoError && _waitMode != waitForRange && _waitMode != waitForChunk)
     {
-        lastErrorCode = rply->error();
+        lastErrorCode    = rply->error();
+        lastErrorMessage = rply->errorString();
         stopEventLoop();
         return;
     }
@@ -241,6 +474,17 @@ void QDropboxFile::networkRequestFinished(QNetworkReply *rply)
         rplyFileWrite(rply);
         stopEventLoop();
         break;
+    case waitForChunk:
+        rplyChunkUpload(rply);
+        stopEventLoop();
+        break;
+    case waitForStream:
+        stopEventLoop();
+        break;
+    case waitForRange:
+        rplyFileRange(rply);
+        stopEventLoop();
+        break;
     case notWaiting:
 		break; // when we are not waiting for anything, we don't do anything - simple!
     default:
@@ -260,10 +504,56 @@ void QDropboxFile::obtainToken()
     return;
 }
 
-void QDropboxFile::connectSignals()
+void QDropboxFile::sendRequest(QNetworkRequest rq, QByteArray verb, QByteArray data)
 {
-    connect(&_conManager, SIGNAL(finished(QNetworkReply*)),
-            this, SLOT(networkRequestFinished(QNetworkReply*)));
+    QDropboxTracer *tracer = _api->tracer();
+    if(tracer != NULL && !tracer->isOpen())
+        tracer = NULL;
+    qint64 traceId = (tracer != NULL)? tracer->nextId() : -1;
+    QDropboxTraceSpan span(tracer, "send", "QDropboxFile", traceId);
+    if(tracer != NULL)
+    {
+        tracer->flow('s', "QDropboxFile", traceId);
+        tracer->asyncBegin("queue", "QDropboxFile", traceId);
+    }
+
+    // the request is sent over the connection pool of the QDropbox instance
+    // and may wait there until a connection to the host is free
+    _api->sendNetworkRequest(this, rq, verb, data, _requestPriority, [this, verb, traceId](QNetworkReply *reply){
+        traceStarted(traceId);
+        connect(this, &QDropboxFile::operationAborted, reply, &QNetworkReply::abort);
+        if(verb == "GET")
+            connect(reply, &QNetworkReply::downloadProgress, this, &QDropboxFile::downloadProgress);
+        else if(verb == "PUT")
+            connect(reply, &QNetworkReply::uploadProgress, this, &QDropboxFile::uploadProgress);
+        connect(reply, &QNetworkReply::finished, this, [this, reply, traceId]{ tracedRequestFinished(reply, traceId); });
+    });
+    return;
+}
+
+void QDropboxFile::traceStarted(qint64 traceId)
+{
+    QDropboxTracer *tracer = _api->tracer();
+    if(traceId < 0 || tracer == NULL || !tracer->isOpen())
+        return;
+    tracer->asyncEnd("queue", "QDropboxFile", traceId);
+    tracer->asyncBegin("network", "QDropboxFile", traceId);
+    return;
+}
+
+void QDropboxFile::tracedRequestFinished(QNetworkReply *rply, qint64 traceId)
+{
+    QDropboxTracer *tracer = _api->tracer();
+    if(traceId < 0 || tracer == NULL || !tracer->isOpen())
+    {
+        networkRequestFinished(rply);
+        return;
+    }
+
+    tracer->asyncEnd("network", "QDropboxFile", traceId);
+    QDropboxTraceSpan span(tracer, "parse", "QDropboxFile", traceId);
+    tracer->flow('f', "QDropboxFile", traceId);
+    networkRequestFinished(rply);
     return;
 }
 
@@ -272,40 +562,37 @@ bool QDropboxFile::isMode(QIODevice::OpenMode mode)
     return ( (openMode()&mode) == mode );
 }
 
-bool QDropboxFile::getFileContent(QString filename)
+QUrl QDropboxFile::downloadUrl(QString filename)
 {
-#ifdef QTDROPBOX_DEBUG
-    qDebug() << "QDropboxFile::getFileContent(...)" << endl;
-#endif
     QUrl request;
-    request.setUrl(QDROPBOXFILE_CONTENT_URL, QUrl::StrictMode);
+    request.setUrl(contentUrl(), QUrl::StrictMode);
     request.setPath(QString("/%1/files/%2")
                     .arg(_api->apiVersion().left(1))
                     .arg(filename));
 
-    QUrlQuery query;
-    query.addQueryItem("oauth_consumer_key", _api->appKey());
-    query.addQueryItem("oauth_nonce", QDropbox::generateNonce(128));
-    query.addQueryItem("oauth_signature_method", _api->signatureMethodString());
-    query.addQueryItem("oauth_timestamp", QString::number((int) QDateTime::currentMSecsSinceEpoch()/1000));
-    query.addQueryItem("oauth_token", _api->token());
-    query.addQueryItem("oauth_version", _api->apiVersion());
+    QUrlQuery query = _api->oAuthQuery(QDropbox::generateNonce(), QDateTime::currentMSecsSinceEpoch()/1000);
 
     QString signature = _api->oAuthSign(request);
     query.addQueryItem("oauth_signature", signature);
 
     request.setQuery(query);
+    return request;
+}
+
+bool QDropboxFile::getFileContent(QString filename)
+{
+#ifdef QTDROPBOX_DEBUG
+    qDebug() << "QDropboxFile::getFileContent(...)" << endl;
+#endif
+    QUrl request = downloadUrl(filename);
 
 #ifdef QTDROPBOX_DEBUG
     qDebug() << "QDropboxFile::getFileContent " << request.toString() << endl;
 #endif
 
     QNetworkRequest rq(request);
-    QNetworkReply *reply = _conManager.get(rq);
-    connect(this, &QDropboxFile::operationAborted, reply, &QNetworkReply::abort);
-    connect(reply, &QNetworkReply::downloadProgress, this, &QDropboxFile::downloadProgress);
-
     _waitMode = waitForRead;
+    sendRequest(rq, "GET");
     startEventLoop();
 
     if(lastErrorCode != 0)
@@ -327,6 +614,303 @@ bool QDropboxFile::getFileContent(QString filename)
     return true;
 }
 
+bool QDropboxFile::openStream(QString filename)
+{
+#ifdef QTDROPBOX_DEBUG
+    qDebug() << "QDropboxFile::openStream(...)" << endl;
+#endif
+    closeStream();
+    lastErrorCode    = 0;
+    lastErrorMessage = "";
+
+    QNetworkRequest rq(downloadUrl(filename));
+    _waitMode = waitForStream;
+
+    QDropboxTracer *tracer = _api->tracer();
+    if(tracer != NULL && !tracer->isOpen())
+        tracer = NULL;
+    qint64 traceId = (tracer != NULL)? tracer->nextId() : -1;
+
+    // the span covers sending the request like in sendRequest(), but not the
+    // wait for the answer below
+    {
+        QDropboxTraceSpan span(tracer, "send", "QDropboxFile", traceId);
+        if(tracer != NULL)
+        {
+            tracer->flow('s', "QDropboxFile", traceId);
+            tracer->asyncBegin("queue", "QDropboxFile", traceId);
+        }
+
+        _api->sendNetworkRequest(this, rq, "GET", QByteArray(), _requestPriority, [this, traceId](QNetworkReply *reply){
+            traceStarted(traceId);
+            _streamReply = reply;
+            _streamReply->setReadBufferSize(_streamBufferSize);
+            connect(this, &QDropboxFile::operationAborted, _streamReply, &QNetworkReply::abort);
+            connect(_streamReply, &QNetworkReply::downloadProgress, this, &QDropboxFile::downloadProgress);
+            connect(_streamReply, &QNetworkReply::readyRead, this, &QDropboxFile::streamReadyRead);
+            connect(_streamReply, &QNetworkReply::metaDataChanged, this, &QDropboxFile::streamMetaDataChanged);
+            connect(_streamReply, &QNetworkReply::finished, this, [this, reply, traceId]{ tracedRequestFinished(reply, traceId); });
+        });
+    }
+
+    // wait until the server answered with a status code
+    if(_streamReply == NULL || !_streamReply->isFinished())
+        startEventLoop();
+    _waitMode = notWaiting;
+
+    // aborted while waiting for a free connection
+    if(_streamReply == NULL)
+        return false;
+
+    // readyRead() is held back until open() returned
+    if(_streamReply->bytesAvailable() > 0)
+        QMetaObject::invokeMethod(this, "readyRead", Qt::QueuedConnection);
+
+    int status = _streamReply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    if(status == QDROPBOX_ERROR_FILE_NOT_FOUND)
+    {
+#ifdef QTDROPBOX_DEBUG
+        qDebug() << "QDropboxFile::openStream: file does not exist" << endl;
+#endif
+        // same as in buffered mode: a missing file is an empty file
+        closeStream();
+        return true;
+    }
+
+    if(status >= QDROPBOX_ERROR_BAD_INPUT ||
+       (_streamReply->isFinished() && _streamReply->error() != QNetworkReply::NoError))
+    {
+        lastErrorCode = (status != 0) ? status : _streamReply->error();
+        QDropboxJson json(QString(_streamReply->readAll()).trimmed());
+        if(json.isValid())
+            lastErrorMessage = json.getString("error");
+        else
+            lastErrorMessage = _streamReply->errorString();
+#ifdef QTDROPBOX_DEBUG
+        qDebug() << "QDropboxFile::openStream ReadError: " << lastErrorCode << lastErrorMessage << endl;
+#endif
+        closeStream();
+        return false;
+    }
+
+    return true;
+}
+
+qint64 QDropboxFile::readStream(char *data, qint64 maxlen)
+{
+    // block until data arrived - consumers like QDataStream expect a read
+    // to succeed as long as the stream did not end
+    while(_streamReply->bytesAvailable() == 0 && !_streamReply->isFinished())
+    {
+        _waitMode = waitForStream;
+        startEventLoop();
+        _waitMode = notWaiting;
+    }
+
+    qint64 read = _streamReply->read(data, maxlen);
+    if(read > 0)
+        _position += read;
+
+#ifdef QTDROPBOX_DEBUG
+    qDebug() << "QDropboxFile::readStream(...) read " << read << " byte" << endl;
+#endif
+
+    // the data received before the download broke off is read first
+    if(read <= 0 && _streamReply->isFinished() && _streamReply->error() != QNetworkReply::NoError)
+    {
+        lastErrorCode    = _streamReply->error();
+        lastErrorMessage = _streamReply->errorString();
+        setErrorString(lastErrorMessage);
+#ifdef QTDROPBOX_DEBUG
+        qDebug() << "QDropboxFile::readStream ReadError: " << lastErrorCode << lastErrorMessage << endl;
+#endif
+        return -1;
+    }
+
+    // the end of a complete download is no error
+    return qMax<qint64>(read, 0);
+}
+
+void QDropboxFile::closeStream()
+{
+    if(_streamReply == NULL)
+        return;
+
+    QNetworkReply *reply = _streamReply;
+    _streamReply = NULL;
+
+    // deleting a running reply aborts the download
+    disconnect(reply, 0, this, 0);
+    reply->deleteLater();
+    return;
+}
+
+bool QDropboxFile::fetchBlocks(qint64 first, qint64 last)
+{
+    qint64 start = first*_blockSize;
+    qint64 end   = (last+1)*_blockSize-1;
+    if(_fileSize >= 0 && end >= _fileSize)
+        end = _fileSize-1;
+
+#ifdef QTDROPBOX_DEBUG
+    qDebug() << "QDropboxFile::fetchBlocks(...) bytes " << start << "-" << end << endl;
+#endif
+
+    QNetworkRequest rq(downloadUrl(_filename));
+    rq.setRawHeader("Range", QString("bytes=%1-%2").arg(start).arg(end).toLatin1());
+    _waitMode = waitForRange;
+    sendRequest(rq, "GET");
+    startEventLoop();
+    _waitMode = notWaiting;
+
+    if(lastErrorCode != 0)
+    {
+#ifdef QTDROPBOX_DEBUG
+        qDebug() << "QDropboxFile::fetchBlocks ReadError: " << lastErrorCode << lastErrorMessage << endl;
+#endif
+        return false;
+    }
+
+    return true;
+}
+
+qint64 QDropboxFile::readBlocks(char *data, qint64 maxlen)
+{
+    // reading at the end of the file is no error
+    if(_position >= _fileSize || maxlen <= 0)
+        return 0;
+
+    if(maxlen > _fileSize-_position)
+        maxlen = _fileSize-_position;
+
+    // blocks that are cached already are not downloaded again and a
+    // single request never fetches more than the cache can hold
+    const qint64 maxBlocks = qMax<qint64>(1, _blockCache.maxCost()/_blockSize);
+    const qint64 lastNeeded = (_position+maxlen-1)/_blockSize;
+
+    qint64 read = 0;
+    bool failed = false;
+    while(read < maxlen)
+    {
+        qint64 index = (_position+read)/_blockSize;
+        if(!_blockCache.contains(index))
+        {
+            qint64 last = index;
+            while(last < lastNeeded && last-index+1 < maxBlocks && !_blockCache.contains(last+1))
+                last++;
+
+            if(!fetchBlocks(index, last))
+            {
+                failed = true;
+                break;
+            }
+        }
+
+        QByteArray *block = _blockCache.object(index);
+        qint64 offset = (_position+read)-index*_blockSize;
+        if(block == NULL || offset >= block->size())
+            break;
+
+        qint64 len = qMin(maxlen-read, block->size()-offset);
+        memcpy(data+read, block->constData()+offset, len);
+        read += len;
+    }
+
+    // data that was read before a download failed is returned first
+    if(read == 0 && failed)
+    {
+        setErrorString(lastErrorMessage);
+        return -1;
+    }
+
+    _position += read;
+    return read;
+}
+
+void QDropboxFile::rplyFileRange(QNetworkReply *rply)
+{
+    lastErrorCode = 0;
+
+    int status = rply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+
+    // the requested range starts behind the end of the file - this only
+    // happens for empty files
+    if(status == 416)
+    {
+        _fileSize = 0;
+        return;
+    }
+
+    QByteArray response = rply->readAll();
+
+    if(status >= QDROPBOX_ERROR_BAD_INPUT || rply->error() != QNetworkReply::NoError)
+    {
+        lastErrorCode = (status != 0) ? status : rply->error();
+        QDropboxJson json(QString(response).trimmed());
+        if(json.isValid())
+            lastErrorMessage = json.getString("error");
+        else
+            lastErrorMessage = rply->errorString();
+        return;
+    }
+
+    qint64 start = 0;
+    if(status == 206)
+    {
+        // Content-Range: bytes <first>-<last>/<total>
+        QString range = QString(rply->rawHeader("Content-Range"));
+        start = range.section(' ', 1, 1).section('-', 0, 0).toLongLong();
+        bool ok;
+        qint64 total = range.section('/', 1, 1).toLongLong(&ok);
+        if(ok)
+            _fileSize = total;
+        else
+        {
+            // the total is unknown (<total> is "*"), but a range that ends before
+            // the requested one ends at the end of the file
+            QString requested = QString(rply->request().rawHeader("Range"));
+            qint64 requestedEnd = requested.section('-', 1, 1).toLongLong(&ok);
+            if(ok && start+response.size()-1 < requestedEnd)
+                _fileSize = start+response.size();
+        }
+    }
+    else
+    {
+        // the server ignored the range and sent the complete file
+        _fileSize = response.size();
+    }
+
+    for(qint64 offset = 0; offset < response.size(); offset += _blockSize)
+    {
+        qint64 len = qMin<qint64>(_blockSize, response.size()-offset);
+        _blockCache.insert((start+offset)/_blockSize, new QByteArray(response.mid(offset, len)), len);
+    }
+
+#ifdef QTDROPBOX_DEBUG
+    qDebug() << "QDropboxFile::rplyFileRange(...) " << response.size() << " byte at " << start
+             << " of " << _fileSize << endl;
+#endif
+    return;
+}
+
+void QDropboxFile::streamReadyRead()
+{
+    // a blocking read or open() is waiting for the data, the consumer must
+    // not be called while it is still inside of it
+    if(_waitMode == waitForStream)
+        stopEventLoop();
+    else
+        emit readyRead();
+    return;
+}
+
+void QDropboxFile::streamMetaDataChanged()
+{
+    if(_waitMode == waitForStream)
+        stopEventLoop();
+    return;
+}
+
 void QDropboxFile::rplyFileContent(QNetworkReply *rply)
 {
     lastErrorCode = 0;
@@ -366,8 +950,7 @@ void QDropboxFile::rplyFileContent(QNetworkReply *rply)
         break;
     }
 
-    _buffer->clear();
-    _buffer->append(response);
+    _buffer->setContent(response);
     emit readyRead();
     return;
 }
@@ -424,11 +1007,96 @@ void QDropboxFile::rplyFileWrite(QNetworkReply *rply)
     return;
 }
 
+void QDropboxFile::rplyChunkUpload(QNetworkReply *rply)
+{
+#ifdef QTDROPBOX_DEBUG
+    qDebug() << "QDropboxFile::rplyChunkUpload(...)" << endl;
+#endif
+
+    lastErrorCode = 0;
+
+    QByteArray response = rply->readAll();
+    QDropboxJson json(QString(response).trimmed());
+
+#ifdef QTDROPBOX_DEBUG
+    qDebug() << "QDropboxFile::rplyChunkUpload response = " << QString(response) << endl;
+#endif
+
+    int status = rply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    if(status == 0 && rply->error() != QNetworkReply::NoError)
+    {
+        lastErrorCode    = rply->error();
+        lastErrorMessage = rply->errorString();
+        return;
+    }
+
+    switch(status)
+    {
+    case QDROPBOX_ERROR_BAD_INPUT:
+        // the server expects the chunk at another offset, e.g. because the answer
+        // to the previous chunk was lost. putChunk() sends again from there.
+        if(json.isValid() && json.hasKey("offset") && !_uploadId.isEmpty() &&
+           json.getString("upload_id") == _uploadId)
+        {
+            qint64 offset = json.getInt("offset", true);
+            if(offset >= 0 && offset <= _buffer->size() && offset != _uploadOffset)
+            {
+#ifdef QTDROPBOX_DEBUG
+                qDebug() << "QDropboxFile::rplyChunkUpload offset " << _uploadOffset
+                         << " resynced to " << offset << endl;
+#endif
+                if(offset > _uploadOffset)
+                    emit bytesWritten(offset - _uploadOffset);
+                _uploadOffset = offset;
+            }
+        }
+        // fall through
+    case QDROPBOX_ERROR_EXPIRED_TOKEN:
+    case QDROPBOX_ERROR_BAD_OAUTH_REQUEST:
+    case QDROPBOX_ERROR_FILE_NOT_FOUND:
+    case QDROPBOX_ERROR_WRONG_METHOD:
+    case QDROPBOX_ERROR_REQUEST_CAP:
+    case QDROPBOX_ERROR_USER_OVER_QUOTA:
+        lastErrorCode = rply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+        if(json.isValid())
+            lastErrorMessage = json.getString("error");
+        else
+            lastErrorMessage = "";
+        return;
+        break;
+    default:
+        break;
+    }
+
+    if(status >= QDROPBOX_ERROR_BAD_INPUT)
+    {
+        lastErrorCode    = status;
+        lastErrorMessage = rply->errorString();
+        return;
+    }
+
+    if(!json.isValid() || !json.hasKey("upload_id"))
+    {
+        lastErrorCode    = QDROPBOX_ERROR_BAD_INPUT;
+        lastErrorMessage = "Dropbox API did not send correct answer for chunked upload.";
+        return;
+    }
+
+    qint64 sent = json.getInt("offset", true) - _uploadOffset;
+
+    _uploadId     = json.getString("upload_id");
+    _uploadOffset = json.getInt("offset", true);
+
+    emit bytesWritten(sent);
+    return;
+}
+
 void QDropboxFile::startEventLoop()
 {
 #ifdef QTDROPBOX_DEBUG
     qDebug() << "QDropboxFile::startEventLoop()" << endl;
 #endif
+    QDropboxTraceSpan span(_api->tracer(), "wait", "QDropboxFile");
     if(_evLoop == NULL)
         _evLoop = new QEventLoop(this);
     _evLoop->exec();
@@ -454,18 +1122,12 @@ bool QDropboxFile::putFile()
 #endif
 
     QUrl request;
-    request.setUrl(QDROPBOXFILE_CONTENT_URL, QUrl::StrictMode);
+    request.setUrl(contentUrl(), QUrl::StrictMode);
     request.setPath(QString("/%1/files_put/%2")
                     .arg(_api->apiVersion().left(1))
                     .arg(_filename));
 
-    QUrlQuery urlQuery;
-    urlQuery.addQueryItem("oauth_consumer_key", _api->appKey());
-    urlQuery.addQueryItem("oauth_nonce", QDropbox::generateNonce(128));
-    urlQuery.addQueryItem("oauth_signature_method", _api->signatureMethodString());
-    urlQuery.addQueryItem("oauth_timestamp", QString::number((int) QDateTime::currentMSecsSinceEpoch()/1000));
-    urlQuery.addQueryItem("oauth_token", _api->token());
-    urlQuery.addQueryItem("oauth_version", _api->apiVersion());
+    QUrlQuery urlQuery = _api->oAuthQuery(QDropbox::generateNonce(), QDateTime::currentMSecsSinceEpoch()/1000);
     urlQuery.addQueryItem("overwrite", (_overwrite?"true":"false"));
 
     QString signature = _api->oAuthSign(request);
@@ -478,13 +1140,13 @@ bool QDropboxFile::putFile()
 #endif
 
     QNetworkRequest rq(request);
-    QNetworkReply *reply = _conManager.put(rq, *_buffer);
-    connect(this, &QDropboxFile::operationAborted, reply, &QNetworkReply::abort);
-    connect(reply, &QNetworkReply::uploadProgress, this, &QDropboxFile::uploadProgress);
-
     _waitMode = waitForWrite;	
+    sendRequest(rq, "PUT", _buffer->data());
     startEventLoop();
 
+    // the metadata of the file changed with the upload
+    _api->invalidateMetadataCache(_filename);
+
     if(lastErrorCode != 0)
     {
 #ifdef QTDROPBOX_DEBUG
@@ -498,6 +1160,113 @@ bool QDropboxFile::putFile()
     return true;
 }
 
+bool QDropboxFile::putChunk()
+{
+#ifdef QTDROPBOX_DEBUG
+    qDebug() << "QDropboxFile::putChunk() offset = " << _uploadOffset << endl;
+#endif
+
+    // a chunk the server rejected because it expected another offset is sent
+    // again from that offset
+    for(int attempt = 0; attempt < 3; ++attempt)
+    {
+        // nothing new since the last chunk
+        if(_uploadOffset >= _buffer->size())
+            return true;
+
+        QUrl request;
+        request.setUrl(contentUrl(), QUrl::StrictMode);
+        request.setPath(QString("/%1/chunked_upload")
+                        .arg(_api->apiVersion().left(1)));
+
+        QUrlQuery urlQuery = _api->oAuthQuery(QDropbox::generateNonce(), QDateTime::currentMSecsSinceEpoch()/1000);
+        if(!_uploadId.isEmpty())
+        {
+            urlQuery.addQueryItem("upload_id", _uploadId);
+            urlQuery.addQueryItem("offset", QString::number(_uploadOffset));
+        }
+
+        QString signature = _api->oAuthSign(request);
+        urlQuery.addQueryItem("oauth_signature", signature);
+
+        request.setQuery(urlQuery);
+
+#ifdef QTDROPBOX_DEBUG
+        qDebug() << "QDropboxFile::putChunk " << request.toString() << endl;
+#endif
+
+        qint64 offset = _uploadOffset;
+        QNetworkRequest rq(request);
+        _waitMode = waitForChunk;
+        sendRequest(rq, "PUT", _buffer->mid(_uploadOffset));
+        startEventLoop();
+
+        if(lastErrorCode == 0)
+        {
+            _currentThreshold = 0;
+            return true;
+        }
+
+        // rplyChunkUpload() only moves the offset if the server asked for it
+        if(_uploadOffset == offset)
+            break;
+    }
+
+#ifdef QTDROPBOX_DEBUG
+    qDebug() << "QDropboxFile::putChunk WriteError: " << lastErrorCode << lastErrorMessage << endl;
+#endif
+    return false;
+}
+
+bool QDropboxFile::commitChunkedUpload()
+{
+#ifdef QTDROPBOX_DEBUG
+    qDebug() << "QDropboxFile::commitChunkedUpload() upload_id = " << _uploadId << endl;
+#endif
+
+    QUrl request;
+    request.setUrl(contentUrl(), QUrl::StrictMode);
+    request.setPath(QString("/%1/commit_chunked_upload/%2")
+                    .arg(_api->apiVersion().left(1))
+                    .arg(_filename));
+
+    QUrlQuery urlQuery = _api->oAuthQuery(QDropbox::generateNonce(), QDateTime::currentMSecsSinceEpoch()/1000);
+    urlQuery.addQueryItem("overwrite", (_overwrite?"true":"false"));
+    urlQuery.addQueryItem("upload_id", _uploadId);
+
+    QString signature = _api->oAuthSign(request);
+    urlQuery.addQueryItem("oauth_signature", signature);
+
+    request.setQuery(urlQuery);
+
+    QNetworkRequest rq(request);
+    rq.setHeader(QNetworkRequest::ContentTypeHeader, "application/x-www-form-urlencoded");
+    _waitMode = waitForWrite;
+    sendRequest(rq, "POST");
+    startEventLoop();
+
+    // the session is consumed by the commit, successful or not
+    resetUploadSession();
+    _api->invalidateMetadataCache(_filename);
+
+    if(lastErrorCode != 0)
+    {
+#ifdef QTDROPBOX_DEBUG
+        qDebug() << "QDropboxFile::commitChunkedUpload WriteError: " << lastErrorCode << lastErrorMessage << endl;
+#endif
+        return false;
+    }
+
+    return true;
+}
+
+void QDropboxFile::resetUploadSession()
+{
+    _uploadId     = "";
+    _uploadOffset = 0;
+    return;
+}
+
 void QDropboxFile::_init(QDropbox *api, QString filename, qint64 bufferTh)
 {
     _api              = api;
@@ -507,6 +1276,18 @@ void QDropboxFile::_init(QDropbox *api, QString filename, qint64 bufferTh)
     _waitMode         = notWaiting;
     _bufferThreshold  = bufferTh;
     _overwrite        = true;
+    _requestPriority  = QDropbox::NormalPriority;
+    _contentUrl       = "";
+    _chunkedUpload    = false;
+    _uploadId         = "";
+    _uploadOffset     = 0;
+    _readMode         = BufferedRead;
+    _streamBufferSize = 64*1024;
+    _streamReply      = NULL;
+    _randomAccess     = false;
+    _fileSize         = -1;
+    _blockSize        = 64*1024;
+    _blockCache.setMaxCost(4*1024*1024);
     _metadata         = NULL;
     lastErrorCode     = 0;
     lastErrorMessage  = "";
@@ -521,7 +1302,8 @@ QDropboxFileInfo QDropboxFile::metadata()
 	if(_metadata == NULL)
 		obtainMetadata();
 
-	return _api->requestMetadataAndWait(_filename);
+	// obtained on open() or updated by the last upload
+	return *_metadata;
 }
 
 bool QDropboxFile::hasChanged()
@@ -532,6 +1314,8 @@ bool QDropboxFile::hasChanged()
 			return false;         // if metadata was invalid
 	}
 
+	// ask the server, not the metadata cache
+	_api->invalidateMetadataCache(_filename);
 	QDropboxFileInfo serverMetadata = _api->requestMetadataAndWait(_filename);
 #ifdef QTDROPBOX_DEBUG
 	qDebug() << "QDropboxFile::hasChanged() local  revision hash = " << _metadata->revisionHash() << endl;
@@ -543,7 +1327,8 @@ bool QDropboxFile::hasChanged()
 void QDropboxFile::obtainMetadata()
 {
 	// get metadata of this file
-	_metadata = new QDropboxFileInfo(_api->requestMetadataAndWait(_filename).strContent(), this);
+	delete _metadata;
+	_metadata = new QDropboxFileInfo(_api->requestMetadataAndWait(_filename), this);
 	if(!_metadata->isValid())
 		_metadata->clear();
 	return;
@@ -560,6 +1345,20 @@ QList<QDropboxFileInfo> QDropboxFile::revisions(int max)
 
 bool QDropboxFile::seek(qint64 pos)
 {
+    // a stream can not be rewound
+    if(_streamReply != NULL)
+        return pos == _position;
+
+    if(_randomAccess)
+    {
+        if(pos < 0 || pos > size())
+            return false;
+
+        QIODevice::seek(pos);
+        _position = pos;
+        return true;
+    }
+
 	if(pos > _buffer->size())
 		return false;
 
@@ -582,5 +1381,12 @@ bool QDropboxFile::reset()
 
 void QDropboxFile::abort()
 {
+    // requests still waiting for a free connection will never get a reply
+    if(_api != NULL && _api->cancelNetworkRequests(this) > 0)
+    {
+        lastErrorCode    = QNetworkReply::OperationCanceledError;
+        lastErrorMessage = "Operation canceled";
+        stopEventLoop();
+    }
     emit operationAborted();
 }
@@ -9,11 +9,13 @@
 #include <QNetworkRequest>
 #include <QUrl>
 #include <QEvent>
+#include <QCache>
 
 #include "qtdropbox_global.h"
 #include "qdropboxjson.h"
 #include "qdropbox.h"
 #include "qdropboxfileinfo.h"
+#include "qdropboxfilebuffer.h"
 
 const QString QDROPBOXFILE_CONTENT_URL = "https://api-content.dropbox.com";
 
@@ -32,6 +34,12 @@ const QString QDROPBOXFILE_CONTENT_URL = "https://api-content.dropbox.com";
   updated if it changed on the Dropbox server which in return means that you may not
   always have the most current version of the file content.
 
+  Files that are too large to be buffered can be read with QDropboxFile::StreamingRead
+  (see setReadMode()). In this mode the content is passed on as it arrives from the
+  network and only a small window of the file is held in memory. If only parts of
+  a large file are needed use QDropboxFile::RandomAccessRead which downloads only
+  the blocks of the file that are actually read.
+
   \todo implement utilities for revision access (get a list of revisions and get actual
         revisions)
 
@@ -40,6 +48,17 @@ class QTDROPBOXSHARED_EXPORT QDropboxFile : public QIODevice
 {
     Q_OBJECT
 public:
+    //! Strategy used to read the file content
+    /*!
+      Defines how the content of a file that is opened for reading is obtained
+      from Dropbox.
+     */
+    enum ReadMode{
+        BufferedRead, /*!< The complete file is downloaded into a local buffer by open(). This is the default. */
+        StreamingRead, /*!< The content is read from the network as it arrives. Only used for QIODevice::ReadOnly. */
+        RandomAccessRead /*!< Blocks of the file are downloaded on demand and cached. Only used for QIODevice::ReadOnly. */
+    };
+
     /*!
       Default constructor. Use setApi() and setFilename() to access Dropbox.
 
@@ -72,8 +91,8 @@ public:
     ~QDropboxFile();
 
     /*!
-      QDropboxFile is currently implemented as sequential device. That will
-      change in time.
+      QDropboxFile is a sequential device unless it was opened for reading with
+      QDropboxFile::RandomAccessRead.
      */
     bool isSequential() const;
 
@@ -88,7 +107,8 @@ public:
     /*!
       Closes the file buffer. If the file was opened with QIODevice::WriteOnly (or
       QIODevice::ReadWrite) the file content buffer will be flushed and written to
-      the file.
+      the file. If that fails writeFailed() is emitted and errorString() describes
+      the error.
      */
     void close();
 
@@ -159,6 +179,157 @@ public:
      */
     bool overwrite();
 
+    /*!
+      Sets the priority used to schedule the requests of this file on the connections
+      of its QDropbox instance. The default is QDropbox::NormalPriority.
+
+      \param priority Priority class of the requests
+     */
+    void setRequestPriority(QDropbox::RequestPriority priority);
+
+    /*!
+      Returns the priority used to schedule the requests of this file.
+     */
+    QDropbox::RequestPriority requestPriority();
+
+    /*!
+      Changes the URL of the content server this file is read from and written to. By
+      default the content URL of the QDropbox instance is used (see
+      QDropbox::setContentUrl()). A different server, e.g. a local test server, has to
+      implement the Dropbox REST API.
+
+      \param url URL of the content server including the scheme, e.g. <em>http://127.0.0.1:8080</em>.
+                 An empty string uses the content URL of the QDropbox instance again.
+     */
+    void setContentUrl(QString url);
+
+    /*!
+      Returns the URL of the content server used by this file.
+     */
+    QString contentUrl();
+
+    /*!
+      Enables or disables chunked uploads. By default every flush() uploads the
+      complete buffer with a single <i>files_put</i> request. In chunked mode
+      flush() only sends the bytes that were added since the last flush to the
+      <i>chunked_upload</i> endpoint and close() commits the upload session.
+      Use this mode for large files that are written sequentially.
+
+      If data is inserted before the part of the buffer that was already uploaded
+      the upload session is restarted and the whole buffer is sent again with the
+      next flush.
+
+      \note In chunked mode the file content on Dropbox is only updated when the
+            file is closed.
+
+      \param chunked <i>true</i> to enable chunked uploads
+     */
+    void setChunkedUpload(bool chunked);
+
+    /*!
+      Returns <i>true</i> if chunked uploads are enabled.
+     */
+    bool chunkedUpload();
+
+    /*!
+      Sets the strategy that is used to read the file content. The mode is applied
+      the next time the file is opened.
+
+      With QDropboxFile::StreamingRead open() returns as soon as the server started
+      to answer. readyRead() is emitted for every chunk of data that arrives and a read
+      blocks until data is available or the download has finished. Not more than
+      streamBufferSize() byte of not yet read data are kept in memory. A streamed
+      file can only be read sequentially, seek() will fail.
+
+      Streaming is only available for files that are opened with QIODevice::ReadOnly.
+      In all other modes the file is buffered.
+
+      \param mode read strategy
+     */
+    void setReadMode(ReadMode mode);
+
+    /*!
+      Returns the current read strategy.
+     */
+    ReadMode readMode();
+
+    /*!
+      Sets the maximum amount of not yet read data that is buffered when the file is
+      read with QDropboxFile::StreamingRead. The download is throttled as soon as the
+      buffer is full. Default is 64 KiB.
+
+      \param size buffer size in byte
+     */
+    void setStreamBufferSize(qint64 size);
+
+    /*!
+      Returns the size of the buffer that is used for streaming.
+     */
+    qint64 streamBufferSize();
+
+    /*!
+      Sets the size of the blocks that are downloaded when the file is read with
+      QDropboxFile::RandomAccessRead. Every read downloads at least one block. Changing
+      the block size drops all cached blocks. Default is 64 KiB.
+
+      \param size block size in byte
+     */
+    void setBlockSize(qint64 size);
+
+    /*!
+      Returns the size of the blocks used for QDropboxFile::RandomAccessRead.
+     */
+    qint64 blockSize();
+
+    /*!
+      Sets the maximum amount of memory that is used to cache downloaded blocks when
+      the file is read with QDropboxFile::RandomAccessRead. If the limit is reached
+      the least recently used blocks are dropped. The cache is at least as large as
+      one block. Default is 4 MiB.
+
+      \param size cache size in byte
+     */
+    void setBlockCacheSize(qint64 size);
+
+    /*!
+      Returns the maximum size of the block cache.
+     */
+    qint64 blockCacheSize();
+
+    /*!
+      Reimplemented from QIODevice::size(). When the file is read with
+      QDropboxFile::RandomAccessRead this is the size of the remote file. For files
+      that are completely downloaded this is the size of the content.
+     */
+    qint64 size() const;
+
+    /*!
+      Reimplemented from QIODevice::bytesAvailable().
+     */
+    qint64 bytesAvailable() const;
+
+    /*!
+      Reimplemented from QIODevice::atEnd().
+     */
+    bool atEnd() const;
+
+    /*!
+      Returns a read-only view of the downloaded content at the current position
+      without copying it. Parsers can use it to consume the data in place and
+      advance with seek() afterwards. The position is not changed.
+
+      The view is only valid until the file is written to, closed or destroyed. If
+      the content was modified by writes the view ends where the next modification
+      begins, so it may be shorter than maxlen even if more data is available.
+
+      Views are only available if the file was downloaded completely (not with
+      QDropboxFile::StreamingRead or QDropboxFile::RandomAccessRead).
+
+      \param maxlen maximum length of the view, -1 for all contiguous data
+      \returns the view or an empty QByteArray if no data is available
+     */
+    QByteArray peekView(qint64 maxlen = -1) const;
+
 	/*!
 	  Return the metadata of the file as a QDropboxFileInfo object.
 	*/
@@ -210,17 +381,22 @@ signals:
 
     void operationAborted();
 
+    /*!
+      Emitted by close() if the content could not be written to Dropbox.
+     */
+    void writeFailed(int errorCode, QString errorMessage);
+
 protected:
     qint64 readData(char *data, qint64 maxlen);
     qint64 writeData(const char *data, qint64 len);
 
 private slots:
     void networkRequestFinished(QNetworkReply* rply);
+    void streamReadyRead();
+    void streamMetaDataChanged();
 
 private:
-    QNetworkAccessManager _conManager;
-
-    QByteArray *_buffer;
+    QDropboxFileBuffer *_buffer;
 
     QString _token;
     QString _tokenSecret;
@@ -232,7 +408,10 @@ private:
     enum WaitState{
         notWaiting,
         waitForRead,
-        waitForWrite
+        waitForWrite,
+        waitForChunk,
+        waitForStream,
+        waitForRange
     };
 
     WaitState _waitMode;
@@ -247,20 +426,49 @@ private:
 
     bool _overwrite;
 
-	int _position;
+    QDropbox::RequestPriority _requestPriority;
+    QString _contentUrl;
+
+    bool    _chunkedUpload;
+    QString _uploadId;
+    qint64  _uploadOffset;
+
+    ReadMode       _readMode;
+    qint64         _streamBufferSize;
+    QNetworkReply *_streamReply;
+
+    bool                       _randomAccess;
+    qint64                     _fileSize;
+    qint64                     _blockSize;
+    QCache<qint64, QByteArray> _blockCache;
+
+	qint64 _position;
 
 	QDropboxFileInfo *_metadata;
 
     void obtainToken();
-    void connectSignals();
+    void sendRequest(QNetworkRequest rq, QByteArray verb, QByteArray data = QByteArray());
+    void traceStarted(qint64 traceId);
+    void tracedRequestFinished(QNetworkReply *rply, qint64 traceId);
 
     bool isMode(QIODevice::OpenMode mode);
+    QUrl downloadUrl(QString filename);
     bool getFileContent(QString filename);
+    bool openStream(QString filename);
+    qint64 readStream(char *data, qint64 maxlen);
+    void closeStream();
+    bool fetchBlocks(qint64 first, qint64 last);
+    qint64 readBlocks(char *data, qint64 maxlen);
+    void rplyFileRange(QNetworkReply* rply);
     void rplyFileContent(QNetworkReply* rply);
     void rplyFileWrite(QNetworkReply* rply);
+    void rplyChunkUpload(QNetworkReply* rply);
     void startEventLoop();
     void stopEventLoop();
     bool putFile();
+    bool putChunk();
+    bool commitChunkedUpload();
+    void resetUploadSession();
 	void obtainMetadata();
 
     void _init(QDropbox *api, QString filename, qint64 bufferTh);
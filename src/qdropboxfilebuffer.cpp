@@ -0,0 +1,226 @@
+#include <cstring>
+
+#include "qdropboxfilebuffer.h"
+
+QDropboxFileBuffer::QDropboxFileBuffer() :
+    _size(0),
+    _hintIndex(0),
+    _hintStart(0)
+{
+}
+
+void QDropboxFileBuffer::clear()
+{
+    _original.clear();
+    _added.clear();
+    _pieces.clear();
+    _size      = 0;
+    _hintIndex = 0;
+    _hintStart = 0;
+    return;
+}
+
+void QDropboxFileBuffer::setContent(const QByteArray &content)
+{
+    clear();
+    _original = content;
+    if(!_original.isEmpty())
+    {
+        Piece piece = {false, 0, _original.size()};
+        _pieces.append(piece);
+        _size = _original.size();
+    }
+    return;
+}
+
+bool QDropboxFileBuffer::insert(qint64 pos, const char *data, qint64 len)
+{
+    if(pos < 0 || pos > _size)
+        return false;
+    if(len <= 0)
+        return true;
+
+    qint64 addedStart = _added.size();
+    _added.append(data, int(len));
+    Piece piece = {true, addedStart, len};
+
+    if(_pieces.isEmpty())
+    {
+        _pieces.append(piece);
+        _hintIndex = 0;
+        _hintStart = 0;
+        _size += len;
+        return true;
+    }
+
+    qint64 pieceStart;
+    int i = findPiece(pos, &pieceStart);
+    Piece &current = _pieces[i];
+    qint64 offset = pos - pieceStart;
+
+    if(offset == current.length)
+    {
+        // writing on at the end of the last written data only grows its piece
+        if(current.added && current.start + current.length == addedStart)
+        {
+            current.length += len;
+            _hintIndex = i;
+            _hintStart = pieceStart;
+        }
+        else
+        {
+            _pieces.insert(i+1, piece);
+            _hintIndex = i+1;
+            _hintStart = pos;
+        }
+    }
+    else if(offset == 0)
+    {
+        _pieces.insert(i, piece);
+        _hintIndex = i;
+        _hintStart = pos;
+    }
+    else
+    {
+        // split the piece around the new data
+        Piece tail = {current.added, current.start + offset, current.length - offset};
+        current.length = offset;
+        _pieces.insert(i+1, piece);
+        _pieces.insert(i+2, tail);
+        _hintIndex = i+1;
+        _hintStart = pos;
+    }
+
+    _size += len;
+    return true;
+}
+
+qint64 QDropboxFileBuffer::size() const
+{
+    return _size;
+}
+
+QByteArray QDropboxFileBuffer::mid(qint64 pos, qint64 len) const
+{
+    if(pos < 0 || pos >= _size)
+        return QByteArray();
+    if(len < 0 || len > _size - pos)
+        len = _size - pos;
+
+    QByteArray result;
+    result.resize(int(len));
+    read(pos, result.data(), len);
+    return result;
+}
+
+qint64 QDropboxFileBuffer::read(qint64 pos, char *data, qint64 maxlen) const
+{
+    if(pos < 0 || pos >= _size || maxlen <= 0)
+        return 0;
+
+    // clamp to the bytes behind pos, not to the size of the content
+    qint64 len = qMin(maxlen, _size - pos);
+    qint64 left = len;
+
+    qint64 pieceStart;
+    int i = findPiece(pos, &pieceStart);
+    qint64 offset = pos - pieceStart;
+    while(left > 0 && i < _pieces.size())
+    {
+        const Piece &piece = _pieces.at(i);
+        qint64 n = qMin(piece.length - offset, left);
+        memcpy(data, pieceData(piece) + offset, size_t(n));
+        data   += n;
+        left   -= n;
+        offset  = 0;
+        i++;
+    }
+    return len;
+}
+
+const char *QDropboxFileBuffer::constData(qint64 pos, qint64 *length) const
+{
+    *length = 0;
+    if(pos < 0 || pos >= _size)
+        return NULL;
+
+    qint64 pieceStart;
+    int i = findPiece(pos, &pieceStart);
+    qint64 offset = pos - pieceStart;
+
+    // a position at the end of a piece is the start of the next one
+    if(offset == _pieces.at(i).length)
+    {
+        i++;
+        offset = 0;
+    }
+
+    const Piece &piece = _pieces.at(i);
+    *length = piece.length - offset;
+    return pieceData(piece) + offset;
+}
+
+const QByteArray &QDropboxFileBuffer::data()
+{
+    if(_pieces.size() == 1)
+    {
+        const Piece &piece = _pieces.at(0);
+        // data written from scratch is already in one piece
+        if(piece.added && piece.start == 0 && piece.length == _added.size())
+        {
+            _original = _added;
+            _added.clear();
+            _pieces[0].added = false;
+        }
+        if(!_pieces.at(0).added && piece.start == 0 && piece.length == _original.size())
+            return _original;
+    }
+
+    QByteArray flat = mid(0);
+    _original = flat;
+    _added.clear();
+    _pieces.clear();
+    if(!_original.isEmpty())
+    {
+        Piece piece = {false, 0, _original.size()};
+        _pieces.append(piece);
+    }
+    _hintIndex = 0;
+    _hintStart = 0;
+    return _original;
+}
+
+int QDropboxFileBuffer::pieceCount() const
+{
+    return _pieces.size();
+}
+
+/*!
+  Returns the index of the piece that contains pos and stores the position the
+  piece starts at. A position at the boundary of two pieces belongs to the first
+  one, so writes at the end of a piece can extend it.
+ */
+int QDropboxFileBuffer::findPiece(qint64 pos, qint64 *pieceStart) const
+{
+    int    i     = 0;
+    qint64 start = 0;
+    if(_hintIndex < _pieces.size() && pos >= _hintStart)
+    {
+        i     = _hintIndex;
+        start = _hintStart;
+    }
+
+    while(i < _pieces.size()-1 && pos > start + _pieces.at(i).length)
+    {
+        start += _pieces.at(i).length;
+        i++;
+    }
+
+    *pieceStart = start;
+    return i;
+}
+
+const char *QDropboxFileBuffer::pieceData(const Piece &piece) const
+{
+    return (piece.added? _added.constData() : _original.constData()) + piece.start;
+}
@@ -0,0 +1,101 @@
+#ifndef QDROPBOXFILEBUFFER_H
+#define QDROPBOXFILEBUFFER_H
+
+#include "qtdropbox_global.h"
+
+#include <QByteArray>
+#include <QVector>
+
+//! Piece table that holds the content of a QDropboxFile
+/*!
+  The content is described by a list of pieces that reference either the content
+  downloaded from Dropbox or an append-only buffer of written data. Inserting data
+  only appends it to that buffer and splits at most one piece, so the cost of a
+  write depends on the size of the write and the number of edits but not on the
+  size of the file. Consecutive writes are merged into a single piece.
+
+  The content is flattened into a single QByteArray by data() only when it is
+  needed as a whole, e.g. for uploading it.
+ */
+class QDropboxFileBuffer
+{
+public:
+    /*!
+      Creates an empty buffer.
+     */
+    QDropboxFileBuffer();
+
+    /*!
+      Drops the complete content.
+     */
+    void clear();
+
+    /*!
+      Replaces the content by the given data. The data is shared, not copied.
+     */
+    void setContent(const QByteArray &content);
+
+    /*!
+      Inserts len bytes of data at the given position.
+      \param pos Position between 0 and size()
+      \return false if the position is out of range
+     */
+    bool insert(qint64 pos, const char *data, qint64 len);
+
+    /*!
+      Returns the size of the content.
+     */
+    qint64 size() const;
+
+    /*!
+      Returns a copy of up to len bytes of the content starting at pos.
+     */
+    QByteArray mid(qint64 pos, qint64 len = -1) const;
+
+    /*!
+      Copies up to maxlen bytes of the content starting at pos directly into data.
+      \return number of bytes copied, never more than size() - pos
+     */
+    qint64 read(qint64 pos, char *data, qint64 maxlen) const;
+
+    /*!
+      Returns a pointer to the content at pos without copying it. Only the part up to
+      the end of the piece pos is in is contiguous, its length is stored in length.
+      The pointer stays valid until the content is changed.
+      \return NULL if pos is out of range
+     */
+    const char *constData(qint64 pos, qint64 *length) const;
+
+    /*!
+      Returns the complete content. All pieces are merged into one buffer first, so
+      this should only be used if the content is needed as a whole.
+     */
+    const QByteArray &data();
+
+    /*!
+      Returns the number of pieces the content consists of.
+     */
+    int pieceCount() const;
+
+private:
+    struct Piece
+    {
+        bool   added;  //!< piece references _added instead of _original
+        qint64 start;  //!< offset in the referenced buffer
+        qint64 length; //!< length in bytes
+    };
+
+    int  findPiece(qint64 pos, qint64 *pieceStart) const;
+    const char *pieceData(const Piece &piece) const;
+
+    QByteArray     _original;
+    QByteArray     _added;
+    QVector<Piece> _pieces;
+    qint64         _size;
+
+    // piece of the last insert, writes usually continue there
+    int    _hintIndex;
+    qint64 _hintStart;
+};
+
+#endif // QDROPBOXFILEBUFFER_H
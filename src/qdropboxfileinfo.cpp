@@ -1,5 +1,26 @@
 #include "qdropboxfileinfo.h"
 
+//! Values of a QDropboxFileInfo that are shared between its copies
+class QDropboxFileInfoData : public QSharedData
+{
+public:
+    QString   size;
+    quint64   revision;
+    bool      thumbExists;
+    quint64   bytes;
+    QDateTime modified;
+    QDateTime clientModified;
+    QString   icon;
+    QString   root;
+    QString   path;
+    bool      isDir;
+    QString   mimeType;
+    bool      isDeleted;
+    QString   revisionHash;
+    QString   hash;
+    QList<QDropboxFileInfo> content;
+};
+
 QDropboxFileInfo::QDropboxFileInfo(QObject *parent) :
     QDropboxJson(parent)
 {
@@ -13,23 +34,28 @@ QDropboxFileInfo::QDropboxFileInfo(QString jsonStr, QObject *parent) :
     dataFromJson();
 }
 
-QDropboxFileInfo::QDropboxFileInfo(const QDropboxFileInfo &other) :
-    QDropboxJson(0)
+QDropboxFileInfo::QDropboxFileInfo(const QDropboxJson &json, QObject *parent) :
+    QDropboxJson(json)
 {
+    setParent(parent);
     _init();
-    copyFrom(other);
+    dataFromJson();
+}
+
+QDropboxFileInfo::QDropboxFileInfo(const QDropboxFileInfo &other) :
+    QDropboxJson(other),
+    _data(other._data)
+{
 }
 
 QDropboxFileInfo::~QDropboxFileInfo()
 {
-  if(_content != NULL)
-    delete _content;
 }
 
 void QDropboxFileInfo::copyFrom(const QDropboxFileInfo &other)
 {
-	parseString(other.strContent());
-	dataFromJson();
+	QDropboxJson::operator=(other);
+	_data = other._data;
 	setParent(other.parent());
 	return;
 }
@@ -45,35 +71,37 @@ void QDropboxFileInfo::dataFromJson()
 	if(!isValid())
 		return;
 
-	_size         = getString("size");
-	_revision     = getUInt("revision");
-	_thumbExists  = getBool("thumb_exists");
-	_bytes        = getUInt("bytes");
-	_icon         = getString("icon");
-	_root         = getString("root");
-	_path         = getString("path");
-	_isDir        = getBool("is_dir");
-	_mimeType     = getString("mime_type");
-	_isDeleted    = getBool("is_deleted");
-	_revisionHash = getString("rev");
-	_modified     = getTimestamp("modified");
-    _clientModified = getTimestamp("client_mtime");
+	_data->size         = getString("size");
+	_data->revision     = getUInt("revision");
+	_data->thumbExists  = getBool("thumb_exists");
+	_data->bytes        = getUInt("bytes");
+	_data->icon         = getString("icon");
+	_data->root         = getString("root");
+	_data->path         = getString("path");
+	_data->isDir        = getBool("is_dir");
+	_data->mimeType     = getString("mime_type");
+	_data->isDeleted    = getBool("is_deleted");
+	_data->revisionHash = getString("rev");
+	_data->hash         = getString("hash");
+	_data->modified     = getTimestamp("modified");
+    _data->clientModified = getTimestamp("client_mtime");
 	
 	// create content list
-	if(_isDir)
+	if(_data->isDir)
 	{
 #ifdef QTDROPBOX_DEBUG
 	  qDebug() << "fileinfo: generating contents list";
 #endif
-	  _content = new QList<QDropboxFileInfo>();
-	  QStringList contentsArray = getArray("contents");
+	  // the entries share the already parsed data of this directory
+	  QList<QDropboxJson> contentsArray = getJsonArray("contents");
+	  _data->content.reserve(contentsArray.size());
 	  for(qint32 i = 0; i<contentsArray.size(); ++i)
 	  {
 	    QDropboxFileInfo contentInfo(contentsArray.at(i));
 		if(!contentInfo.isValid())
 		  continue;
 		
-		_content->append(contentInfo);
+		_data->content.append(contentInfo);
 	  }
 	}
 
@@ -82,97 +110,103 @@ void QDropboxFileInfo::dataFromJson()
 
 void QDropboxFileInfo::_init()
 {
-    _size           = "";
-    _revision       = 0;
-    _thumbExists    = false;
-    _bytes          = 0;
-    _modified       = QDateTime::currentDateTime();
-    _clientModified = QDateTime::currentDateTime();
-    _icon           = "";
-    _root           = "";
-	_path           = "";
-	_isDir          = false;
-	_mimeType       = "";
-	_isDeleted      = false;
-	_revisionHash   = "";
-	_content        = NULL;
+    _data = new QDropboxFileInfoData();
+    _data->size           = "";
+    _data->revision       = 0;
+    _data->thumbExists    = false;
+    _data->bytes          = 0;
+    _data->modified       = QDateTime::currentDateTime();
+    _data->clientModified = QDateTime::currentDateTime();
+    _data->icon           = "";
+    _data->root           = "";
+	_data->path           = "";
+	_data->isDir          = false;
+	_data->mimeType       = "";
+	_data->isDeleted      = false;
+	_data->revisionHash   = "";
+	_data->hash           = "";
     return;
 }
 
 QString QDropboxFileInfo::revisionHash()  const
 {
-	return _revisionHash;
+	return _data->revisionHash;
+}
+
+QString QDropboxFileInfo::hash()  const
+{
+	return _data->hash;
 }
 
 bool QDropboxFileInfo::isDeleted()  const
 {
-	return _isDeleted;
+	return _data->isDeleted;
 }
 
 
 QString QDropboxFileInfo::mimeType()  const
 {
-	return _mimeType;
+	return _data->mimeType;
 }
 
 bool QDropboxFileInfo::isDir()  const
 {
-	return _isDir;
+	return _data->isDir;
 }
 
 QString QDropboxFileInfo::path()  const
 {
-	return _path;
+	return _data->path;
 }
 
 QString QDropboxFileInfo::root()  const
 {
-	return _root;
+	return _data->root;
 }
 
 QString QDropboxFileInfo::icon()  const
 {
-	return _icon;
+	return _data->icon;
 }
 
 QDateTime QDropboxFileInfo::clientModified()
 {
-	return _clientModified;
+	return _data.constData()->clientModified;
 }
 
 QDateTime QDropboxFileInfo::modified()
 {
-	return _modified;
+	return _data.constData()->modified;
 }
 
 quint64 QDropboxFileInfo::bytes()  const
 {
-	return _bytes;
+	return _data->bytes;
 }
 
 bool QDropboxFileInfo::thumbExists()  const
 {
-	return _thumbExists;
+	return _data->thumbExists;
 }
 
 quint64 QDropboxFileInfo::revision() const
 {
-	return _revision;
+	return _data->revision;
 }
 
 QString QDropboxFileInfo::size() const
 {
-	return _size;
+	return _data->size;
 }
 
 QList<QDropboxFileInfo> QDropboxFileInfo::contents() const
 {
-   if(_content == NULL || !isDir())
+   if(!isDir())
    {
      QList<QDropboxFileInfo> l;
 	 l.clear();
      return l;
    }
    
-   return *_content;
+   return _data->content;
 }
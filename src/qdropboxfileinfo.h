@@ -5,6 +5,7 @@
 #include <QDateTime>
 #include <QString>
 #include <QList>
+#include <QSharedDataPointer>
 
 #ifdef QTDROPBOX_DEBUG
 #include <QDebug>
@@ -12,6 +13,8 @@
 
 #include "qdropboxjson.h"
 
+class QDropboxFileInfoData;
+
 //! Provides information and metadata about files and directories
 /*!
   This class is a more specialised version of QDropboxJson. It provides access to 
@@ -32,6 +35,9 @@
   query the metadata of a subdirectory again by using QDropbox::requestMetadata() or 
   QDropbox::requestMetadataAndWait().
 
+  QDropboxFileInfo is implicitly shared. Copying an instance, e.g. when it is returned in
+  a list by contents(), does neither copy nor parse the metadata again.
+
   \bug modified() and clientModified() are currently not working due to a bug in 
   QDropboxJson
  */
@@ -56,6 +62,15 @@ public:
 	*/
     QDropboxFileInfo(QString jsonStr, QObject *parent = 0);
 
+	/*!
+	  Creates an instance of QDropboxFileInfo based on the data of an already
+	  parsed JSON. The data of the JSON is shared and not parsed again.
+
+	  \param json metadata JSON
+	  \param parent pointer to the parent QObject
+	*/
+    explicit QDropboxFileInfo(const QDropboxJson &json, QObject *parent = 0);
+
 	/*!
 	   Creates a copy of an other QDropboxFileInfo instance.
 
@@ -148,6 +163,12 @@ public:
 	  Current revision as hash string. Use this for e.g. change check.
 	*/
     QString   revisionHash()  const;
+
+	/*!
+	  Hash of a directory listing. QDropbox sends it with later metadata requests of the
+	  directory so the server can answer that nothing changed. Empty for files.
+	*/
+    QString   hash()  const;
 	
 	/*!
 	  Returns the content of a directory.
@@ -164,20 +185,7 @@ private:
     void dataFromJson();
     void _init();
 
-    QString   _size;
-    quint64   _revision;
-    bool      _thumbExists;
-    quint64   _bytes;
-    QDateTime _modified;
-    QDateTime _clientModified;
-    QString   _icon;
-    QString   _root;
-	QString   _path;
-	bool      _isDir;
-	QString   _mimeType;
-	bool      _isDeleted;
-	QString   _revisionHash;
-	QList<QDropboxFileInfo>* _content;
+    QSharedDataPointer<QDropboxFileInfoData> _data;
 };
 
 #endif // QDROPBOXFILEINFO_H
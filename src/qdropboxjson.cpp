@@ -1,266 +1,768 @@
 #include <QLocale>
+#include <QVector>
+#include <QSharedData>
+
+#include <climits>
+#include <cstring>
 
 #include "qdropboxjson.h"
 
-QDropboxJson::QDropboxJson(QObject *parent) :
-    QObject(parent)
+//! Single pass tokenizer that builds the tree of a QDropboxJson
+/*!
+  The parser copies the UTF-8 encoded data into the arena once and works on that
+  copy. Escaped strings are decoded in place so every string of the tree is a
+  slice of the copied data. Sub JSONs and arrays are collected on shared scratch
+  stacks and moved into the arena when they are closed, so no part of the input
+  is read twice and no node is allocated on its own.
+ */
+class QDropboxJsonParser
 {
-    _init();
+public:
+    QDropboxJsonParser(QDropboxJsonArena *arena, const QByteArray &json) :
+        _arena(arena)
+    {
+        _pos = arena->copy(json.constData(), json.size());
+        _end = _pos+json.size();
+    }
+
+    bool parse(qdropboxjson_entry *root, bool *anonymousArray);
+
+private:
+    QDropboxJsonArena *_arena;
+    char *_pos;
+    char *_end;
+
+    QVector<qdropboxjson_member> _members;
+    QVector<qdropboxjson_entry>  _items;
+
+    void skipWhitespace();
+    bool parseObject(qdropboxjson_entry *entry);
+    bool parseArray(qdropboxjson_entry *entry);
+    bool parseValue(qdropboxjson_entry *entry);
+    bool parseString(const char **str, int *size);
+    bool parseNumber(const char *start, qdropboxjson_entry *entry);
+    bool readHex(uint *code);
+};
+
+// UTF-8 encoding of a single code point, returns the end of the written data
+static char *writeUtf8(char *out, uint code)
+{
+    if(code < 0x80)
+    {
+        *out++ = char(code);
+    }
+    else if(code < 0x800)
+    {
+        *out++ = char(0xC0 | (code >> 6));
+        *out++ = char(0x80 | (code & 0x3F));
+    }
+    else if(code < 0x10000)
+    {
+        *out++ = char(0xE0 | (code >> 12));
+        *out++ = char(0x80 | ((code >> 6) & 0x3F));
+        *out++ = char(0x80 | (code & 0x3F));
+    }
+    else
+    {
+        *out++ = char(0xF0 | (code >> 18));
+        *out++ = char(0x80 | ((code >> 12) & 0x3F));
+        *out++ = char(0x80 | ((code >> 6) & 0x3F));
+        *out++ = char(0x80 | (code & 0x3F));
+    }
+    return out;
 }
 
-QDropboxJson::QDropboxJson(QString strJson, QObject *parent) :
-    QObject(parent)
+static bool keyEquals(const qdropboxjson_member &m, const QString &key)
 {
-    _init();
-    parseString(strJson);
+    // ASCII keys have as many bytes as characters
+    if(m.keySize == key.size())
+    {
+        const QChar *c = key.constData();
+        for(int i=0; i<m.keySize; ++i)
+        {
+            const uchar b = uchar(m.key[i]);
+            if(b >= 0x80 || c[i].unicode() != b)
+                return false;
+        }
+        return true;
+    }
+
+    if(m.keySize < key.size())
+        return false;
+
+    for(int i=0; i<m.keySize; ++i)
+    {
+        if(uchar(m.key[i]) >= 0x80)
+            return QString::fromUtf8(m.key, m.keySize) == key;
+    }
+    return false;
 }
 
-QDropboxJson::QDropboxJson(const QDropboxJson &other) :
-    QObject(other.parent())
+// later keys of a JSON replace earlier ones so the members are searched backwards
+static qdropboxjson_member *findMember(const qdropboxjson_entry *object, const QString &key)
 {
-    _init();
-    parseString(other.strContent());
+    for(int i=object->size-1; i>=0; --i)
+    {
+        if(keyEquals(object->value.members[i], key))
+            return &object->value.members[i];
+    }
+    return NULL;
 }
 
-QDropboxJson::~QDropboxJson()
+static const qdropboxjson_member *findMember(const qdropboxjson_entry *object, const char *key, int keySize)
 {
-    emptyList();
+    for(int i=object->size-1; i>=0; --i)
+    {
+        const qdropboxjson_member &m = object->value.members[i];
+        if(m.keySize == keySize && !memcmp(m.key, key, keySize))
+            return &m;
+    }
+    return NULL;
 }
 
-void QDropboxJson::_init()
+// quoted JSON representation of a string
+static void writeString(QByteArray *out, const char *str, int size)
 {
-	valid          = false;
-	_anonymousArray = false;
+    static const char hex[] = "0123456789abcdef";
+
+    out->append('"');
+    for(int i=0; i<size; ++i)
+    {
+        const char c = str[i];
+        switch(c)
+        {
+        case '"':  out->append("\\\""); break;
+        case '\\': out->append("\\\\"); break;
+        case '\b': out->append("\\b"); break;
+        case '\f': out->append("\\f"); break;
+        case '\n': out->append("\\n"); break;
+        case '\r': out->append("\\r"); break;
+        case '\t': out->append("\\t"); break;
+        default:
+            if(uchar(c) < 0x20)
+            {
+                out->append("\\u00");
+                out->append(hex[uchar(c) >> 4]);
+                out->append(hex[uchar(c) & 0xF]);
+            }
+            else
+            {
+                out->append(c);
+            }
+            break;
+        }
+    }
+    out->append('"');
 }
 
-void QDropboxJson::parseString(QString strJson)
+// JSON representation of a single value
+static void writeEntry(QByteArray *out, const qdropboxjson_entry &e)
 {
-#ifdef QTDROPBOX_DEBUG
-    qDebug() << "parse string = " << strJson << endl;
-#endif
+    switch(e.type)
+    {
+    case QDROPBOXJSON_TYPE_JSON:
+        out->append("{");
+        for(int i=0; i<e.size; ++i)
+        {
+            const qdropboxjson_member &m = e.value.members[i];
+            if(i > 0)
+                out->append(", ");
+            writeString(out, m.key, m.keySize);
+            out->append(": ");
+            writeEntry(out, m.value);
+        }
+        out->append("}");
+        break;
+    case QDROPBOXJSON_TYPE_ARRAY:
+        out->append("[");
+        for(int i=0; i<e.size; ++i)
+        {
+            if(i > 0)
+                out->append(", ");
+            writeEntry(out, e.value.items[i]);
+        }
+        out->append("]");
+        break;
+    case QDROPBOXJSON_TYPE_STR:
+        writeString(out, e.value.str, e.size);
+        break;
+    case QDROPBOXJSON_TYPE_NUM:
+        out->append(QByteArray::number(e.value.num));
+        break;
+    case QDROPBOXJSON_TYPE_UINT:
+        out->append(QByteArray::number(e.value.unum));
+        break;
+    case QDROPBOXJSON_TYPE_FLOAT:
+    {
+        QByteArray number = QByteArray::number(e.value.fp, 'g', 15);
+        // keep the value a floating point number when it is parsed again
+        if(!number.contains('.') && !number.contains('e') && !number.contains('n'))
+            number.append(".0");
+        out->append(number);
+        break;
+    }
+    case QDROPBOXJSON_TYPE_BOOL:
+        out->append(e.value.boolean ? "true" : "false");
+        break;
+    default:
+        out->append("null");
+        break;
+    }
+}
 
-    // clear all existing data
-    emptyList();
+static QString entryContent(const qdropboxjson_entry &e)
+{
+    QByteArray content;
+    writeEntry(&content, e);
+    return QString::fromUtf8(content);
+}
 
-    // basically a json is valid until it is invalidated
-    valid = true;
+// strings are returned as they are, everything else in JSON representation
+static QString entryString(const qdropboxjson_entry &e)
+{
+    if(e.type == QDROPBOXJSON_TYPE_STR)
+        return QString::fromUtf8(e.value.str, e.size);
+    return entryContent(e);
+}
 
-    if(!strJson.startsWith("{") ||
-            !strJson.endsWith("}"))
+static bool entriesEqual(const qdropboxjson_entry &a, const qdropboxjson_entry &b)
+{
+    if(a.type != b.type)
+        return false;
+
+    switch(a.type)
+    {
+    case QDROPBOXJSON_TYPE_JSON:
+        if(a.size != b.size)
+            return false;
+        for(int i=0; i<a.size; ++i)
+        {
+            const qdropboxjson_member &m = a.value.members[i];
+            const qdropboxjson_member *other = findMember(&b, m.key, m.keySize);
+            if(other == NULL || !entriesEqual(m.value, other->value))
+                return false;
+        }
+        return true;
+    case QDROPBOXJSON_TYPE_ARRAY:
+        if(a.size != b.size)
+            return false;
+        for(int i=0; i<a.size; ++i)
+        {
+            if(!entriesEqual(a.value.items[i], b.value.items[i]))
+                return false;
+        }
+        return true;
+    case QDROPBOXJSON_TYPE_STR:
+        return a.size == b.size && !memcmp(a.value.str, b.value.str, a.size);
+    case QDROPBOXJSON_TYPE_NUM:
+        return a.value.num == b.value.num;
+    case QDROPBOXJSON_TYPE_UINT:
+        return a.value.unum == b.value.unum;
+    case QDROPBOXJSON_TYPE_FLOAT:
+        return a.value.fp == b.value.fp;
+    case QDROPBOXJSON_TYPE_BOOL:
+        return a.value.boolean == b.value.boolean;
+    default:
+        return true;
+    }
+}
+
+// deep copy of a value into another arena
+static qdropboxjson_entry copyEntry(QDropboxJsonArena *arena, const qdropboxjson_entry &e)
+{
+    qdropboxjson_entry copy = e;
+    switch(e.type)
+    {
+    case QDROPBOXJSON_TYPE_JSON:
+        copy.value.members = arena->allocate<qdropboxjson_member>(e.size);
+        for(int i=0; i<e.size; ++i)
+        {
+            const qdropboxjson_member &m = e.value.members[i];
+            copy.value.members[i].key     = arena->copy(m.key, m.keySize);
+            copy.value.members[i].keySize = m.keySize;
+            copy.value.members[i].value   = copyEntry(arena, m.value);
+        }
+        break;
+    case QDROPBOXJSON_TYPE_ARRAY:
+        copy.value.items = arena->allocate<qdropboxjson_entry>(e.size);
+        for(int i=0; i<e.size; ++i)
+            copy.value.items[i] = copyEntry(arena, e.value.items[i]);
+        break;
+    case QDROPBOXJSON_TYPE_STR:
+        copy.value.str = arena->copy(e.value.str, e.size);
+        break;
+    default:
+        break;
+    }
+    return copy;
+}
+
+//! Parsed tree of a QDropboxJson that is shared between its copies
+class QDropboxJsonData : public QSharedData
+{
+public:
+    QDropboxJsonData()
+    {
+        root.type          = QDROPBOXJSON_TYPE_JSON;
+        root.size          = 0;
+        root.value.members = NULL;
+    }
+
+    QDropboxJsonArena  arena;
+    qdropboxjson_entry root;
+};
+
+bool QDropboxJsonParser::parse(qdropboxjson_entry *root, bool *anonymousArray)
+{
+    skipWhitespace();
+    if(_pos == _end)
+        return false;
+
+    bool ok = false;
+    if(*_pos == '{')
+        ok = parseObject(root);
+    else if(*_pos == '[')
     {
 #ifdef QTDROPBOX_DEBUG
-    qDebug() << "string does not start with { " << endl;
+        qDebug() << "JSON is anonymous array" << endl;
 #endif
+        // anonymous arrays are stored with a fixed key
+        qdropboxjson_member *m = _arena->allocate<qdropboxjson_member>(1);
+        m->key     = _arena->copy("_anonArray", 10);
+        m->keySize = 10;
+        ok = parseArray(&m->value);
+
+        root->type          = QDROPBOXJSON_TYPE_JSON;
+        root->size          = 1;
+        root->value.members = m;
+        *anonymousArray     = true;
+    }
 
-		if(strJson.startsWith("[") && strJson.endsWith("]"))
-		{
+    if(!ok)
+        return false;
+
+    // nothing but whitespace may follow
+    skipWhitespace();
+    return _pos == _end;
+}
+
+void QDropboxJsonParser::skipWhitespace()
+{
+    while(_pos < _end && (*_pos == ' ' || *_pos == '\n' || *_pos == '\r' || *_pos == '\t'))
+        ++_pos;
+}
+
+bool QDropboxJsonParser::parseObject(qdropboxjson_entry *entry)
+{
+    ++_pos; // {
+    const int mark = _members.size();
+
+    skipWhitespace();
+    bool closed = (_pos < _end && *_pos == '}');
+    if(closed)
+        ++_pos;
+
+    while(!closed && _pos < _end)
+    {
+        skipWhitespace();
+        qdropboxjson_member m;
+        if(!parseString(&m.key, &m.keySize))
+            return false;
+
+        skipWhitespace();
+        if(_pos == _end || *_pos != ':')
+            return false;
+        ++_pos;
+        skipWhitespace();
+
+        if(!parseValue(&m.value))
+            return false;
+        _members.append(m);
+
+        skipWhitespace();
+        if(_pos == _end)
+            return false;
+        if(*_pos == '}')
+            closed = true;
+        else if(*_pos != ',')
+            return false;
+        ++_pos;
+    }
+
+    if(!closed)
+        return false;
+
+    // the members of this object are on top of the stack
+    const int size = _members.size()-mark;
+    entry->type          = QDROPBOXJSON_TYPE_JSON;
+    entry->size          = size;
+    entry->value.members = _arena->allocate<qdropboxjson_member>(size);
+    if(size > 0)
+        memcpy(entry->value.members, _members.constData()+mark, size*sizeof(qdropboxjson_member));
+    _members.resize(mark);
+    return true;
+}
+
+bool QDropboxJsonParser::parseArray(qdropboxjson_entry *entry)
+{
+    ++_pos; // [
+    const int mark = _items.size();
+
+    skipWhitespace();
+    bool closed = (_pos < _end && *_pos == ']');
+    if(closed)
+        ++_pos;
+
+    while(!closed && _pos < _end)
+    {
+        skipWhitespace();
+        qdropboxjson_entry e;
+        if(!parseValue(&e))
+            return false;
+        _items.append(e);
+
+        skipWhitespace();
+        if(_pos == _end)
+            return false;
+        if(*_pos == ']')
+            closed = true;
+        else if(*_pos != ',')
+            return false;
+        ++_pos;
+    }
+
+    if(!closed)
+        return false;
+
+    const int size = _items.size()-mark;
+    entry->type        = QDROPBOXJSON_TYPE_ARRAY;
+    entry->size        = size;
+    entry->value.items = _arena->allocate<qdropboxjson_entry>(size);
+    if(size > 0)
+        memcpy(entry->value.items, _items.constData()+mark, size*sizeof(qdropboxjson_entry));
+    _items.resize(mark);
+    return true;
+}
+
+bool QDropboxJsonParser::parseValue(qdropboxjson_entry *entry)
+{
+    if(_pos == _end)
+        return false;
+
+    switch(*_pos)
+    {
+    case '{':
+        if(!parseObject(entry))
+        {
 #ifdef QTDROPBOX_DEBUG
-			qDebug() << "JSON is anonymous array" << endl;
+            qDebug() << "subjson invalid!" << endl;
 #endif
-			_anonymousArray = true;
-			// fix json to be parseable by the algorithm below
-			strJson = "{\"_anonArray\":"+strJson+"}";
-		}
-		else
-		{
-			valid = false;
-			return;
-		}
+            return false;
+        }
+        return true;
+    case '[':
+        return parseArray(entry);
+    case '"':
+        entry->type = QDROPBOXJSON_TYPE_STR;
+        return parseString(&entry->value.str, &entry->size);
+    default:
+        break;
     }
 
-    QString buffer   = "";
-    QString key      = "";
-    QString value    = "";
+    // literals: numbers, true, false and null
+    const char *start = _pos;
+    while(_pos < _end && ((*_pos >= '0' && *_pos <= '9') || (*_pos >= 'a' && *_pos <= 'z') ||
+                          *_pos == '-' || *_pos == '+' || *_pos == '.' || *_pos == 'E'))
+        ++_pos;
+
+    if(_pos == start)
+        return false;
+
+    entry->size = 0;
+    const int length = _pos-start;
+    if(length == 4 && !qstrncmp(start, "true", 4))
+    {
+        entry->type          = QDROPBOXJSON_TYPE_BOOL;
+        entry->value.boolean = true;
+        return true;
+    }
+    if(length == 5 && !qstrncmp(start, "false", 5))
+    {
+        entry->type          = QDROPBOXJSON_TYPE_BOOL;
+        entry->value.boolean = false;
+        return true;
+    }
+    if(length == 4 && !qstrncmp(start, "null", 4))
+    {
+        entry->type = QDROPBOXJSON_TYPE_UNKNOWN;
+        return true;
+    }
 
-    bool isKey       = true;
-    bool insertValue = false;
-    bool isJson      = false;
-    bool isArray     = false;
-    bool openQuotes  = false;
+    return parseNumber(start, entry);
+}
 
+bool QDropboxJsonParser::parseString(const char **str, int *size)
+{
+    if(_pos == _end || *_pos != '"')
+        return false;
 
-    for(int i=0; i<strJson.size(); ++i)
+    // decoded strings are never longer than their escaped form
+    char *start = ++_pos;
+    char *out   = start;
+    while(_pos < _end)
     {
-        switch(strJson.at(i).toLatin1())
+        char c = *_pos++;
+        if(c == '"')
         {
-        case '"':
-            if(!isKey)
-            {
-                buffer += "\"";
-                openQuotes = !openQuotes;
-            }
-            continue;
-            break;
-        case ' ':
-            if(!isKey)
-                buffer += " ";
-            continue;
-            break;
-        case '}':
-	    if(openQuotes)
-	      buffer += "}";
+            *str  = start;
+            *size = out-start;
+            return true;
+        }
+        if(c != '\\')
+        {
+            *out++ = c;
             continue;
-            break;
-        case ':':
-            if(!isKey)
+        }
+
+        if(_pos == _end)
+            return false;
+
+        c = *_pos++;
+        switch(c)
+        {
+        case 'b': *out++ = '\b'; break;
+        case 'f': *out++ = '\f'; break;
+        case 'n': *out++ = '\n'; break;
+        case 'r': *out++ = '\r'; break;
+        case 't': *out++ = '\t'; break;
+        case 'u':
+        {
+            uint code;
+            if(!readHex(&code))
+                return false;
+
+            // surrogate pairs are encoded as two escapes
+            if(code >= 0xD800 && code < 0xDC00 && _end-_pos >= 6 && _pos[0] == '\\' && _pos[1] == 'u')
             {
-                buffer += ":";
-                continue;
+                char *pair = _pos;
+                uint  low;
+                _pos += 2;
+                if(readHex(&low) && low >= 0xDC00 && low < 0xE000)
+                    code = 0x10000 + ((code-0xD800) << 10) + (low-0xDC00);
+                else
+                    _pos = pair;
             }
-#ifdef QTDROPBOX_DEBUG
-            qDebug() << "key = " << buffer << endl;
-#endif
-
-            key    = buffer.trimmed();
-            buffer = "";
-            isKey  = false;
+            out = writeUtf8(out, code);
             break;
-        case ',':
-            if(openQuotes)
-			{
-				buffer += ',';
-                continue;
-			}
-#ifdef QTDROPBOX_DEBUG
-            qDebug() << "value = " << buffer << endl;
-#endif
-            value       = buffer.trimmed();
-            buffer      = "";
-            isKey       = true;
-            insertValue = true;
-            break;
-        case '{':
-            if(i == 0)
-                continue;
-	    if(!openQuotes)
-              isJson  = true;
-            buffer += '{';
-            break;
-        case '[':
-	    if(!openQuotes)
-              isArray = true;
-            buffer += '[';
-            break;
-        default:
-            buffer += strJson.at(i);
+        }
+        default: // \" \\ and \/
+            *out++ = c;
             break;
         }
+    }
 
-        if(isJson)
-        {
-            // create new json object with data until }
-            qdropboxjson_entry e;
-			int offset = parseSubJson(strJson, i, &e);
-            valueMap[key] = e;
-            key = "";
-
-            // ignore next ,
-            i = offset+1;
-            buffer      = "";
-            isJson      = false;
-            insertValue = false;
-            isKey       = true;
-            //continue;
-        }
+    return false;
+}
 
-		 if(isArray)
-         {
-			 // value is an array value -> parse array
-			 bool inString    = false;
-			 bool arrayEnd    = false;
-             int arrayDepth = 0;
-			 int j = i+1;
-			 buffer = "[";
-			 for(;!arrayEnd && j<strJson.size();++j)
-			 {
-				 QChar arrC = strJson.at(j);
-				 switch(arrC.toLatin1())
-				 {
-				 case '"': 
-					 inString = !inString;
-					 buffer += arrC;
-					 break;
-                 case '[':
-                     buffer += "[";
-                     arrayDepth += 1;
-                     break;
-				 case ']':
-					 buffer += "]";
-                     if(!inString)
-                     {
-                         if(arrayDepth == 0)
-                         {
-                            arrayEnd = true;
-                         }
-                         else
-                         {
-                            arrayDepth -= 1;
-                         }
-                     }
-					 break;
-				 case '\\':
-					 if(strJson.at(j+1) == '"') // escaped double quote
-					 {
-						 buffer += "\"";
-						 j++;
-					 }
-					 else
-						 buffer += "\\";
-					 break;
-				 default:
-					 buffer += arrC;
-					 break;
-				 }
-			 }
-			 
-			 // save array value string (buffer)
-			 value       = buffer;
-			 buffer      = "";
-			 i           = j;
-			 insertValue = true;
-			 isArray     = false;
-			 isKey       = true; // next element is started
-		 }
-
-        if(insertValue)
+bool QDropboxJsonParser::readHex(uint *code)
+{
+    if(_end-_pos < 4)
+        return false;
+
+    *code = 0;
+    for(int i=0; i<4; ++i)
+    {
+        const char h = *_pos++;
+        *code <<= 4;
+        if(h >= '0' && h <= '9')
+            *code |= h - '0';
+        else if(h >= 'a' && h <= 'f')
+            *code |= h - 'a' + 10;
+        else if(h >= 'A' && h <= 'F')
+            *code |= h - 'A' + 10;
+        else
+            return false;
+    }
+    return true;
+}
+
+bool QDropboxJsonParser::parseNumber(const char *start, qdropboxjson_entry *entry)
+{
+    const char *p = start;
+    const bool negative = (*p == '-');
+    if(negative)
+        ++p;
+    if(p == _pos)
+        return false;
+
+    // integers are accumulated directly, everything else is a floating point number
+    quint64 value    = 0;
+    bool    integer  = true;
+    bool    overflow = false;
+    for(; p < _pos; ++p)
+    {
+        if(*p < '0' || *p > '9')
         {
-#ifdef QTDROPBOX_DEBUG
-            qDebug() << "insert value " << key << " with content = " << value.trimmed() << " and type = " << interpretType(value.trimmed()) << endl;
-#endif
-            qdropboxjson_entry e;
-			QString *valuePointer = new QString(value.trimmed());
-			e.value.value = valuePointer;
-            e.type        = interpretType(value.trimmed());
-            valueMap[key] = e;
-
-            key   = "";
-            value = "";
-            insertValue = false;
+            integer = false;
+            break;
         }
+
+        const quint64 digit = *p - '0';
+        if(value > (Q_UINT64_C(0xFFFFFFFFFFFFFFFF) - digit) / 10)
+            overflow = true;
+        value = value*10 + digit;
     }
 
-    // there's some key left
-    if(key.compare(""))
+    if(integer && !overflow)
     {
-#ifdef QTDROPBOX_DEBUG
-            qDebug() << "rest value = " << buffer << endl;
-#endif
-        // but no value in the buffer -> json is invalid because a value is missing
-        if(!buffer.compare(""))
+        if(negative && value <= Q_UINT64_C(0x8000000000000000))
         {
-            valid = false;
+            entry->type      = QDROPBOXJSON_TYPE_NUM;
+            entry->value.num = value ? -qint64(value-1)-1 : 0;
+            return true;
         }
-        else
+        if(!negative && value <= quint64(INT_MAX))
         {
-            // if there's a value left we store it
-            qdropboxjson_entry e;
-            e.value.value = new QString(buffer.trimmed());
-            e.type        = interpretType(buffer.trimmed());
-            valueMap[key] = e;
+            entry->type      = QDROPBOXJSON_TYPE_NUM;
+            entry->value.num = qint64(value);
+            return true;
         }
+        if(!negative)
+        {
+            entry->type       = QDROPBOXJSON_TYPE_UINT;
+            entry->value.unum = value;
+            return true;
+        }
+    }
+
+    bool ok;
+    double fp = QByteArray::fromRawData(start, _pos-start).toDouble(&ok);
+    if(!ok)
+        return false;
+
+    entry->type     = QDROPBOXJSON_TYPE_FLOAT;
+    entry->value.fp = fp;
+    return true;
+}
+
+QDropboxJson::QDropboxJson(QObject *parent) :
+    QObject(parent)
+{
+    _init();
+}
+
+QDropboxJson::QDropboxJson(QString strJson, QObject *parent) :
+    QObject(parent)
+{
+    _init();
+    parseString(strJson);
+}
 
+QDropboxJson::QDropboxJson(const QDropboxJson &other) :
+    QObject(other.parent())
+{
+    // sub JSONs are copied as a view into the data of the JSON they belong to
+    d               = other._owner->d;
+    valid           = other.valid;
+    _anonymousArray = other._anonymousArray;
+    _owner          = this;
+    _node           = other._node;
+    _capacity       = 0;
+}
+
+QDropboxJson::QDropboxJson(QDropboxJson *owner, qdropboxjson_entry *node) :
+    QObject(0)
+{
+    valid           = true;
+    _anonymousArray = false;
+    _owner          = owner;
+    _node           = node;
+    _capacity       = 0;
+}
+
+QDropboxJson::~QDropboxJson()
+{
+    qDeleteAll(_subJsons);
+}
+
+void QDropboxJson::_init()
+{
+	valid          = false;
+	_anonymousArray = false;
+    d               = new QDropboxJsonData();
+    _owner          = this;
+    _node           = &d->root;
+    _capacity       = 0;
+}
+
+void QDropboxJson::detach()
+{
+    // sub JSONs are part of the data of their owner
+    if(_owner != this)
+    {
+        _owner->detach();
+        return;
     }
 
+    if(d->ref.load() == 1)
+        return;
+
+    // only the part of the tree this JSON refers to is copied
+    QDropboxJsonData *data = new QDropboxJsonData();
+    data->root = copyEntry(&data->arena, *_node);
+    d          = data;
+    _node      = &d->root;
+    _capacity  = 0;
+    repointSubJsons();
+    return;
+}
+
+void QDropboxJson::repointSubJsons()
+{
+    QMap<QString, QDropboxJson*>::iterator it;
+    for(it = _subJsons.begin(); it != _subJsons.end(); ++it)
+    {
+        QDropboxJson *json = it.value();
+        json->_node     = &findMember(_node, it.key())->value;
+        json->_capacity = 0;
+        json->repointSubJsons();
+    }
+    return;
+}
+
+QDropboxJsonArena *QDropboxJson::arena()
+{
+    return &_owner->d->arena;
+}
+
+void QDropboxJson::parseString(QString strJson)
+{
+    parseUtf8(strJson.toUtf8());
+    return;
+}
+
+void QDropboxJson::parseUtf8(const QByteArray &utf8Json)
+{
+#ifdef QTDROPBOX_DEBUG
+    qDebug() << "parse string = " << utf8Json << endl;
+#endif
+
+    // clear all existing data
+    emptyList();
+    _anonymousArray = false;
+
+    QDropboxJsonParser parser(arena(), utf8Json);
+    valid = parser.parse(_node, &_anonymousArray);
+
+    if(!valid)
+    {
+#ifdef QTDROPBOX_DEBUG
+        qDebug() << "json invalid" << endl;
+#endif
+        _node->type          = QDROPBOXJSON_TYPE_JSON;
+        _node->size          = 0;
+        _node->value.members = NULL;
+    }
     return;
 }
 
@@ -277,18 +779,16 @@ bool QDropboxJson::isValid()
 
 bool QDropboxJson::hasKey(QString key)
 {
-    return valueMap.contains(key);
+    return findMember(_node, key) != NULL;
 }
 
 QDropboxJson::DataType QDropboxJson::type(QString key)
 {
-    if(!valueMap.contains(key))
+    const qdropboxjson_member *m = findMember(_node, key);
+    if(m == NULL)
         return UnknownType;
 
-    qdropboxjson_entry_type t;
-    t = valueMap.value(key).type;
-
-    switch(t)
+    switch(m->value.type)
     {
     case QDROPBOXJSON_TYPE_NUM:
         return NumberType;
@@ -312,188 +812,222 @@ QDropboxJson::DataType QDropboxJson::type(QString key)
 
 qint64 QDropboxJson::getInt(QString key, bool force)
 {
-    if(!valueMap.contains(key))
+    const qdropboxjson_member *m = findMember(_node, key);
+    if(m == NULL)
         return 0;
 
-    qdropboxjson_entry e;
-    e = valueMap.value(key);
+    const qdropboxjson_entry &e = m->value;
+
+    if(e.type == QDROPBOXJSON_TYPE_NUM)
+        return e.value.num;
 
-    if(!force && e.type != QDROPBOXJSON_TYPE_NUM)
+    if(!force)
         return 0;
 
-    return e.value.value->toInt();
+    switch(e.type)
+    {
+    case QDROPBOXJSON_TYPE_UINT:
+        return qint64(e.value.unum);
+    case QDROPBOXJSON_TYPE_FLOAT:
+        return qint64(e.value.fp);
+    case QDROPBOXJSON_TYPE_BOOL:
+        return e.value.boolean ? 1 : 0;
+    case QDROPBOXJSON_TYPE_STR:
+        return entryString(e).toLongLong();
+    default:
+        return 0;
+    }
 }
 
 void QDropboxJson::setInt(QString key, qint64 value)
 {
-    if(valueMap.contains(key)){
-        valueMap[key].value.value->setNum(value);
-    }else{
-        qdropboxjson_entry e;
-        QString *valuePointer = new QString();
-        valuePointer->setNum(value);
-        e.value.value = valuePointer;
-        e.type        = QDROPBOXJSON_TYPE_NUM;
-        valueMap[key] = e;
-    }
+    qdropboxjson_entry e;
+    e.type      = QDROPBOXJSON_TYPE_NUM;
+    e.size      = 0;
+    e.value.num = value;
+    setEntry(key, e);
 }
 
 quint64 QDropboxJson::getUInt(QString key, bool force)
 {
-    if(!valueMap.contains(key))
+    const qdropboxjson_member *m = findMember(_node, key);
+    if(m == NULL)
         return 0;
 
-    qdropboxjson_entry e;
-    e = valueMap.value(key);
+    const qdropboxjson_entry &e = m->value;
 
-    if(!force && e.type != QDROPBOXJSON_TYPE_UINT)
+    if(e.type == QDROPBOXJSON_TYPE_UINT)
+        return e.value.unum;
+
+    if(!force)
         return 0;
 
-    return e.value.value->toUInt();
+    switch(e.type)
+    {
+    case QDROPBOXJSON_TYPE_NUM:
+        return quint64(e.value.num);
+    case QDROPBOXJSON_TYPE_FLOAT:
+        return quint64(e.value.fp);
+    case QDROPBOXJSON_TYPE_BOOL:
+        return e.value.boolean ? 1 : 0;
+    case QDROPBOXJSON_TYPE_STR:
+        return entryString(e).toULongLong();
+    default:
+        return 0;
+    }
 }
 
 void QDropboxJson::setUInt(QString key, quint64 value)
 {
-    if(valueMap.contains(key)){
-        valueMap[key].value.value->setNum(value);
-    }else{
-        qdropboxjson_entry e;
-        QString *valuePointer = new QString();
-        valuePointer->setNum(value);
-        e.value.value = valuePointer;
-        e.type        = QDROPBOXJSON_TYPE_UINT;
-        valueMap[key] = e;
-    }
+    qdropboxjson_entry e;
+    e.type       = QDROPBOXJSON_TYPE_UINT;
+    e.size       = 0;
+    e.value.unum = value;
+    setEntry(key, e);
 }
 
 QString QDropboxJson::getString(QString key, bool force)
 {
-    if(!valueMap.contains(key))
+    const qdropboxjson_member *m = findMember(_node, key);
+    if(m == NULL)
         return "";
 
-    qdropboxjson_entry e;
-    e = valueMap.value(key);
-
-    if(!force && e.type != QDROPBOXJSON_TYPE_STR)
+    if(!force && m->value.type != QDROPBOXJSON_TYPE_STR)
         return "";
 
-	QString value = e.value.value->mid(1, e.value.value->size()-2);
-    return value;
+    return entryString(m->value);
 }
 
 void QDropboxJson::setString(QString key, QString value)
 {
-    if(valueMap.contains(key)){
-        *(valueMap[key].value.value) = value;
-    }else{
-        qdropboxjson_entry e;
-        QString *valuePointer = new QString(value);
-        e.value.value = valuePointer;
-        e.type        = QDROPBOXJSON_TYPE_STR;
-        valueMap[key] = e;
-    }
+    const QByteArray utf8 = value.toUtf8();
+
+    // the string has to be placed in the arena that is kept after detaching
+    detach();
+
+    qdropboxjson_entry e;
+    e.type      = QDROPBOXJSON_TYPE_STR;
+    e.size      = utf8.size();
+    e.value.str = arena()->copy(utf8.constData(), utf8.size());
+    setEntry(key, e);
 }
 
 QDropboxJson* QDropboxJson::getJson(QString key)
 {
-    if(!valueMap.contains(key))
+    qdropboxjson_member *m = findMember(_node, key);
+    if(m == NULL)
         return NULL;
 
-    qdropboxjson_entry e;
-    e = valueMap.value(key);
-
-    if(e.type != QDROPBOXJSON_TYPE_JSON)
+    if(m->value.type != QDROPBOXJSON_TYPE_JSON)
         return NULL;
 
+    // sub JSONs are created on first access and share the data
+    QDropboxJson *json = _subJsons.value(key);
+    if(json == NULL)
+    {
+        json = new QDropboxJson(_owner, &m->value);
+        _subJsons.insert(key, json);
+    }
 
-    return e.value.json;
+    return json;
 }
 
 void QDropboxJson::setJson(QString key, QDropboxJson value)
 {
-    if(valueMap.contains(key)){
-        *(valueMap[key].value.json) = value;
-    }else{
-        qdropboxjson_entry e;
-        QDropboxJson *valuePointer = new QDropboxJson(value);
-        e.value.json = valuePointer;
-        e.type        = QDROPBOXJSON_TYPE_JSON;
-        valueMap[key] = e;
-    }
+    detach();
+    setEntry(key, copyEntry(arena(), *value._node));
 }
 
 double QDropboxJson::getDouble(QString key, bool force)
 {
-    if(!valueMap.contains(key))
+    const qdropboxjson_member *m = findMember(_node, key);
+    if(m == NULL)
         return 0.0f;
 
-    qdropboxjson_entry e;
-    e = valueMap.value(key);
+    const qdropboxjson_entry &e = m->value;
+
+    if(e.type == QDROPBOXJSON_TYPE_FLOAT)
+        return e.value.fp;
 
-    if(!force && e.type != QDROPBOXJSON_TYPE_FLOAT)
+    if(!force)
         return 0.0f;
 
-    return e.value.value->toDouble();
+    switch(e.type)
+    {
+    case QDROPBOXJSON_TYPE_NUM:
+        return double(e.value.num);
+    case QDROPBOXJSON_TYPE_UINT:
+        return double(e.value.unum);
+    case QDROPBOXJSON_TYPE_BOOL:
+        return e.value.boolean ? 1.0 : 0.0;
+    case QDROPBOXJSON_TYPE_STR:
+        return entryString(e).toDouble();
+    default:
+        return 0.0f;
+    }
 }
 
 void QDropboxJson::setDouble(QString key, double value)
 {
-    if(valueMap.contains(key)){
-        valueMap[key].value.value->setNum(value);
-    }else{
-        qdropboxjson_entry e;
-        QString *valuePointer = new QString();
-        valuePointer->setNum(value);
-        e.value.value = valuePointer;
-        e.type        = QDROPBOXJSON_TYPE_FLOAT;
-        valueMap[key] = e;
-    }
+    qdropboxjson_entry e;
+    e.type     = QDROPBOXJSON_TYPE_FLOAT;
+    e.size     = 0;
+    e.value.fp = value;
+    setEntry(key, e);
 }
 
 bool QDropboxJson::getBool(QString key, bool force)
 {
-    if(!valueMap.contains(key))
+    const qdropboxjson_member *m = findMember(_node, key);
+    if(m == NULL)
         return false;
 
-    qdropboxjson_entry e;
-    e = valueMap.value(key);
+    const qdropboxjson_entry &e = m->value;
 
-    if(!force && e.type != QDROPBOXJSON_TYPE_BOOL)
-        return false;
+    if(e.type == QDROPBOXJSON_TYPE_BOOL)
+        return e.value.boolean;
 
-    if(!e.value.value->compare("false"))
+    if(!force)
         return false;
 
-    return true;
+    switch(e.type)
+    {
+    case QDROPBOXJSON_TYPE_NUM:
+        return e.value.num != 0;
+    case QDROPBOXJSON_TYPE_UINT:
+        return e.value.unum != 0;
+    case QDROPBOXJSON_TYPE_FLOAT:
+        return e.value.fp != 0.0;
+    case QDROPBOXJSON_TYPE_STR:
+        return entryString(e).compare("false") != 0;
+    case QDROPBOXJSON_TYPE_UNKNOWN:
+        return false;
+    default:
+        return true;
+    }
 }
 
 void QDropboxJson::setBool(QString key, bool value)
 {
-    if(valueMap.contains(key)){
-        *(valueMap[key].value.value) = value ? "true" : "false";
-    }else{
-        qdropboxjson_entry e;
-        QString *valuePointer = new QString(value ? "true" : "false");
-        e.value.value = valuePointer;
-        e.type        = QDROPBOXJSON_TYPE_BOOL;
-        valueMap[key] = e;
-    }
+    qdropboxjson_entry e;
+    e.type          = QDROPBOXJSON_TYPE_BOOL;
+    e.size          = 0;
+    e.value.boolean = value;
+    setEntry(key, e);
 }
 
 QDateTime QDropboxJson::getTimestamp(QString key, bool force)
 {
-	if(!valueMap.contains(key))
+	const qdropboxjson_member *m = findMember(_node, key);
+	if(m == NULL)
 		return QDateTime();
 
-	qdropboxjson_entry e;
-	e = valueMap.value(key);
-
-	if(!force && e.type != QDROPBOXJSON_TYPE_STR)
+	if(!force && m->value.type != QDROPBOXJSON_TYPE_STR)
 		return QDateTime();
 
     const QString dtFormat = "dd MMM yyyy HH:mm:ss";
 
-    QDateTime res = QLocale(QLocale::English).toDateTime(e.value.value->mid(6, dtFormat.size()), dtFormat);
+    QDateTime res = QLocale(QLocale::English).toDateTime(entryString(m->value).mid(5, dtFormat.size()), dtFormat);
     res.setTimeSpec(Qt::UTC);
 
     return res;
@@ -505,197 +1039,217 @@ void QDropboxJson::setTimestamp(QString key, QDateTime value)
 
     value = value.toUTC();
 
-    if(valueMap.contains(key)){
-        *(valueMap[key].value.value) = value.toString(dtFormat);
-    }else{
-        qdropboxjson_entry e;
-        QString *valuePointer = new QString(QLocale{QLocale::English}.toString(value, dtFormat));
-        e.value.value = valuePointer;
-        e.value.value = valuePointer;
-        e.type        = QDROPBOXJSON_TYPE_STR;
-        valueMap[key] = e;
-    }
+    setString(key, QLocale(QLocale::English).toString(value, dtFormat));
 }
 
-QString QDropboxJson::strContent() const
+void QDropboxJson::setEntry(QString key, const qdropboxjson_entry &e)
 {
-	if(valueMap.size() == 0)
-		return "";
+    detach();
 
-    QString content = "{";
-	QList<QString> keys = valueMap.keys();
-	for(int i=0; i<keys.size(); ++i)
-	{
-		QString value = "";
-		qdropboxjson_entry e = valueMap.value(keys.at(i));
+    // a replaced sub JSON must not be accessed any more
+    if(_subJsons.contains(key))
+        delete _subJsons.take(key);
 
-		if(e.type != QDROPBOXJSON_TYPE_JSON)
-			value = *e.value.value;
-		else
-			value = e.value.json->strContent();
-
-		content.append(QString("\"%1\": %2").arg(keys.at(i)).arg(value));
-		if(i != keys.size()-1)
-			content.append(", ");
-	}
-	content.append("}");
-	return content;
-}
+    qdropboxjson_member *m = findMember(_node, key);
+    if(m != NULL)
+    {
+        m->value = e;
+        return;
+    }
 
-void QDropboxJson::emptyList()
-{
-    QList<QString> keys = valueMap.keys();
-    for(qint32 i=0; i<keys.size(); ++i)
+    // members are never freed on their own, a bigger copy is placed in the arena instead
+    const int size = _node->size;
+    if(size >= _capacity)
     {
-        qdropboxjson_entry e = valueMap.value(keys.at(i));
-        if(e.type == QDROPBOXJSON_TYPE_JSON)
-            delete e.value.json;
-        else
-            delete e.value.value;
-		valueMap.remove(keys.at(i));
+        _capacity = qMax(4, size*2);
+        qdropboxjson_member *members = arena()->allocate<qdropboxjson_member>(_capacity);
+        if(size > 0)
+            memcpy(members, _node->value.members, size*sizeof(qdropboxjson_member));
+        _node->value.members = members;
+
+        // cached sub JSONs still point to the old members
+        QMap<QString, QDropboxJson*>::iterator it;
+        for(it = _subJsons.begin(); it != _subJsons.end(); ++it)
+            it.value()->_node = &findMember(_node, it.key())->value;
     }
-    valueMap.clear();
+
+    const QByteArray utf8Key = key.toUtf8();
+    m = &_node->value.members[size];
+    m->key     = arena()->copy(utf8Key.constData(), utf8Key.size());
+    m->keySize = utf8Key.size();
+    m->value   = e;
+    _node->size = size+1;
     return;
 }
 
-qdropboxjson_entry_type QDropboxJson::interpretType(QString value)
+QString QDropboxJson::strContent() const
 {
-    // check for string
-    if(value.startsWith("\"") && value.endsWith("\""))
-        return QDROPBOXJSON_TYPE_STR;
-
-    // check for integer
-    bool ok;
-    value.toInt(&ok);
-    if(ok)
-        return QDROPBOXJSON_TYPE_NUM;
-
-    // check for uint
-    value.toUInt(&ok);
-    if(ok)
-        return QDROPBOXJSON_TYPE_UINT;
+	if(_node->size == 0)
+		return "";
 
-    // check for bool
-    if(!value.compare("true") || !value.compare("false"))
-        return QDROPBOXJSON_TYPE_BOOL;
+    return entryContent(*_node);
+}
 
-    // check for array
-    if(value.startsWith("[") && value.endsWith("]"))
-        return QDROPBOXJSON_TYPE_ARRAY;
+void QDropboxJson::emptyList()
+{
+    qDeleteAll(_subJsons);
+    _subJsons.clear();
 
-    value.toDouble(&ok);
-    if(ok)
-        return QDROPBOXJSON_TYPE_FLOAT;
+    if(_owner != this)
+    {
+        _owner->detach();
+    }
+    else if(d->ref.load() != 1)
+    {
+        // the data is still used by copies of this JSON
+        d     = new QDropboxJsonData();
+        _node = &d->root;
+    }
+    else
+    {
+        // the whole tree is released at once
+        d->arena.reset();
+        _node = &d->root;
+    }
 
-    return QDROPBOXJSON_TYPE_UNKNOWN;
+    _node->type          = QDROPBOXJSON_TYPE_JSON;
+    _node->size          = 0;
+    _node->value.members = NULL;
+    _capacity            = 0;
+    return;
 }
 
-QDropboxJson& QDropboxJson::operator=(QDropboxJson& other)
+QDropboxJson& QDropboxJson::operator=(const QDropboxJson& other)
 {
-	/*!< \todo use toString() */
-	parseString(other.strContent());
+	if(&other == this)
+		return *this;
+
+	if(_owner != this)
+	{
+		// a sub JSON is replaced within the data of its owner
+		detach();
+		qdropboxjson_entry copy = copyEntry(arena(), *other._node);
+		qDeleteAll(_subJsons);
+		_subJsons.clear();
+		*_node    = copy;
+		_capacity = 0;
+		return *this;
+	}
+
+	// keep the data of other alive, it may be a sub JSON of this JSON
+	QExplicitlySharedDataPointer<QDropboxJsonData> data = other._owner->d;
+	qdropboxjson_entry *node = other._node;
+	valid           = other.valid;
+	_anonymousArray = other._anonymousArray;
+
+	qDeleteAll(_subJsons);
+	_subJsons.clear();
+	d         = data;
+	_node     = node;
+	_capacity = 0;
 	return *this;
 }
 
 QStringList QDropboxJson::getArray(QString key, bool force)
 {
 	QStringList list;
-	if(!valueMap.contains(key))
+	const qdropboxjson_member *m = findMember(_node, key);
+	if(m == NULL)
         return list;
 
-    qdropboxjson_entry e;
-    e = valueMap.value(key);
-
-    if(!force && e.type != QDROPBOXJSON_TYPE_ARRAY)
+    // there is nothing an array could be converted from
+    Q_UNUSED(force);
+    if(m->value.type != QDROPBOXJSON_TYPE_ARRAY)
         return list;
 
-	QString arrayStr = e.value.value->mid(1, e.value.value->length()-2);
-	QString buffer = "";
-	bool inString = false;
-	int  inJson   = 0;
-    int  inArray  = 0;
-	for(int i=0; i<arrayStr.size(); ++i)
+    list.reserve(m->value.size);
+    for(int i=0; i<m->value.size; ++i)
+        list.append(entryString(m->value.value.items[i]));
+
+    return list;
+}
+
+QList<QDropboxJson> QDropboxJson::getJsonArray(QString key)
+{
+	QList<QDropboxJson> list;
+	const qdropboxjson_member *m = findMember(_node, key);
+	if(m == NULL || m->value.type != QDROPBOXJSON_TYPE_ARRAY)
+		return list;
+
+	list.reserve(m->value.size);
+	for(int i=0; i<m->value.size; ++i)
 	{
-		QChar c = arrayStr.at(i);
-        if( ((c != ',' && c != ' ') || inString || inJson || inArray) &&
-            (c != '"' || inJson > 0 || inArray > 0))
-			buffer += c;
-		switch(c.toLatin1())
-		{
-		case '"':
-			if(i > 0 && arrayStr.at(i-1).toLatin1() == '\\')
-			{
-				buffer += c;
-				break;
-			}
-			else
-				inString = !inString;
-			break;
-        case '{':
-			inJson++;
-			break;
-		case '}':
-			inJson--;
-			break;
-        case '[':
-            inArray++;
-            break;
-        case ']':
-            inArray--;
-            break;
-		case ',':
-            if(inJson == 0 && inArray == 0 && !inString)
-			{
-				list.append(buffer);
-				buffer = "";
-			}
-			break;
-		}
+		if(m->value.value.items[i].type != QDROPBOXJSON_TYPE_JSON)
+			continue;
+
+		// a copy of this JSON that refers to the item instead of the root
+		QDropboxJson item(*this);
+		item.setParent(0);
+		item.valid           = true;
+		item._anonymousArray = false;
+		item._node           = &m->value.value.items[i];
+		list.append(item);
 	}
 
-	if(!buffer.isEmpty())
-		list.append(buffer);
-
-    return list;
+	return list;
 }
 
-int QDropboxJson::parseSubJson(QString strJson, int start, qdropboxjson_entry *jsonEntry)
+QStringList QDropboxJson::getArrayColumn(QString key, int column)
 {
-	int openBrackets = 1;
-	QString buffer = "";
-    QDropboxJson* jsonValue = NULL;
+	QStringList list;
+	const qdropboxjson_member *m = findMember(_node, key);
+	if(m == NULL || m->value.type != QDROPBOXJSON_TYPE_ARRAY)
+		return list;
 
-	int j;
-	for(j=start+1; openBrackets > 0 && j < strJson.size(); ++j)
+	list.reserve(m->value.size);
+	for(int i=0; i<m->value.size; ++i)
 	{
-		if(strJson.at(j).toLatin1() == '{')
-			openBrackets++;
-		else if(strJson.at(j).toLatin1() == '}')
-			openBrackets--;
+		const qdropboxjson_entry &row = m->value.value.items[i];
+		if(row.type != QDROPBOXJSON_TYPE_ARRAY || column < 0 || column >= row.size)
+			list.append(QString());
+		else
+			list.append(entryString(row.value.items[column]));
 	}
 
-	buffer = strJson.mid(start, j-start);
-#ifdef QTDROPBOX_DEBUG
-	qDebug() << "brackets = " << openBrackets << endl;
-	qDebug() << "json data(" << start << ":" << j-start << ") = " << buffer << endl;
-#endif
-	jsonValue = new QDropboxJson();
-	jsonValue->parseString(buffer);
+	return list;
+}
 
-	// invalid sub json means invalid json
-	if(!jsonValue->isValid())
+QList<QDropboxJson> QDropboxJson::getJsonArrayColumn(QString key, int column)
+{
+	QList<QDropboxJson> list;
+	const qdropboxjson_member *m = findMember(_node, key);
+	if(m == NULL || m->value.type != QDROPBOXJSON_TYPE_ARRAY)
+		return list;
+
+	list.reserve(m->value.size);
+	for(int i=0; i<m->value.size; ++i)
 	{
-#ifdef QTDROPBOX_DEBUG
-		qDebug() << "subjson invalid!" << endl;
-#endif
-		valid = false;
-		return j;
+		const qdropboxjson_entry &row = m->value.value.items[i];
+		if(row.type != QDROPBOXJSON_TYPE_ARRAY || column < 0 || column >= row.size ||
+		   row.value.items[column].type != QDROPBOXJSON_TYPE_JSON)
+		{
+			list.append(QDropboxJson());
+			continue;
+		}
+
+		// a copy of this JSON that refers to the item instead of the root
+		QDropboxJson item(*this);
+		item.setParent(0);
+		item.valid           = true;
+		item._anonymousArray = false;
+		item._node           = &row.value.items[column];
+		list.append(item);
 	}
 
-	// insert new
-	jsonEntry->value.json = jsonValue;
-	jsonEntry->type       = QDROPBOXJSON_TYPE_JSON;
-	return j;
+	return list;
+}
+
+QList<QDropboxJson> QDropboxJson::getJsonArray()
+{
+	if(!isAnonymousArray())
+		return QList<QDropboxJson>();
+
+	return getJsonArray("_anonArray");
 }
 
 bool QDropboxJson::isAnonymousArray()
@@ -713,35 +1267,5 @@ QStringList QDropboxJson::getArray()
 
 int QDropboxJson::compare(const QDropboxJson& other)
 {
-	if(valueMap.size() != other.valueMap.size())
-		return 1;
-
-	QMap<QString, qdropboxjson_entry> yourMap = other.valueMap;
-
-	QList<QString> keys = valueMap.keys();
-	for(int i=0; i<keys.size(); ++i)
-	{
-		QString key = keys.at(i);
-		if(!yourMap.contains(key))
-			return 1;
-
-		qdropboxjson_entry myEntry = valueMap.value(key);
-		qdropboxjson_entry yourEntry = yourMap.value(key);
-		
-		if(myEntry.type != yourEntry.type)
-			return 1;
-
-		if(myEntry.type == QDROPBOXJSON_TYPE_JSON)
-		{
-			if(myEntry.value.json->compare(*yourEntry.value.json) != 0)
-				return 1;
-		}
-		else
-		{
-			if(myEntry.value.value->compare(yourEntry.value.value) != 0)
-				return 1;
-		}
-	}
-
-	return 0;
+	return entriesEqual(*_node, *other._node) ? 0 : 1;
 }
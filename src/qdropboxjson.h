@@ -2,12 +2,14 @@
 #define QDROPBOXJSON_H
 
 #include "qtdropbox_global.h"
+#include "qdropboxjsonarena.h"
 
 #include <QObject>
 #include <QMap>
 #include <QList>
 #include <QDateTime>
 #include <QStringList>
+#include <QExplicitlySharedDataPointer>
 
 #ifdef QTDROPBOX_DEBUG
 #include <QDebug>
@@ -25,19 +27,40 @@ const qdropboxjson_entry_type QDROPBOXJSON_TYPE_UINT    = 'U';
 const qdropboxjson_entry_type QDROPBOXJSON_TYPE_UNKNOWN = '?';
 
 class QDropboxJson;
+class QDropboxJsonData;
+struct qdropboxjson_entry;
+struct qdropboxjson_member;
 
 //! Keeps values of a JSON
+/*!
+  Numbers and booleans are stored inline. The type is decided once while the JSON
+  is parsed so the getters do not have to convert the value on every access.
+  Strings, sub JSONs and arrays point into the QDropboxJsonArena of the JSON.
+ */
 union qdropboxjson_value{
-    QDropboxJson  *json; //!< Used to store subjsons (JSON in JSON)
-    QString       *value; //!< used to store a real value, all values are converted from QString
+    qdropboxjson_member *members; //!< Used to store subjsons (JSON in JSON)
+    qdropboxjson_entry  *items; //!< Used to store the elements of an array
+    const char          *str; //!< Unescaped UTF-8 data of strings
+    qint64               num; //!< Used to store integers
+    quint64              unum; //!< Used to store unsigned integers
+    double               fp; //!< Used to store floating point numbers
+    bool                 boolean; //!< Used to store booleans
 };
 
-//! Keeps keys of a JSON
+//! Keeps a single value of a JSON
 struct qdropboxjson_entry{
     qdropboxjson_entry_type type; //!< Datatype of value
+    int                     size; //!< Bytes of a string, keys of a subjson or items of an array
     qdropboxjson_value      value; //!< Reference to the value struct
 };
 
+//! Keeps keys of a JSON
+struct qdropboxjson_member{
+    const char         *key; //!< UTF-8 data of the key
+    int                 keySize; //!< Length of the key in bytes
+    qdropboxjson_entry  value; //!< Value mapped to the key
+};
+
 //! Used to store JSON data that is returned from Dropbox.
 /*!
   Most of the communication with Dropbox is handled by using JSON data structures. JSON is
@@ -46,15 +69,30 @@ struct qdropboxjson_entry{
   the mixed type values of a JSON to native C++ data types as good as possible.
 
   A JSON is usually passed as string and can be parsed by either passing that string to the
-  constructor or using parseString(). If any error occurs the QDropboxJson will be marked as
-  invalid (see isValid()).
+  constructor or using parseString(). Data that was received from the network can be passed
+  to parseUtf8() without converting it to a QString first. The complete tree of the JSON
+  including all sub JSONs and arrays is built in a single pass over the data. If any error
+  occurs the QDropboxJson will be marked as invalid (see isValid()).
+
+  All nodes and strings of the tree are kept in a QDropboxJsonArena that belongs to the
+  QDropboxJson. Parsing another JSON or destroying the object releases the complete tree at
+  once. Sub JSONs returned by getJson() share the arena of the JSON they belong to and are
+  only valid as long as that JSON is not parsed again or destroyed.
+
+  The set-functions place new strings, keys and member lists in the arena as well. Values
+  that are replaced are not freed before the JSON is parsed again or destroyed, so a JSON
+  that is modified over and over keeps growing. Copy such a JSON with
+  QDropboxJson(other.strContent()) now and then to compact it.
+
+  QDropboxJson is implicitly shared. Copies only reference the parsed tree of the original
+  and the tree is copied the first time one of the copies is modified. This also applies to
+  the copies returned by getJsonArray().
 
   The data of a valid QDropboxJson can be accessed by using one of the get-functions. If the
   value you want to access is not mapped to the datatype you requested an empty value will be
   returned. You can always set a force flag. If you do the returned value will be converted but
   may return nonsense data. Use this flag with care and only if you know what you're doing.
 
-  \warning Currently arrays in JSONs are not supported.
   \todo Implemement setter functions and toString() for JSON generation (altough not necessary it
         would be a nice feature)
  */
@@ -78,7 +116,8 @@ public:
     QDropboxJson(QString strJson, QObject *parent = 0);
 
     /*!
-      Copies the data of another QDropboxJSon.
+      Copies the data of another QDropboxJSon. The data is shared until one of
+      both JSONs is modified.
 
       \param other The QDropboxJson to be copied.
      */
@@ -96,7 +135,7 @@ public:
         NumberType, //!< Number based type (interpreted as qint64)
         StringType, //!< String based type of variable length
         JsonType,   //!< A subjson
-        ArrayType,  //!< Array data type (currently not supported!)
+        ArrayType,  //!< Array data type (see getArray())
         FloatType,  //!< Floating point based datatype
         BoolType,   //!< Boolean based types.
         UnsignedIntType, //!< Number based type unsigned (only applied if NumberType does not match)
@@ -111,6 +150,14 @@ public:
      */
     void parseString(QString strJson);
 
+    /*!
+      Works exactly like parseString() but takes the JSON as UTF-8 encoded data
+      like it is received from the network.
+
+      \param utf8Json JSON in UTF-8 encoding.
+     */
+    void parseUtf8(const QByteArray &utf8Json);
+
     /*!
       Drops all stored JSON data.
      */
@@ -215,10 +262,41 @@ public:
 	*/
 	QStringList getArray();
 
+	/*!
+	  Returns the JSONs stored in an array. Items of the array that are no JSON are
+	  skipped. The returned JSONs share the data of this JSON, no item is parsed or
+	  copied.
+	*/
+	QList<QDropboxJson> getJsonArray(QString key);
+
+	/*!
+	  Returns the JSONs stored in an anonymous array (see also isAnonymousArray()).
+	*/
+	QList<QDropboxJson> getJsonArray();
+
+	/*!
+	  Returns one element of every array stored in the array mapped to key, e.g. the
+	  paths of the entries of a delta response <code>[["/a", {...}], ...]</code>. Items
+	  that are no array or are too short yield an empty string.
+
+	  \param key key of the array of arrays
+	  \param column index of the element in the inner arrays
+	*/
+	QStringList getArrayColumn(QString key, int column);
+
+	/*!
+	  Works like getArrayColumn() but returns the JSONs stored at the given index of the
+	  inner arrays. Elements that are no JSON yield an invalid QDropboxJson, so the
+	  result lines up with getArrayColumn(). The returned JSONs share the data of this
+	  JSON, no item is parsed or copied.
+	*/
+	QList<QDropboxJson> getJsonArrayColumn(QString key, int column);
+
 	/**!
-	  Overloaded operator to copy a QDropboxJson.
+	  Overloaded operator to copy a QDropboxJson. The data is shared until one of
+	  both JSONs is modified.
 	*/
-    QDropboxJson& operator =(QDropboxJson&);
+    QDropboxJson& operator =(const QDropboxJson&);
 
 	/**!
 	  A JSON may be an anonymous array like this:
@@ -247,13 +325,21 @@ protected:
 		bool valid;
 
 private:
-    QMap<QString, qdropboxjson_entry> valueMap;
+    QExplicitlySharedDataPointer<QDropboxJsonData> d;
+    QDropboxJson       *_owner;
+    qdropboxjson_entry *_node;
+    int                 _capacity;
+    QMap<QString, QDropboxJson*> _subJsons;
 	bool _anonymousArray;
 
+    QDropboxJson(QDropboxJson *owner, qdropboxjson_entry *node);
+
     void emptyList();
-    qdropboxjson_entry_type interpretType(QString value);
-	int parseSubJson(QString str, int start, qdropboxjson_entry *jsonEntry);
 	void _init();
+    void detach();
+    void repointSubJsons();
+    QDropboxJsonArena *arena();
+    void setEntry(QString key, const qdropboxjson_entry &e);
 };
 
 #endif // QDROPBOXJSON_H
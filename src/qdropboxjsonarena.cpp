@@ -0,0 +1,92 @@
+#include <cstring>
+
+#include "qdropboxjsonarena.h"
+
+// largest block size the arena grows to on its own
+const int QDROPBOXJSONARENA_MAX_BLOCK = 1024*1024;
+
+// largest block that is kept by reset(), a single large document must not pin
+// its memory for the lifetime of the arena
+const int QDROPBOXJSONARENA_MAX_KEPT = 64*1024;
+
+QDropboxJsonArena::QDropboxJsonArena(int blockSize) :
+    _pos(NULL),
+    _end(NULL),
+    _blockSize(blockSize),
+    _initialBlockSize(blockSize),
+    _firstBlockSize(0),
+    _used(0)
+{
+}
+
+QDropboxJsonArena::~QDropboxJsonArena()
+{
+    for(int i=0; i<_blocks.size(); ++i)
+        delete [] _blocks.at(i);
+}
+
+void *QDropboxJsonArena::allocate(int size)
+{
+    // keep everything 8 byte aligned for 64 bit values and pointers
+    size = (size + 7) & ~7;
+
+    if(_pos == NULL || _end - _pos < size)
+    {
+        int blockSize = qMax(size, _blockSize);
+        char *block = new char[blockSize];
+        if(_blocks.isEmpty())
+            _firstBlockSize = blockSize;
+        _blocks.append(block);
+        _pos = block;
+        _end = block + blockSize;
+
+        // the next block will be bigger to keep the number of blocks low
+        if(_blockSize < QDROPBOXJSONARENA_MAX_BLOCK)
+            _blockSize *= 2;
+    }
+
+    void *p = _pos;
+    _pos  += size;
+    _used += size;
+    return p;
+}
+
+char *QDropboxJsonArena::copy(const char *data, int size)
+{
+    char *p = static_cast<char*>(allocate(size));
+    memcpy(p, data, size);
+    return p;
+}
+
+void QDropboxJsonArena::reset()
+{
+    _used      = 0;
+    _blockSize = _initialBlockSize;
+    if(_blocks.isEmpty())
+        return;
+
+    bool keepFirst = _firstBlockSize <= QDROPBOXJSONARENA_MAX_KEPT;
+    for(int i=(keepFirst? 1 : 0); i<_blocks.size(); ++i)
+        delete [] _blocks.at(i);
+
+    if(!keepFirst)
+    {
+        _blocks.clear();
+        _pos = NULL;
+        _end = NULL;
+        _firstBlockSize = 0;
+        return;
+    }
+
+    char *first = _blocks.first();
+    _blocks.clear();
+    _blocks.append(first);
+    _pos = first;
+    _end = first + _firstBlockSize;
+    return;
+}
+
+int QDropboxJsonArena::bytesUsed() const
+{
+    return _used;
+}
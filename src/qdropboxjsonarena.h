@@ -0,0 +1,76 @@
+#ifndef QDROPBOXJSONARENA_H
+#define QDROPBOXJSONARENA_H
+
+#include "qtdropbox_global.h"
+
+#include <QList>
+
+//! Bump allocator that owns all nodes and strings of a parsed QDropboxJson
+/*!
+  Memory is handed out from large blocks by moving a pointer forward. Single
+  allocations are never freed, instead the whole arena is dropped at once by
+  reset() or on destruction. This makes releasing a parsed JSON tree independent
+  of the number of values it contains.
+
+  Only plain data without destructors may be stored in the arena.
+ */
+class QDropboxJsonArena
+{
+public:
+    /*!
+      Creates an empty arena. No memory is allocated until the first call of
+      allocate().
+
+      \param blockSize Minimum size of the blocks that are requested from the heap.
+     */
+    QDropboxJsonArena(int blockSize = 4096);
+
+    /*!
+      Frees all blocks of the arena.
+     */
+    ~QDropboxJsonArena();
+
+    /*!
+      Returns a pointer to size bytes of uninitialized memory. The memory stays
+      valid until reset() is called or the arena is destroyed.
+     */
+    void *allocate(int size);
+
+    /*!
+      Allocates an array of count uninitialized elements of type T.
+     */
+    template<typename T> T *allocate(int count)
+    {
+        return static_cast<T*>(allocate(count*int(sizeof(T))));
+    }
+
+    /*!
+      Copies size bytes of data into the arena and returns the copy.
+     */
+    char *copy(const char *data, int size);
+
+    /*!
+      Invalidates all memory that was handed out. The first block is kept so a JSON
+      of similar size can be parsed again without touching the heap, unless it is
+      larger than 64 KiB. Blocks grow from the initial block size again.
+     */
+    void reset();
+
+    /*!
+      Returns the number of bytes that were handed out since the last reset().
+     */
+    int bytesUsed() const;
+
+private:
+    Q_DISABLE_COPY(QDropboxJsonArena)
+
+    QList<char*> _blocks;
+    char *_pos;
+    char *_end;
+    int   _blockSize;
+    int   _initialBlockSize;
+    int   _firstBlockSize;
+    int   _used;
+};
+
+#endif // QDROPBOXJSONARENA_H
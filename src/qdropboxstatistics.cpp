@@ -0,0 +1,102 @@
+#include "qdropboxstatistics.h"
+
+QDropboxHistogram::QDropboxHistogram() :
+    _count(0),
+    _sum(0),
+    _min(0),
+    _max(0)
+{
+}
+
+void QDropboxHistogram::add(qint64 value)
+{
+    if(value < 0)
+        value = 0;
+
+    // the bucket is the number of significant bits of the value
+    int bucket = 0;
+    for(qint64 v = value; v != 0; v >>= 1)
+        ++bucket;
+
+    if(_buckets.size() <= bucket)
+        _buckets.resize(bucket+1);
+    _buckets[bucket]++;
+
+    if(_count == 0 || value < _min)
+        _min = value;
+    if(_count == 0 || value > _max)
+        _max = value;
+    _count++;
+    _sum += value;
+    return;
+}
+
+void QDropboxHistogram::clear()
+{
+    _buckets.clear();
+    _count = 0;
+    _sum   = 0;
+    _min   = 0;
+    _max   = 0;
+    return;
+}
+
+qint64 QDropboxHistogram::count() const
+{
+    return _count;
+}
+
+qint64 QDropboxHistogram::sum() const
+{
+    return _sum;
+}
+
+qint64 QDropboxHistogram::min() const
+{
+    return _min;
+}
+
+qint64 QDropboxHistogram::max() const
+{
+    return _max;
+}
+
+double QDropboxHistogram::mean() const
+{
+    if(_count == 0)
+        return 0;
+    return double(_sum)/_count;
+}
+
+qint64 QDropboxHistogram::percentile(double percentile) const
+{
+    if(_count == 0)
+        return 0;
+
+    // number of values that are at or below the percentile
+    qint64 rank = qint64(percentile/100.0*_count + 0.5);
+    rank = qBound(qint64(1), rank, _count);
+
+    qint64 seen = 0;
+    for(int i=0; i<_buckets.size(); ++i)
+    {
+        seen += _buckets.at(i);
+        if(seen >= rank)
+            return qMin(bucketUpperBound(i), _max);
+    }
+    return _max;
+}
+
+QVector<qint64> QDropboxHistogram::buckets() const
+{
+    return _buckets;
+}
+
+qint64 QDropboxHistogram::bucketUpperBound(int bucket)
+{
+    if(bucket <= 0)
+        return 0;
+    if(bucket >= 63)
+        return Q_INT64_C(0x7FFFFFFFFFFFFFFF);
+    return (qint64(1) << bucket) - 1;
+}
@@ -0,0 +1,107 @@
+#ifndef QDROPBOXSTATISTICS_H
+#define QDROPBOXSTATISTICS_H
+
+#include "qtdropbox_global.h"
+
+#include <QVector>
+#include <QMap>
+
+//! Histogram with exponentially growing buckets
+/*!
+  Bucket 0 counts the value 0, bucket i counts values from 2^(i-1) up to
+  2^i - 1. This keeps the histogram small and its relative resolution constant
+  from microseconds up to hours or from bytes up to gigabytes. Negative values
+  are counted as 0.
+ */
+class QTDROPBOXSHARED_EXPORT QDropboxHistogram
+{
+public:
+    /*!
+      Creates an empty histogram.
+     */
+    QDropboxHistogram();
+
+    /*!
+      Adds a value to the histogram.
+     */
+    void add(qint64 value);
+
+    /*!
+      Removes all values from the histogram.
+     */
+    void clear();
+
+    /*!
+      Returns the number of values added.
+     */
+    qint64 count() const;
+
+    /*!
+      Returns the sum of all values added.
+     */
+    qint64 sum() const;
+
+    /*!
+      Returns the smallest value added or 0 if the histogram is empty.
+     */
+    qint64 min() const;
+
+    /*!
+      Returns the largest value added or 0 if the histogram is empty.
+     */
+    qint64 max() const;
+
+    /*!
+      Returns the mean of all values added or 0 if the histogram is empty.
+     */
+    double mean() const;
+
+    /*!
+      Returns an upper bound of the given percentile. The bound is the upper limit
+      of the bucket the percentile falls into, but never more than max().
+
+      \param percentile percentile between 0 and 100
+     */
+    qint64 percentile(double percentile) const;
+
+    /*!
+      Returns the number of values counted in each bucket. Trailing empty buckets
+      are omitted.
+     */
+    QVector<qint64> buckets() const;
+
+    /*!
+      Returns the largest value counted in the given bucket.
+     */
+    static qint64 bucketUpperBound(int bucket);
+
+private:
+    QVector<qint64> _buckets;
+    qint64 _count;
+    qint64 _sum;
+    qint64 _min;
+    qint64 _max;
+};
+
+//! Measurements of all requests of one operation type (QDROPBOX_REQ_*)
+/*!
+  All times are in microseconds. Times measured on the network have a resolution
+  of one millisecond.
+ */
+struct QDropboxRequestStatistics
+{
+    qint64            errors;           //!< Number of requests answered with an error or not at all
+    QDropboxHistogram queueTime;        //!< Time requests waited for a free connection
+    QDropboxHistogram timeToFirstByte;  //!< Time from sending a request until the answer's headers arrived
+    QDropboxHistogram latency;          //!< Time from starting a request until its answer was received
+    QDropboxHistogram parseTime;        //!< Time spent processing the answers
+    QDropboxHistogram bytesIn;          //!< Size of the answers
+    QDropboxHistogram bytesOut;         //!< Size of the data sent with the requests
+
+    QDropboxRequestStatistics() : errors(0) {}
+};
+
+//! Request statistics by operation type (QDROPBOX_REQ_*)
+typedef QMap<int, QDropboxRequestStatistics> QDropboxRequestStatisticsMap;
+
+#endif // QDROPBOXSTATISTICS_H
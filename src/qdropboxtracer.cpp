@@ -0,0 +1,147 @@
+#include "qdropboxtracer.h"
+
+#include <QCoreApplication>
+#include <QFile>
+#include <QThread>
+
+QDropboxTracer::QDropboxTracer() :
+    _device(NULL),
+    _file(NULL),
+    _firstEvent(true),
+    _lastId(0)
+{
+}
+
+QDropboxTracer::~QDropboxTracer()
+{
+    close();
+}
+
+bool QDropboxTracer::open(QString fileName)
+{
+    close();
+
+    QFile *file = new QFile(fileName);
+    if(!file->open(QIODevice::WriteOnly|QIODevice::Truncate))
+    {
+        delete file;
+        return false;
+    }
+
+    if(!open(file))
+    {
+        delete file;
+        return false;
+    }
+    _file = file;
+    return true;
+}
+
+bool QDropboxTracer::open(QIODevice *device)
+{
+    if(device != _file)
+        close();
+    if(device == NULL || !device->isWritable())
+        return false;
+
+    _device     = device;
+    _firstEvent = true;
+    _clock.start();
+
+    // all events are written from the thread QDropbox lives in
+    _processThread = QByteArray(",\"pid\":") + QByteArray::number(QCoreApplication::applicationPid())
+                   + ",\"tid\":" + QByteArray::number(quint64(quintptr(QThread::currentThreadId())));
+
+    // the JSON array format stays readable even if the trace is not closed
+    _device->write("[\n");
+    return true;
+}
+
+void QDropboxTracer::close()
+{
+    if(_device == NULL)
+        return;
+
+    _device->write("\n]\n");
+    _device = NULL;
+    if(_file != NULL)
+    {
+        _file->close();
+        delete _file;
+        _file = NULL;
+    }
+    return;
+}
+
+bool QDropboxTracer::isOpen() const
+{
+    return (_device != NULL);
+}
+
+qint64 QDropboxTracer::timestamp() const
+{
+    return _clock.nsecsElapsed()/1000;
+}
+
+void QDropboxTracer::complete(const char *name, const char *category, qint64 start, qint64 id)
+{
+    QByteArray extra = ",\"dur\":" + QByteArray::number(timestamp() - start);
+    if(id >= 0)
+        extra += ",\"args\":{\"request\":" + QByteArray::number(id) + "}";
+    writeEvent(name, category, 'X', start, extra);
+    return;
+}
+
+void QDropboxTracer::asyncBegin(const char *name, const char *category, qint64 id)
+{
+    writeEvent(name, category, 'b', timestamp(), ",\"id\":" + QByteArray::number(id));
+    return;
+}
+
+void QDropboxTracer::asyncEnd(const char *name, const char *category, qint64 id)
+{
+    writeEvent(name, category, 'e', timestamp(), ",\"id\":" + QByteArray::number(id));
+    return;
+}
+
+void QDropboxTracer::flow(char phase, const char *category, qint64 id)
+{
+    QByteArray extra = ",\"id\":" + QByteArray::number(id);
+    // the last step binds to the span it is enclosed by
+    if(phase == 'f')
+        extra += ",\"bp\":\"e\"";
+    writeEvent("request", category, phase, timestamp(), extra);
+    return;
+}
+
+qint64 QDropboxTracer::nextId()
+{
+    return ++_lastId;
+}
+
+void QDropboxTracer::writeEvent(const char *name, const char *category, char phase, qint64 ts,
+                                const QByteArray &extra)
+{
+    if(_device == NULL)
+        return;
+
+    QByteArray event;
+    event.reserve(160);
+    if(!_firstEvent)
+        event += ",\n";
+    _firstEvent = false;
+
+    event += "{\"name\":\"";
+    event += name;
+    event += "\",\"cat\":\"";
+    event += category;
+    event += "\",\"ph\":\"";
+    event += phase;
+    event += "\",\"ts\":";
+    event += QByteArray::number(ts);
+    event += _processThread;
+    event += extra;
+    event += "}";
+    _device->write(event);
+    return;
+}
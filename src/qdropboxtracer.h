@@ -0,0 +1,157 @@
+#ifndef QDROPBOXTRACER_H
+#define QDROPBOXTRACER_H
+
+#include "qtdropbox_global.h"
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QIODevice>
+#include <QString>
+
+class QFile;
+
+//! Writes the lifecycle of requests as trace events
+/*!
+  QDropboxTracer writes the spans of QDropbox and QDropboxFile requests (sign, send,
+  queue, network, parse, emit and blocking waits) in the trace event JSON format that
+  is understood by chrome://tracing and Perfetto. Request numbers are used as flow
+  IDs, so the steps of a single request are connected in the timeline while
+  overlapping requests, nested blocking event loops and redirects stay visible.
+
+  Tracing is enabled by passing an open tracer to QDropbox::setTracer(). Without a
+  tracer every trace point reduces to a null pointer check.
+
+  \code
+  QDropboxTracer tracer;
+  tracer.open("qtdropbox.trace.json");
+  dropbox.setTracer(&tracer);
+  \endcode
+ */
+class QTDROPBOXSHARED_EXPORT QDropboxTracer
+{
+public:
+    /*!
+      Creates a closed tracer.
+     */
+    QDropboxTracer();
+
+    /*!
+      Closes the tracer.
+     */
+    ~QDropboxTracer();
+
+    /*!
+      Starts writing trace events to the given file. An open trace is closed first.
+      \param fileName File the events are written to. Existing files are overwritten.
+      \return false if the file could not be opened
+     */
+    bool open(QString fileName);
+
+    /*!
+      Starts writing trace events to the given device. The device must be open for
+      writing and is not closed or deleted by the tracer.
+      \param device Device the events are written to
+      \return false if the device is not writable
+     */
+    bool open(QIODevice *device);
+
+    /*!
+      Finishes the trace. Events are dropped until the tracer is opened again.
+     */
+    void close();
+
+    /*!
+      Returns true if trace events are written.
+     */
+    bool isOpen() const;
+
+    /*!
+      Returns the time in microseconds since the trace was opened.
+     */
+    qint64 timestamp() const;
+
+    /*!
+      This function is for internal QtDropbox API use. It writes a span that started at
+      the given time and ends now.
+      \param name Name of the span
+      \param category Category of the span (class that wrote it)
+      \param start Start of the span as returned by timestamp()
+      \param id Number of the request the span belongs to or -1
+     */
+    void complete(const char *name, const char *category, qint64 start, qint64 id = -1);
+
+    /*!
+      This function is for internal QtDropbox API use. It starts a span that may overlap
+      other spans, like the time a request spends on the network.
+     */
+    void asyncBegin(const char *name, const char *category, qint64 id);
+
+    /*!
+      This function is for internal QtDropbox API use. It ends a span started with asyncBegin().
+     */
+    void asyncEnd(const char *name, const char *category, qint64 id);
+
+    /*!
+      This function is for internal QtDropbox API use. It writes a flow event that connects
+      the spans of a request. The event is bound to the span enclosing it.
+      \param phase 's' for the first, 't' for intermediate and 'f' for the last step
+      \param category Category of the flow
+      \param id Number of the request
+     */
+    void flow(char phase, const char *category, qint64 id);
+
+    /*!
+      This function is for internal QtDropbox API use. It returns a new ID for requests
+      that do not have a request number.
+     */
+    qint64 nextId();
+
+private:
+    Q_DISABLE_COPY(QDropboxTracer)
+
+    void writeEvent(const char *name, const char *category, char phase, qint64 ts,
+                    const QByteArray &extra);
+
+    QIODevice    *_device;
+    QFile        *_file;
+    QElapsedTimer _clock;
+    bool          _firstEvent;
+    qint64        _lastId;
+    QByteArray    _processThread;
+};
+
+//! Writes a span from its construction to its destruction if a tracer is set
+class QDropboxTraceSpan
+{
+public:
+    QDropboxTraceSpan(QDropboxTracer *tracer, const char *name, const char *category, qint64 id = -1) :
+        _tracer((tracer != NULL && tracer->isOpen())? tracer : NULL),
+        _name(name),
+        _category(category),
+        _id(id),
+        _start(0)
+    {
+        if(_tracer != NULL)
+            _start = _tracer->timestamp();
+    }
+
+    ~QDropboxTraceSpan()
+    {
+        if(_tracer != NULL)
+            _tracer->complete(_name, _category, _start, _id);
+    }
+
+    //! Sets the request number if it is only known after the span started
+    void setId(qint64 id) { _id = id; }
+
+private:
+    Q_DISABLE_COPY(QDropboxTraceSpan)
+
+    QDropboxTracer *_tracer;
+    const char     *_name;
+    const char     *_category;
+    qint64          _id;
+    qint64          _start;
+};
+
+#endif // QDROPBOXTRACER_H
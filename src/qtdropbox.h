@@ -7,5 +7,7 @@
 #include "qdropboxfile.h"
 #include "qdropboxfileinfo.h"
 #include "qdropboxdeltaresponse.h"
+#include "qdropboxstatistics.h"
+#include "qdropboxtracer.h"
 
 #endif // QTDROPBOX_H
@@ -9,6 +9,11 @@
 #  define QTDROPBOXSHARED_EXPORT Q_DECL_IMPORT
 #endif
 
+#ifndef QDROPBOX_HTTP_NOT_MODIFIED
+#define QDROPBOX_HTTP_NOT_MODIFIED
+const qint32 QDROPBOX_NOT_MODIFIED              = 304;
+#endif
+
 #ifndef QDROPBOX_HTTP_ERROR_CODES
 #define QDROPBOX_HTTP_ERROR_CODES
 const qint32 QDROPBOX_ERROR_BAD_INPUT           = 400;
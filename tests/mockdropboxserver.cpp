@@ -0,0 +1,519 @@
+#include "mockdropboxserver.h"
+
+#include <QCryptographicHash>
+#include <QPointer>
+#include <QTimer>
+
+// answers are sent in slices every SEND_INTERVAL ms if the bandwidth is limited
+static const int SEND_INTERVAL = 10;
+
+static const char *MOCK_DATE = "Sat, 21 Aug 2010 22:31:20 +0000";
+
+MockDropboxServer::MockDropboxServer(QObject *parent) :
+    QTcpServer(parent),
+    _requestCount(0),
+    _latency(0),
+    _bandwidth(0),
+    _errorStatus(0),
+    _errorCount(0),
+    _errorRateStatus(0),
+    _errorRate(0),
+    _retryAfter(-1),
+    _disconnectAfter(-1),
+    _lostChunkAnswers(0),
+    _listingSize(10),
+    _deltaPageSize(10),
+    _deltaPages(1),
+    _revisionCount(10),
+    _fileSize(1024),
+    _random(4711) // fixed seed so random errors are reproducible
+{
+    connect(this, &QTcpServer::newConnection, this, &MockDropboxServer::acceptConnections);
+}
+
+bool MockDropboxServer::start(quint16 port)
+{
+    return listen(QHostAddress::LocalHost, port);
+}
+
+QString MockDropboxServer::url() const
+{
+    return QString("http://127.0.0.1:%1").arg(serverPort());
+}
+
+void MockDropboxServer::setLatency(int msecs)
+{
+    _latency = qMax(0, msecs);
+    return;
+}
+
+void MockDropboxServer::setBandwidth(qint64 bytesPerSecond)
+{
+    _bandwidth = qMax(qint64(0), bytesPerSecond);
+    return;
+}
+
+void MockDropboxServer::injectError(int status, int count)
+{
+    _errorStatus = status;
+    _errorCount  = count;
+    return;
+}
+
+void MockDropboxServer::setErrorRate(int status, double probability)
+{
+    _errorRateStatus = status;
+    _errorRate       = probability;
+    return;
+}
+
+void MockDropboxServer::setRetryAfter(int seconds)
+{
+    _retryAfter = seconds;
+    return;
+}
+
+void MockDropboxServer::setDisconnectAfter(qint64 bytes)
+{
+    _disconnectAfter = bytes;
+    return;
+}
+
+void MockDropboxServer::loseChunkAnswers(int count)
+{
+    _lostChunkAnswers = qMax(0, count);
+    return;
+}
+
+void MockDropboxServer::setListingSize(int entries)
+{
+    _listingSize = qMax(0, entries);
+    return;
+}
+
+void MockDropboxServer::setDeltaSize(int entriesPerPage, int pages)
+{
+    _deltaPageSize = qMax(0, entriesPerPage);
+    _deltaPages    = qMax(1, pages);
+    return;
+}
+
+void MockDropboxServer::setRevisionCount(int revisions)
+{
+    _revisionCount = qMax(0, revisions);
+    return;
+}
+
+void MockDropboxServer::setFileSize(qint64 bytes)
+{
+    _fileSize = qMax(qint64(0), bytes);
+    return;
+}
+
+void MockDropboxServer::setFile(QString path, QByteArray content)
+{
+    _files[path] = content;
+    return;
+}
+
+QByteArray MockDropboxServer::file(QString path) const
+{
+    return _files.value(path);
+}
+
+int MockDropboxServer::requestCount() const
+{
+    return _requestCount;
+}
+
+int MockDropboxServer::requestCount(QString endpoint) const
+{
+    return _requestCounts.value(endpoint);
+}
+
+void MockDropboxServer::acceptConnections()
+{
+    while(hasPendingConnections())
+    {
+        QTcpSocket *socket = nextPendingConnection();
+        _buffers.insert(socket, QByteArray());
+        connect(socket, &QTcpSocket::readyRead, this, &MockDropboxServer::readRequests);
+        connect(socket, &QTcpSocket::disconnected, this, &MockDropboxServer::socketDisconnected);
+    }
+    return;
+}
+
+void MockDropboxServer::socketDisconnected()
+{
+    QTcpSocket *socket = qobject_cast<QTcpSocket*>(sender());
+    if(socket == NULL)
+        return;
+
+    _buffers.remove(socket);
+    socket->deleteLater();
+    return;
+}
+
+void MockDropboxServer::readRequests()
+{
+    QTcpSocket *socket = qobject_cast<QTcpSocket*>(sender());
+    if(socket == NULL)
+        return;
+
+    QByteArray &buffer = _buffers[socket];
+    buffer.append(socket->readAll());
+
+    // connections are kept alive, so a buffer may hold several requests
+    Request request;
+    while(parseRequest(buffer, &request))
+        handleRequest(socket, request);
+    return;
+}
+
+bool MockDropboxServer::parseRequest(QByteArray &buffer, Request *request)
+{
+    int headerEnd = buffer.indexOf("\r\n\r\n");
+    if(headerEnd < 0)
+        return false;
+
+    QList<QByteArray> lines = buffer.left(headerEnd).split('\n');
+    QMap<QByteArray,QByteArray> headers;
+    for(int i=1; i<lines.size(); ++i)
+    {
+        int colon = lines.at(i).indexOf(':');
+        if(colon > 0)
+            headers.insert(lines.at(i).left(colon).trimmed().toLower(),
+                           lines.at(i).mid(colon+1).trimmed());
+    }
+
+    qint64 bodySize = headers.value("content-length", "0").toLongLong();
+    if(buffer.size() < headerEnd + 4 + bodySize)
+        return false; // wait for the rest of the body
+
+    // request line: <method> /<version>/<endpoint>/<path>?<query> HTTP/1.1
+    QList<QByteArray> requestLine = lines.at(0).trimmed().split(' ');
+    QUrl url(QString::fromLatin1(requestLine.value(1)));
+
+    QString target = url.path(QUrl::FullyDecoded).section('/', 2);
+    QString endpoint = target.section('/', 0, 0);
+    if(!endpoint.compare("oauth") || !endpoint.compare("account"))
+        endpoint = target.section('/', 0, 1);
+
+    request->method   = requestLine.value(0);
+    request->endpoint = endpoint;
+    request->path     = target.mid(endpoint.size()+1);
+    request->query    = QUrlQuery(url);
+    request->headers  = headers;
+    request->body     = buffer.mid(headerEnd + 4, bodySize);
+
+    // parameters of form posts (e.g. the cursor of delta) are read like query items
+    if(headers.value("content-type").startsWith("application/x-www-form-urlencoded"))
+    {
+        QList<QPair<QString,QString> > items = QUrlQuery(QString::fromUtf8(request->body)).queryItems();
+        for(int i=0; i<items.size(); ++i)
+            request->query.addQueryItem(items.at(i).first, items.at(i).second);
+    }
+
+    buffer.remove(0, headerEnd + 4 + bodySize);
+    return true;
+}
+
+void MockDropboxServer::handleRequest(QTcpSocket *socket, const Request &request)
+{
+    _requestCount++;
+    _requestCounts[request.endpoint]++;
+
+    Response response;
+    if(_errorCount > 0)
+    {
+        _errorCount--;
+        response = error(_errorStatus);
+    }
+    else if(_errorRate > 0 &&
+            std::uniform_real_distribution<double>(0, 1)(_random) < _errorRate)
+        response = error(_errorRateStatus);
+    else
+        response = answer(request);
+
+    QByteArray data = QString("HTTP/1.1 %1 Mock\r\n").arg(response.status).toLatin1();
+    data += "Content-Type: " + response.contentType + "\r\n";
+    data += "Content-Length: " + QByteArray::number(response.body.size()) + "\r\n";
+    data += "Connection: keep-alive\r\n";
+    for(int i=0; i<response.headers.size(); ++i)
+        data += response.headers.at(i).first + ": " + response.headers.at(i).second + "\r\n";
+    data += "\r\n";
+
+    // the connection is closed before the body is complete
+    bool disconnect = !request.endpoint.compare("files") && response.status < 300 &&
+                      _disconnectAfter >= 0 && _disconnectAfter < response.body.size();
+    data += disconnect? response.body.left(int(_disconnectAfter)) : response.body;
+
+    if(_latency == 0)
+    {
+        send(socket, data, 0, disconnect);
+        return;
+    }
+
+    QPointer<QTcpSocket> target(socket);
+    QTimer::singleShot(_latency, this, [this, target, data, disconnect]{
+        if(!target.isNull())
+            send(target, data, 0, disconnect);
+    });
+    return;
+}
+
+void MockDropboxServer::send(QTcpSocket *socket, QByteArray data, qint64 offset, bool disconnect)
+{
+    qint64 slice = data.size() - offset;
+    if(_bandwidth > 0)
+        slice = qMin(slice, qMax(qint64(1), _bandwidth*SEND_INTERVAL/1000));
+    socket->write(data.constData() + offset, slice);
+    offset += slice;
+    if(offset >= data.size())
+    {
+        // pending data is still written before the connection is closed
+        if(disconnect)
+            socket->disconnectFromHost();
+        return;
+    }
+
+    QPointer<QTcpSocket> target(socket);
+    QTimer::singleShot(SEND_INTERVAL, this, [this, target, data, offset, disconnect]{
+        if(!target.isNull())
+            send(target, data, offset, disconnect);
+    });
+    return;
+}
+
+MockDropboxServer::Response MockDropboxServer::answer(const Request &request)
+{
+    const QString &endpoint = request.endpoint;
+
+    if(!endpoint.compare("oauth/request_token"))
+    {
+        Response response = json("oauth_token_secret=mockrequestsecret&oauth_token=mockrequesttoken");
+        response.contentType = "text/plain";
+        return response;
+    }
+
+    if(!endpoint.compare("oauth/access_token"))
+    {
+        Response response = json("oauth_token_secret=mockaccesssecret&oauth_token=mockaccesstoken&uid=12345678");
+        response.contentType = "text/plain";
+        return response;
+    }
+
+    if(!endpoint.compare("account/info"))
+        return json("{\"referral_link\": \"https://www.dropbox.com/referrals/mock\", "
+                    "\"display_name\": \"Mock User\", \"uid\": 12345678, \"country\": \"DE\", "
+                    "\"quota_info\": {\"shared\": 0, \"quota\": 2147483648, \"normal\": 1024}, "
+                    "\"email\": \"mock@example.com\"}");
+
+    if(!endpoint.compare("metadata"))
+    {
+        if(_files.contains(request.path))
+            return json(metadataJson(request.path, false, _files.value(request.path).size()));
+
+        if(!request.query.queryItemValue("hash").compare(QString(directoryHash())))
+        {
+            Response response = json(QByteArray(), 304);
+            response.contentType = "text/plain";
+            return response;
+        }
+
+        QByteArray body = metadataJson(request.path, true, 0);
+        body.chop(1);
+        body += ", \"hash\": \"" + directoryHash() + "\", \"contents\": [";
+        for(int i=0; i<_listingSize; ++i)
+        {
+            if(i > 0)
+                body += ", ";
+            body += metadataJson(QString("%1/file%2.txt").arg(request.path).arg(i), false, _fileSize);
+        }
+        body += "]}";
+        return json(body);
+    }
+
+    if(!endpoint.compare("files"))
+    {
+        QByteArray content;
+        if(_files.contains(request.path))
+            content = _files.value(request.path);
+        else
+        {
+            content.resize(_fileSize);
+            for(qint64 i=0; i<_fileSize; ++i)
+                content[int(i)] = char('a' + i%26);
+        }
+
+        Response response = json(content);
+        response.contentType = "application/octet-stream";
+
+        // Range: bytes=<first>-<last>
+        QByteArray range = request.headers.value("range");
+        if(range.startsWith("bytes="))
+        {
+            qint64 first = range.mid(6).split('-').value(0).toLongLong();
+            QByteArray lastStr = range.mid(6).split('-').value(1);
+            qint64 last = lastStr.isEmpty()? content.size()-1 : lastStr.toLongLong();
+            last = qMin(last, qint64(content.size())-1);
+
+            if(first >= content.size() || first > last)
+            {
+                response = error(416);
+                response.headers.append(qMakePair(QByteArray("Content-Range"),
+                                        "bytes */" + QByteArray::number(content.size())));
+                return response;
+            }
+
+            response.status = 206;
+            response.body   = content.mid(first, last-first+1);
+            response.headers.append(qMakePair(QByteArray("Content-Range"),
+                                    QString("bytes %1-%2/%3").arg(first).arg(last)
+                                    .arg(content.size()).toLatin1()));
+        }
+        return response;
+    }
+
+    if(!endpoint.compare("files_put"))
+    {
+        _files[request.path] = request.body;
+        return json(metadataJson(request.path, false, request.body.size()));
+    }
+
+    if(!endpoint.compare("chunked_upload"))
+    {
+        QString uploadId = request.query.queryItemValue("upload_id");
+        if(uploadId.isEmpty())
+            uploadId = QString("mockupload%1").arg(_uploads.size()+1);
+
+        QByteArray &upload = _uploads[uploadId];
+        qint64 offset = request.query.queryItemValue("offset").toLongLong();
+        if(offset != upload.size())
+            return json(QString("{\"upload_id\": \"%1\", \"offset\": %2}")
+                        .arg(uploadId).arg(upload.size()).toLatin1(), 400);
+
+        upload.append(request.body);
+        if(_lostChunkAnswers > 0)
+        {
+            _lostChunkAnswers--;
+            return error(500);
+        }
+        return json(QString("{\"upload_id\": \"%1\", \"offset\": %2}")
+                    .arg(uploadId).arg(upload.size()).toLatin1());
+    }
+
+    if(!endpoint.compare("commit_chunked_upload"))
+    {
+        QString uploadId = request.query.queryItemValue("upload_id");
+        if(!_uploads.contains(uploadId))
+            return error(400);
+
+        _files[request.path] = _uploads.take(uploadId);
+        return json(metadataJson(request.path, false, _files.value(request.path).size()));
+    }
+
+    if(!endpoint.compare("revisions"))
+    {
+        qint64 bytes = _files.contains(request.path)? _files.value(request.path).size() : _fileSize;
+        QByteArray body = "[";
+        for(int i=_revisionCount; i>0; --i)
+        {
+            if(i < _revisionCount)
+                body += ", ";
+            body += metadataJson(request.path, false, bytes, i);
+        }
+        body += "]";
+        return json(body);
+    }
+
+    if(!endpoint.compare("shares"))
+        return json(QString("{\"url\": \"http://db.tt/mock%1\", \"expires\": \"Tue, 01 Jan 2030 00:00:00 +0000\"}")
+                    .arg(qHash(request.path)).toLatin1());
+
+    if(!endpoint.compare("delta"))
+    {
+        // the cursor is the number of the next page
+        QString cursor = request.query.queryItemValue("cursor");
+        int page = cursor.isEmpty()? 0 : cursor.mid(4).toInt();
+
+        QByteArray body = "{\"entries\": [";
+        for(int i=0; i<_deltaPageSize; ++i)
+        {
+            QString path = QString("/delta/page%1/file%2.txt").arg(page).arg(i);
+            if(i > 0)
+                body += ", ";
+            body += "[\"" + path.toLower().toUtf8() + "\", " + metadataJson(path, false, _fileSize) + "]";
+        }
+        body += "], \"reset\": ";
+        body += cursor.isEmpty()? "true" : "false";
+        body += ", \"cursor\": \"page" + QByteArray::number(page+1) + "\", \"has_more\": ";
+        body += (page+1 < _deltaPages)? "true" : "false";
+        body += "}";
+        return json(body);
+    }
+
+    return error(404);
+}
+
+MockDropboxServer::Response MockDropboxServer::json(QByteArray body, int status)
+{
+    Response response;
+    response.status      = status;
+    response.contentType = "application/json";
+    response.body        = body;
+    return response;
+}
+
+MockDropboxServer::Response MockDropboxServer::error(int status)
+{
+    QByteArray message;
+    switch(status)
+    {
+    case 401:
+        message = "Invalid or expired token.";
+        break;
+    case 503:
+        message = "Too many requests.";
+        break;
+    case 507:
+        message = "User is over Dropbox storage quota.";
+        break;
+    default:
+        message = "Mock error.";
+        break;
+    }
+
+    Response response = json("{\"error\": \"" + message + "\"}", status);
+    if(status == 503 && _retryAfter >= 0)
+        response.headers.append(qMakePair(QByteArray("Retry-After"), QByteArray::number(_retryAfter)));
+    return response;
+}
+
+QByteArray MockDropboxServer::metadataJson(QString path, bool isDir, qint64 bytes, int revision)
+{
+    QString root = path.section('/', 0, 0);
+    QString filePath = path.startsWith('/')? path : "/" + path.section('/', 1);
+
+    QString json = QString("{\"size\": \"%1 bytes\", \"rev\": \"%2\", \"thumb_exists\": false, "
+                           "\"bytes\": %1, \"modified\": \"%3\", \"client_mtime\": \"%3\", "
+                           "\"path\": \"%4\", \"is_dir\": %5, \"icon\": \"%6\", \"root\": \"%7\", "
+                           "\"mime_type\": \"%8\", \"revision\": %9}")
+            .arg(bytes)
+            .arg(QString("%1mock").arg(revision, 0, 16))
+            .arg(MOCK_DATE)
+            .arg(filePath)
+            .arg(isDir? "true" : "false")
+            .arg(isDir? "folder" : "page_white_text")
+            .arg(root.isEmpty() || path.startsWith('/')? "dropbox" : root)
+            .arg(isDir? "" : "text/plain")
+            .arg(revision);
+    return json.toUtf8();
+}
+
+QByteArray MockDropboxServer::directoryHash() const
+{
+    // the listing only changes with its configuration
+    QByteArray state = QByteArray::number(_listingSize) + ":" + QByteArray::number(_fileSize);
+    return QCryptographicHash::hash(state, QCryptographicHash::Md5).toHex();
+}
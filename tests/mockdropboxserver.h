@@ -0,0 +1,185 @@
+#ifndef MOCKDROPBOXSERVER_H
+#define MOCKDROPBOXSERVER_H
+
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QHash>
+#include <QMap>
+#include <QUrlQuery>
+
+#include <random>
+
+//! Local stand-in for the Dropbox REST API (version 1)
+/*!
+  MockDropboxServer answers the requests of QDropbox and QDropboxFile over plain HTTP
+  on the loopback interface, so network related code can be tested and benchmarked
+  without keys, an account or network access. Point QDropbox::setApiUrl() and
+  QDropbox::setContentUrl() at url() to use it.
+
+  Implemented are oauth/request_token, oauth/access_token, account/info, metadata,
+  files (with byte ranges), files_put, revisions, shares and delta. Files written with
+  files_put are kept in memory, all other content is generated in the configured sizes.
+
+  Latency, bandwidth and errors can be injected to simulate slow or throttling servers.
+ */
+class MockDropboxServer : public QTcpServer
+{
+    Q_OBJECT
+
+public:
+    explicit MockDropboxServer(QObject *parent = 0);
+
+    /*!
+      Starts listening on the loopback interface.
+      \param port Port to listen on, 0 picks a free port
+     */
+    bool start(quint16 port = 0);
+
+    /*!
+      Returns the URL of the server, e.g. <em>http://127.0.0.1:4711</em>.
+     */
+    QString url() const;
+
+    /*!
+      Delays every answer by the given time.
+     */
+    void setLatency(int msecs);
+
+    /*!
+      Limits the speed answers are sent with. 0 (default) sends as fast as possible.
+     */
+    void setBandwidth(qint64 bytesPerSecond);
+
+    /*!
+      Answers the next requests with the given HTTP status (e.g. 401, 503 or 507).
+      \param status HTTP status to answer with
+      \param count Number of requests that fail
+     */
+    void injectError(int status, int count = 1);
+
+    /*!
+      Answers requests randomly with the given HTTP status.
+      \param status HTTP status to answer with
+      \param probability Probability of an error between 0 and 1
+     */
+    void setErrorRate(int status, double probability);
+
+    /*!
+      Sets the Retry-After header sent with 503 answers. Negative values (default) omit it.
+     */
+    void setRetryAfter(int seconds);
+
+    /*!
+      Closes the connection after the given number of bytes of a file were sent by
+      files, like a server that breaks off a download. Negative values (default) send
+      complete files.
+     */
+    void setDisconnectAfter(qint64 bytes);
+
+    /*!
+      Stores the next chunks sent to chunked_upload but answers them with 500, as if
+      the answers were lost on their way to the client.
+      \param count Number of chunks whose answer is lost
+     */
+    void loseChunkAnswers(int count = 1);
+
+    /*!
+      Sets the number of entries of directory listings returned by metadata.
+     */
+    void setListingSize(int entries);
+
+    /*!
+      Sets the number of entries per delta page and the number of pages.
+     */
+    void setDeltaSize(int entriesPerPage, int pages = 1);
+
+    /*!
+      Sets the number of revisions returned by revisions.
+     */
+    void setRevisionCount(int revisions);
+
+    /*!
+      Sets the size of the generated content of files that were not written before.
+     */
+    void setFileSize(qint64 bytes);
+
+    /*!
+      Stores a file that is returned by files and metadata.
+      \param path Path of the file including the root, e.g. <em>dropbox/test.txt</em>
+     */
+    void setFile(QString path, QByteArray content);
+
+    /*!
+      Returns the content of a file written with files_put or setFile().
+     */
+    QByteArray file(QString path) const;
+
+    /*!
+      Returns the number of requests received.
+     */
+    int requestCount() const;
+
+    /*!
+      Returns the number of requests received for the given endpoint (e.g. <em>metadata</em>).
+     */
+    int requestCount(QString endpoint) const;
+
+private slots:
+    void acceptConnections();
+    void readRequests();
+    void socketDisconnected();
+
+private:
+    struct Request
+    {
+        QByteArray method;
+        QString    endpoint;
+        QString    path;
+        QUrlQuery  query;
+        QMap<QByteArray,QByteArray> headers;
+        QByteArray body;
+    };
+
+    struct Response
+    {
+        int        status;
+        QByteArray contentType;
+        QByteArray body;
+        QList<QPair<QByteArray,QByteArray> > headers;
+    };
+
+    bool    parseRequest(QByteArray &buffer, Request *request);
+    void    handleRequest(QTcpSocket *socket, const Request &request);
+    Response answer(const Request &request);
+    void    send(QTcpSocket *socket, QByteArray data, qint64 offset, bool disconnect = false);
+
+    Response json(QByteArray body, int status = 200);
+    Response error(int status);
+    QByteArray metadataJson(QString path, bool isDir, qint64 bytes, int revision = 1);
+    QByteArray directoryHash() const;
+
+    QHash<QTcpSocket*,QByteArray> _buffers;
+    QMap<QString,QByteArray>      _files;
+    QMap<QString,QByteArray>      _uploads;
+    QMap<QString,int>             _requestCounts;
+    int     _requestCount;
+
+    int     _latency;
+    qint64  _bandwidth;
+    int     _errorStatus;
+    int     _errorCount;
+    int     _errorRateStatus;
+    double  _errorRate;
+    int     _retryAfter;
+    qint64  _disconnectAfter;
+    int     _lostChunkAnswers;
+    int     _listingSize;
+    int     _deltaPageSize;
+    int     _deltaPages;
+    int     _revisionCount;
+    qint64  _fileSize;
+
+    std::minstd_rand _random;
+};
+
+#endif // MOCKDROPBOXSERVER_H
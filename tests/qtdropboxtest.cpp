@@ -187,7 +187,7 @@ void QtDropboxTest::jsonCase13()
     QVERIFY2(json.getBool("testBool"), "setBool of json is incorrect");
 
     json.setString("testString", "10");
-    QVERIFY2(json.getString("testString").compare("10"), "setString of json is incorrect");
+    QVERIFY2(json.getString("testString").compare("10") == 0, "setString of json is incorrect");
 
     QDateTime time = QDateTime::currentDateTime();
     json.setTimestamp("testTimestamp", time);
@@ -217,6 +217,133 @@ void QtDropboxTest::jsonCase15()
 	     QString("curly brackets in string not parsed correctly [%1]").arg(json.getString("string")).toStdString().c_str());
 }
 
+/**
+ * @brief QDropboxJson: nested structures
+ * Verify that sub JSONs and arrays nested in each other are parsed in one go and
+ * are accessible through the getters.
+ */
+void QtDropboxTest::jsonCase16()
+{
+    QDropboxJson json("{\"outer\": {\"inner\": {\"int\": 42}}, "
+                      "\"array\": [[1, 2], {\"key\": \"a \\\"quoted\\\" value\"}, \"x,y\"]}");
+    QVERIFY2(json.isValid(), "json validity");
+
+    QDropboxJson* outer = json.getJson("outer");
+    QVERIFY2(outer != NULL, "outer subjson is null");
+    QDropboxJson* inner = outer->getJson("inner");
+    QVERIFY2(inner != NULL, "inner subjson is null");
+    QVERIFY2(inner->getInt("int") == 42, "value of nested json does not match");
+
+    QStringList l = json.getArray("array");
+    QVERIFY2(l.size() == 3, "array list has wrong size");
+    QVERIFY2(QDropboxJson(QString("{\"a\": %1}").arg(l.at(0))).getArray("a").size() == 2,
+             "nested array not correctly formatted");
+    QVERIFY2(QDropboxJson(l.at(1)).isValid(), "json in array not correctly formatted");
+    QVERIFY2(l.at(2).compare("x,y") == 0, "string with comma in array not correctly formatted");
+}
+
+/**
+ * @brief QDropboxJson: whitespace and anonymous arrays
+ * Verify that formatted JSON is accepted, that anonymous arrays are detected and that
+ * trailing data invalidates a JSON.
+ */
+void QtDropboxTest::jsonCase17()
+{
+    QDropboxJson json("\n{\n\t\"int\" : 1 ,\r\n\t\"bool\": false\n}\n");
+    QVERIFY2(json.isValid(), "formatted json validity");
+    QVERIFY2(json.getInt("int") == 1, "integer value does not match");
+    QVERIFY2(json.type("bool") == QDropboxJson::BoolType, "boolean type does not match");
+
+    QDropboxJson array("[\"a\", \"b\"]");
+    QVERIFY2(array.isValid(), "anonymous array validity");
+    QVERIFY2(array.isAnonymousArray(), "anonymous array not detected");
+    QVERIFY2(array.getArray().size() == 2, "anonymous array has wrong size");
+
+    QDropboxJson trailing("{\"int\": 1} }");
+    QVERIFY2(!trailing.isValid(), "injson with trailing data validity not confirmed");
+}
+
+/**
+ * @brief QDropboxJson: typed values
+ * Verify that values keep their type, that 64 bit numbers are not truncated and that
+ * escaped strings survive a round trip through strContent().
+ */
+void QtDropboxTest::jsonCase18()
+{
+    QDropboxJson json("{\"big\": 8589934592, \"neg\": -8589934592, \"null\": null, "
+                      "\"esc\": \"line\\nbreak \\\"q\\\" \\u00e4\"}");
+    QVERIFY2(json.isValid(), "json validity");
+    QVERIFY2(json.type("big") == QDropboxJson::UnsignedIntType, "big number type does not match");
+    QVERIFY2(json.getUInt("big") == Q_UINT64_C(8589934592), "big number value does not match");
+    QVERIFY2(json.getInt("neg") == Q_INT64_C(-8589934592), "negative number value does not match");
+    QVERIFY2(json.type("null") == QDropboxJson::UnknownType, "null type does not match");
+    QVERIFY2(json.getString("esc") == QString::fromUtf8("line\nbreak \"q\" \xc3\xa4"),
+             "escaped string not decoded");
+
+    QDropboxJson copy(json.strContent());
+    QVERIFY2(copy.isValid(), "json content validity");
+    QVERIFY2(json.compare(copy) == 0, "typed values changed in strContent()");
+
+    json.setDouble("double", 10.0);
+    QVERIFY2(QDropboxJson(json.strContent()).type("double") == QDropboxJson::FloatType,
+             "double without fraction not kept as double");
+}
+
+/**
+ * @brief QDropboxJson: sub JSONs and setters
+ * Verify that sub JSONs stay usable while keys are added to their parent and that
+ * a JSON can be parsed again after it was modified.
+ */
+void QtDropboxTest::jsonCase19()
+{
+    QDropboxJson json("{\"sub\": {\"int\": 1}}");
+    QDropboxJson* sub = json.getJson("sub");
+    QVERIFY2(sub != NULL, "subjson is null");
+    QVERIFY2(json.getJson("sub") == sub, "subjson not reused");
+
+    for(int i=0; i<32; ++i)
+        json.setInt(QString("key%1").arg(i), i);
+    sub->setString("string", "abcd");
+
+    QVERIFY2(json.getInt("key17") == 17, "added value does not match");
+    QVERIFY2(sub->getInt("int") == 1, "subjson lost its value");
+    QVERIFY2(QDropboxJson(json.strContent()).getJson("sub")->getString("string").compare("abcd") == 0,
+             "value set on subjson missing in parent");
+
+    json.parseString("{\"int\": 2}");
+    QVERIFY2(json.isValid(), "json validity after reparse");
+    QVERIFY2(!json.hasKey("sub"), "old data not cleared");
+    QVERIFY2(json.getInt("int") == 2, "value after reparse does not match");
+}
+
+/**
+ * @brief QDropboxJson: implicit sharing
+ * Verify that copies of a JSON are independent once one of them is modified and that
+ * JSONs returned by getJsonArray() outlive the JSON they were taken from.
+ */
+void QtDropboxTest::jsonCase20()
+{
+    QDropboxJson json("{\"int\": 1, \"sub\": {\"int\": 2}, \"array\": [{\"path\": \"/a\"}, 3, {\"path\": \"/b\"}]}");
+    QDropboxJson copy(json);
+    QVERIFY2(copy.compare(json) == 0, "copy does not match");
+
+    copy.setInt("int", 5);
+    json.getJson("sub")->setInt("int", 7);
+    QVERIFY2(json.getInt("int") == 1, "modifying a copy changed the original");
+    QVERIFY2(copy.getJson("sub")->getInt("int") == 2, "modifying a sub json changed the copy");
+
+    QList<QDropboxJson> items = json.getJsonArray("array");
+    QVERIFY2(items.size() == 2, "json array has wrong size");
+    json.parseString("{}");
+    QDropboxJson item = items.at(1);
+    QVERIFY2(item.getString("path").compare("/b") == 0, "array item lost its value");
+
+    QDropboxFileInfo dir("{\"is_dir\": true, \"path\": \"/\", \"contents\": [{\"path\": \"/a\", \"is_dir\": false}]}");
+    QDropboxFileInfo dirCopy(dir);
+    QVERIFY2(dirCopy.contents().size() == 1, "contents of copy have wrong size");
+    QVERIFY2(dirCopy.contents().at(0).path().compare("/a") == 0, "contents of copy do not match");
+}
+
 /**
  * @brief QDropbox: Plaintext Connection
  * This test connects to Dropbox and sends a dummy request to check that the connection in
@@ -226,6 +353,9 @@ void QtDropboxTest::jsonCase15()
  */
 void QtDropboxTest::dropboxCase1()
 {
+    if(QString(APP_KEY).isEmpty())
+        QSKIP("keys.hpp is needed to connect to Dropbox");
+
     QDropbox dropbox(APP_KEY, APP_SECRET);
     QVERIFY2(connectDropbox(&dropbox, QDropbox::Plaintext), "connection error");
     QDropboxAccount accInf = dropbox.requestAccountInfoAndWait();
@@ -244,6 +374,9 @@ void QtDropboxTest::dropboxCase1()
 void QtDropboxTest::dropboxCase2()
 {
     QTextStream strout(stdout);
+    if(QString(APP_KEY).isEmpty())
+        QSKIP("keys.hpp is needed to connect to Dropbox");
+
     QDropbox dropbox(APP_KEY, APP_SECRET);
     QVERIFY2(connectDropbox(&dropbox, QDropbox::Plaintext), "connection error");
 
@@ -282,6 +415,851 @@ void QtDropboxTest::dropboxCase2()
     return;
 }
 
+/**
+ * @brief QDropbox: nonce generation
+ * Generated nonces must have the requested length, consist of hex digits only
+ * and differ from each other.
+ */
+void QtDropboxTest::dropboxCase3()
+{
+    QVERIFY2(QDropbox::generateNonce().length() == 32, "default nonce length does not match");
+    QVERIFY2(QDropbox::generateNonce(0).isEmpty(), "empty nonce expected");
+
+    QRegularExpression hex("^[0-9A-F]*$");
+    QSet<QString> nonces;
+    for(int i=0; i<100; ++i)
+    {
+        QString nonce = QDropbox::generateNonce(13);
+        QVERIFY2(nonce.length() == 13, "nonce length does not match");
+        QVERIFY2(hex.match(nonce).hasMatch(), "nonce contains non hex characters");
+        nonces.insert(nonce);
+    }
+    QVERIFY2(nonces.size() == 100, "nonces are not unique");
+    return;
+}
+
+/**
+ * @brief QDropbox: request signing
+ * Checks hmacsha1() against the test cases of RFC 2202 (including keys longer than
+ * a block) and that signatures follow changes of the token secret.
+ */
+void QtDropboxTest::dropboxCase4()
+{
+    auto hmac = [](QByteArray key, QByteArray message, QByteArray hex){
+        return QDropbox::hmacsha1(key, message) == QString(QByteArray::fromHex(hex).toBase64());
+    };
+    QVERIFY2(hmac(QByteArray(20, char(0x0b)), "Hi There",
+                  "b617318655057264e28bc0b6fb378c8ef146be00"), "RFC 2202 test case 1 failed");
+    QVERIFY2(hmac("Jefe", "what do ya want for nothing?",
+                  "effcdf6ae5eb2fa2d27416d5f184df9c259a7c79"), "RFC 2202 test case 2 failed");
+    QVERIFY2(hmac(QByteArray(20, char(0xaa)), QByteArray(50, char(0xdd)),
+                  "125d7342b9ac11cd91a39af48aa17b4f63f175d3"), "RFC 2202 test case 3 failed");
+    QVERIFY2(hmac(QByteArray(80, char(0xaa)), "Test Using Larger Than Block-Size Key - Hash Key First",
+                  "aa4ae5e15272d00e95705637ce8a3b55ed402112"), "RFC 2202 test case 6 failed");
+    QVERIFY2(hmac(QByteArray(80, char(0xaa)), "Test Using Larger Than Block-Size Key and Larger Than One Block-Size Data",
+                  "e8e99d0f45237d786d6bbaa7965c7808bbff1a91"), "RFC 2202 test case 7 failed");
+
+    // the cached signing context is rebuilt when the token secret changes
+    QDropbox dropbox("mockkey", "mocksecret");
+    QUrl url("http://127.0.0.1/1/metadata/dropbox");
+    dropbox.setTokenSecret("first");
+    QVERIFY2(dropbox.oAuthSign(url) == "mocksecret&first", "PLAINTEXT signature does not match");
+    dropbox.setTokenSecret("second");
+    QVERIFY2(dropbox.oAuthSign(url) == "mocksecret&second", "PLAINTEXT signature not rebuilt");
+
+    dropbox.setAuthMethod(QDropbox::HMACSHA1);
+    QByteArray base = "GET&" + QUrl::toPercentEncoding(url.toString()) + "&";
+    QVERIFY2(dropbox.oAuthSign(url) == QDropbox::hmacsha1("mocksecret&second", base), "HMAC-SHA1 signature does not match");
+    QVERIFY2(dropbox.oAuthQuery("nonce", 0).queryItemValue("oauth_signature_method") == "HMAC-SHA1",
+             "signature method not rebuilt");
+    dropbox.setTokenSecret("third");
+    QVERIFY2(dropbox.oAuthSign(url) == QDropbox::hmacsha1("mocksecret&third", base), "HMAC-SHA1 signature not rebuilt");
+    return;
+}
+
+/*!
+ * Nonce generation before the generator was changed, used as baseline for nonceBenchmark().
+ */
+static QString legacyNonce(qint32 length)
+{
+    QString clng = "";
+    for(int i=0; i<length; ++i)
+        clng += QString::number(int( qrand() / (RAND_MAX + 1.0) * (16 + 1 - 0) + 0 ), 16).toUpper();
+    return clng;
+}
+
+void QtDropboxTest::nonceBenchmark_data()
+{
+    QTest::addColumn<bool>("legacy");
+    QTest::addColumn<int>("length");
+
+    QTest::newRow("legacy, 128 digits") << true  << 128;
+    QTest::newRow("current, 128 digits") << false << 128;
+    QTest::newRow("current, 32 digits") << false << 32;
+}
+
+/**
+ * @brief QDropbox: nonce benchmark
+ * Compares the nonce generator with the per-character qrand() implementation it replaced.
+ */
+void QtDropboxTest::nonceBenchmark()
+{
+    QFETCH(bool, legacy);
+    QFETCH(int, length);
+
+    QString nonce;
+    if(legacy)
+    {
+        QBENCHMARK { nonce = legacyNonce(length); }
+    }
+    else
+    {
+        QBENCHMARK { nonce = QDropbox::generateNonce(length); }
+    }
+    QVERIFY(!nonce.isEmpty());
+    return;
+}
+
+/**
+ * @brief QDropboxHistogram: aggregates and percentiles
+ * Adds the values 0 to 100 and checks count, sum, bounds and that percentiles
+ * are reported as upper bounds of their buckets.
+ */
+void QtDropboxTest::statisticsCase1()
+{
+    QDropboxHistogram histogram;
+    QVERIFY2(histogram.percentile(50) == 0, "percentile of empty histogram");
+
+    for(int i=0; i<=100; ++i)
+        histogram.add(i);
+
+    QVERIFY2(histogram.count() == 101, "count does not match");
+    QVERIFY2(histogram.sum() == 5050, "sum does not match");
+    QVERIFY2(histogram.min() == 0 && histogram.max() == 100, "bounds do not match");
+    QVERIFY2(histogram.buckets().size() == 8, "number of buckets does not match");
+    QVERIFY2(histogram.percentile(50) == 63, "median is not the upper bound of its bucket");
+    QVERIFY2(histogram.percentile(100) == 100, "percentile exceeds maximum");
+
+    histogram.clear();
+    QVERIFY2(histogram.count() == 0 && histogram.buckets().isEmpty(), "histogram not cleared");
+    return;
+}
+
+/**
+ * @brief QDropboxTracer: trace event output
+ * Writes a span, a flow and an async span to a buffer and checks that the output
+ * is a valid trace event JSON array.
+ */
+void QtDropboxTest::tracerCase1()
+{
+    QBuffer buffer;
+    buffer.open(QIODevice::WriteOnly);
+
+    QDropboxTracer tracer;
+    QVERIFY2(tracer.open(&buffer), "tracer could not be opened");
+    {
+        QDropboxTraceSpan span(&tracer, "send", "QDropbox", 7);
+        tracer.flow('s', "QDropbox", 7);
+    }
+    tracer.asyncBegin("network", "QDropbox", 7);
+    tracer.asyncEnd("network", "QDropbox", 7);
+    tracer.close();
+    QVERIFY2(!tracer.isOpen(), "tracer still open");
+
+    // spans of a closed tracer are dropped
+    {
+        QDropboxTraceSpan span(&tracer, "send", "QDropbox", 8);
+    }
+
+    QJsonParseError error;
+    QJsonDocument trace = QJsonDocument::fromJson(buffer.data(), &error);
+    QVERIFY2(error.error == QJsonParseError::NoError, "trace is not valid JSON");
+    QVERIFY2(trace.isArray() && trace.array().size() == 4, "number of events does not match");
+
+    QJsonObject flow = trace.array().at(0).toObject();
+    QVERIFY2(flow.value("ph").toString() == "s" && flow.value("id").toInt() == 7, "flow event does not match");
+    QJsonObject span = trace.array().at(1).toObject();
+    QVERIFY2(span.value("ph").toString() == "X" && span.value("name").toString() == "send", "span does not match");
+    QVERIFY2(span.value("args").toObject().value("request").toInt() == 7, "span request does not match");
+    return;
+}
+
+/**
+ * @brief MockDropboxServer: authorization and account info
+ * Runs the token handshake and an account info request against the local mock
+ * server, no network access or app keys are needed.
+ */
+void QtDropboxTest::mockCase1()
+{
+    MockDropboxServer server;
+    QVERIFY2(server.start(), "mock server could not listen");
+
+    QDropbox dropbox("mockkey", "mocksecret");
+    dropbox.setApiUrl(server.url());
+    QVERIFY2(dropbox.apiUrl().startsWith("http://127.0.0.1"), "API URL scheme not kept");
+
+    QVERIFY2(dropbox.requestTokenAndWait(), "request token failed");
+    QVERIFY2(dropbox.requestAccessTokenAndWait(), "access token failed");
+    QVERIFY2(dropbox.token() == "mockaccesstoken", "access token does not match");
+
+    QDropboxAccount account = dropbox.requestAccountInfoAndWait();
+    QVERIFY2(dropbox.error() == QDropbox::NoError, "error on request");
+    QVERIFY2(account.displayName() == "Mock User", "account info does not match");
+    QVERIFY2(server.requestCount() == 3, "request count does not match");
+    return;
+}
+
+/**
+ * @brief MockDropboxServer: throttled requests are retried
+ * The mock server answers the first request with 503, QDropbox has to retry it.
+ */
+void QtDropboxTest::mockCase2()
+{
+    MockDropboxServer server;
+    QVERIFY2(server.start(), "mock server could not listen");
+    server.setListingSize(100);
+    server.injectError(503);
+
+    QDropbox dropbox("mockkey", "mocksecret");
+    dropbox.setApiUrl(server.url());
+    dropbox.setToken("mocktoken");
+    dropbox.setTokenSecret("mocksecret");
+    dropbox.setRetryBaseDelay(10);
+
+    QDropboxFileInfo dir = dropbox.requestMetadataAndWait("dropbox/mock");
+    QVERIFY2(dropbox.error() == QDropbox::NoError, "error on request");
+    QVERIFY2(dir.isDir() && dir.contents().size() == 100, "listing does not match");
+    QVERIFY2(dropbox.retryCount() == 1, "throttled request not retried");
+    QVERIFY2(server.requestCount("metadata") == 2, "request count does not match");
+    return;
+}
+
+/**
+ * @brief MockDropboxServer: file upload and download
+ * Writes a file to the mock content server and reads it back. The content URL is
+ * inherited from QDropbox for the upload and set on the file for the download.
+ */
+void QtDropboxTest::mockCase3()
+{
+    MockDropboxServer server;
+    QVERIFY2(server.start(), "mock server could not listen");
+
+    QDropbox dropbox("mockkey", "mocksecret");
+    dropbox.setApiUrl(server.url());
+    dropbox.setToken("mocktoken");
+    dropbox.setTokenSecret("mocksecret");
+    dropbox.setContentUrl(server.url());
+
+    QByteArray content(100000, 'x');
+
+    QDropboxFile out("dropbox/mock.txt", &dropbox);
+    QVERIFY2(out.contentUrl() == dropbox.contentUrl(), "content URL not inherited");
+    QVERIFY2(out.open(QIODevice::WriteOnly), "file not opened for writing");
+    out.write(content);
+    out.close();
+    QVERIFY2(server.file("dropbox/mock.txt") == content, "uploaded content does not match");
+
+    QDropbox other("mockkey", "mocksecret");
+    other.setApiUrl(server.url());
+    other.setToken("mocktoken");
+    other.setTokenSecret("mocksecret");
+
+    QDropboxFile in("dropbox/mock.txt", &other);
+    in.setContentUrl(server.url());
+    QVERIFY2(in.open(QIODevice::ReadOnly), "file not opened for reading");
+    QVERIFY2(in.readAll() == content, "downloaded content does not match");
+    in.close();
+    return;
+}
+
+/**
+ * @brief QDropboxFile: inserting writes
+ * Writes at the end, in front of and in the middle of new and of downloaded
+ * content and checks the uploaded result.
+ */
+void QtDropboxTest::mockCase4()
+{
+    MockDropboxServer server;
+    QVERIFY2(server.start(), "mock server could not listen");
+
+    QDropbox dropbox("mockkey", "mocksecret");
+    dropbox.setApiUrl(server.url());
+    dropbox.setContentUrl(server.url());
+    dropbox.setToken("mocktoken");
+    dropbox.setTokenSecret("mocksecret");
+
+    QByteArray expected;
+    QDropboxFile file("dropbox/lines.txt", &dropbox);
+    file.setFlushThreshold(1024*1024);
+    QVERIFY2(file.open(QIODevice::WriteOnly), "file not opened for writing");
+    for(int i=0; i<1000; ++i)
+    {
+        QByteArray line = QString("line %1\n").arg(i).toLatin1();
+        file.write(line);
+        expected.append(line);
+    }
+    file.seek(0);
+    file.write("header\n");
+    expected.prepend("header\n");
+    file.seek(500);
+    file.write("inserted");
+    expected.insert(500, "inserted");
+    file.close();
+    QVERIFY2(server.file("dropbox/lines.txt") == expected, "uploaded content does not match");
+
+    // edit downloaded content in place
+    server.setFile("dropbox/edit.txt", "0123456789");
+    QDropboxFile edit("dropbox/edit.txt", &dropbox);
+    QVERIFY2(edit.open(QIODevice::WriteOnly|QIODevice::Append), "file not opened for appending");
+    edit.write("end");
+    edit.seek(5);
+    edit.write("-");
+    edit.close();
+    QVERIFY2(server.file("dropbox/edit.txt") == "01234-56789end", "edited content does not match");
+    return;
+}
+
+/**
+ * @brief QDropboxFile: reading and views of downloaded content
+ * Views must reference the downloaded content without copying it and must not
+ * move the position, reads must stop at the end of the content.
+ */
+void QtDropboxTest::mockCase5()
+{
+    MockDropboxServer server;
+    QVERIFY2(server.start(), "mock server could not listen");
+    server.setFile("dropbox/view.txt", "0123456789");
+
+    QDropbox dropbox("mockkey", "mocksecret");
+    dropbox.setApiUrl(server.url());
+    dropbox.setContentUrl(server.url());
+    dropbox.setToken("mocktoken");
+    dropbox.setTokenSecret("mocksecret");
+
+    QDropboxFile file("dropbox/view.txt", &dropbox);
+    QVERIFY2(file.open(QIODevice::ReadOnly), "file not opened for reading");
+    QVERIFY2(file.size() == 10 && file.bytesAvailable() == 10, "size does not match");
+
+    QByteArray view = file.peekView();
+    QVERIFY2(view == "0123456789", "view does not match");
+    QVERIFY2(file.peekView().constData() == view.constData(), "view is a copy");
+    QVERIFY2(file.pos() == 0, "view moved the position");
+
+    char data[8];
+    QVERIFY2(file.seek(6), "seek failed");
+    QVERIFY2(file.read(data, sizeof(data)) == 4, "read beyond the end of the content");
+    QVERIFY2(QByteArray(data, 4) == "6789", "read content does not match");
+    QVERIFY2(file.atEnd() && file.peekView().isEmpty(), "end of content not reached");
+    file.close();
+    return;
+}
+
+/**
+ * @brief QDropboxFile: random access reads
+ * Reads across block boundaries, at the end of the file and from an empty file.
+ * Only the blocks that are read may be downloaded.
+ */
+void QtDropboxTest::mockCase6()
+{
+    MockDropboxServer server;
+    QVERIFY2(server.start(), "mock server could not listen");
+
+    QByteArray content;
+    for(int i=0; i<1000; ++i)
+        content.append(char('a' + i%26));
+    server.setFile("dropbox/blocks.txt", content);
+    server.setFile("dropbox/empty.txt", QByteArray());
+
+    QDropbox dropbox("mockkey", "mocksecret");
+    dropbox.setApiUrl(server.url());
+    dropbox.setContentUrl(server.url());
+    dropbox.setToken("mocktoken");
+    dropbox.setTokenSecret("mocksecret");
+
+    QDropboxFile file("dropbox/blocks.txt", &dropbox);
+    file.setReadMode(QDropboxFile::RandomAccessRead);
+    file.setBlockSize(100);
+    QVERIFY2(file.open(QIODevice::ReadOnly), "file not opened for reading");
+    QVERIFY2(file.size() == content.size(), "size does not match");
+    QVERIFY2(server.requestCount("files") == 1, "more than the first block downloaded");
+
+    // 50 bytes from the end of block 4 to the start of block 5
+    QVERIFY2(file.seek(475), "seek failed");
+    QVERIFY2(file.read(50) == content.mid(475, 50), "read across blocks does not match");
+    QVERIFY2(file.pos() == 525, "position does not match");
+
+    // cached blocks are not downloaded again
+    int requests = server.requestCount("files");
+    QVERIFY2(file.seek(480), "seek failed");
+    QVERIFY2(file.read(40) == content.mid(480, 40), "cached read does not match");
+    QVERIFY2(server.requestCount("files") == requests, "cached block downloaded again");
+
+    // reads stop at the end of the file and report 0 there
+    char data[64];
+    QVERIFY2(file.seek(990), "seek failed");
+    QVERIFY2(file.read(data, sizeof(data)) == 10, "read beyond the end of the file");
+    QVERIFY2(QByteArray(data, 10) == content.right(10), "last bytes do not match");
+    QVERIFY2(file.read(data, sizeof(data)) == 0, "read at the end of the file failed");
+    QVERIFY2(file.atEnd(), "end of file not reached");
+    file.close();
+
+    // the server answers the first block of an empty file with 416
+    QDropboxFile empty("dropbox/empty.txt", &dropbox);
+    empty.setReadMode(QDropboxFile::RandomAccessRead);
+    QVERIFY2(empty.open(QIODevice::ReadOnly), "empty file not opened for reading");
+    QVERIFY2(empty.size() == 0, "size of empty file does not match");
+    QVERIFY2(empty.read(data, sizeof(data)) == 0, "read from empty file failed");
+    QVERIFY2(empty.atEnd(), "empty file not at its end");
+    empty.close();
+    return;
+}
+
+/**
+ * @brief QDropboxFile: streaming reads
+ * The content arrives in slices. readyRead() must not be emitted while a read
+ * waits for data and a download that breaks off must be reported as an error.
+ */
+void QtDropboxTest::mockCase7()
+{
+    MockDropboxServer server;
+    QVERIFY2(server.start(), "mock server could not listen");
+    server.setBandwidth(2000000);
+
+    QByteArray content;
+    for(int i=0; i<100000; ++i)
+        content.append(char('a' + i%26));
+    server.setFile("dropbox/stream.txt", content);
+
+    QDropbox dropbox("mockkey", "mocksecret");
+    dropbox.setApiUrl(server.url());
+    dropbox.setContentUrl(server.url());
+    dropbox.setToken("mocktoken");
+    dropbox.setTokenSecret("mocksecret");
+
+    bool reading   = false;
+    bool reentered = false;
+    QDropboxFile file("dropbox/stream.txt", &dropbox);
+    file.setReadMode(QDropboxFile::StreamingRead);
+    connect(&file, &QIODevice::readyRead, [&reading, &reentered]{ reentered |= reading; });
+    QVERIFY2(file.open(QIODevice::ReadOnly), "file not opened for reading");
+
+    QByteArray received;
+    char data[4096];
+    while(!file.atEnd())
+    {
+        reading = true;
+        qint64 read = file.read(data, sizeof(data));
+        reading = false;
+        QVERIFY2(read >= 0, "read from stream failed");
+        received.append(data, int(read));
+    }
+    QVERIFY2(received == content, "streamed content does not match");
+    QVERIFY2(!reentered, "readyRead() emitted during a blocking read");
+    file.close();
+
+    // the server closes the connection in the middle of the file
+    server.setDisconnectAfter(30000);
+    QDropboxFile broken("dropbox/stream.txt", &dropbox);
+    broken.setReadMode(QDropboxFile::StreamingRead);
+    QVERIFY2(broken.open(QIODevice::ReadOnly), "file not opened for reading");
+
+    qint64 total = 0;
+    qint64 read;
+    while((read = broken.read(data, sizeof(data))) > 0)
+        total += read;
+    QVERIFY2(read == -1, "broken download not reported");
+    QVERIFY2(total == 30000, "data received before the error was lost");
+    QVERIFY2(!broken.errorString().isEmpty(), "no error string set");
+    broken.close();
+    return;
+}
+
+/**
+ * @brief QDropboxFile: chunked uploads
+ * Uploads a file in chunks, resynchronizes the offset after a lost answer and
+ * reports a failed commit when the file is closed.
+ */
+void QtDropboxTest::mockCase8()
+{
+    MockDropboxServer server;
+    QVERIFY2(server.start(), "mock server could not listen");
+
+    QDropbox dropbox("mockkey", "mocksecret");
+    dropbox.setApiUrl(server.url());
+    dropbox.setContentUrl(server.url());
+    dropbox.setToken("mocktoken");
+    dropbox.setTokenSecret("mocksecret");
+
+    QByteArray content;
+    for(int i=0; i<300000; ++i)
+        content.append(char('a' + i%26));
+
+    QDropboxFile file("dropbox/chunked.txt", &dropbox);
+    file.setChunkedUpload(true);
+    file.setFlushThreshold(65536);
+    QVERIFY2(file.open(QIODevice::WriteOnly), "file not opened for writing");
+    for(int offset=0; offset<content.size(); offset += 10000)
+        file.write(content.mid(offset, 10000));
+    file.close();
+    QVERIFY2(server.file("dropbox/chunked.txt") == content, "uploaded content does not match");
+    QVERIFY2(server.requestCount("chunked_upload") > 1, "content not uploaded in chunks");
+    QVERIFY2(server.requestCount("commit_chunked_upload") == 1, "upload not committed once");
+
+    // the server stores the second chunk but its answer is lost, the next
+    // chunk is rejected with the offset the server expects
+    QDropboxFile lost("dropbox/lost.txt", &dropbox);
+    lost.setChunkedUpload(true);
+    lost.setFlushThreshold(1024*1024);
+    QVERIFY2(lost.open(QIODevice::WriteOnly), "file not opened for writing");
+    lost.write(content.left(100000));
+    QVERIFY2(lost.flush(), "first chunk not uploaded");
+    lost.write(content.mid(100000, 100000));
+    server.loseChunkAnswers(1);
+    QVERIFY2(!lost.flush(), "lost answer not reported");
+    lost.write(content.mid(200000));
+    QVERIFY2(lost.flush(), "offset not resynchronized");
+    lost.close();
+    QVERIFY2(server.file("dropbox/lost.txt") == content, "resynchronized content does not match");
+
+    // a failed commit is reported by close()
+    QString failure;
+    QDropboxFile failed("dropbox/failed.txt", &dropbox);
+    connect(&failed, &QDropboxFile::writeFailed, [&failure](int, QString message){ failure = message; });
+    failed.setChunkedUpload(true);
+    failed.setFlushThreshold(1024*1024);
+    QVERIFY2(failed.open(QIODevice::WriteOnly), "file not opened for writing");
+    failed.write(content);
+    QVERIFY2(failed.flush(), "chunk not uploaded");
+    server.injectError(507);
+    failed.close();
+    QVERIFY2(!failure.isEmpty(), "failed commit not reported");
+    QVERIFY2(failed.errorString().contains(failure), "error string not set");
+    QVERIFY2(server.file("dropbox/failed.txt").isEmpty(), "failed commit stored the file");
+    return;
+}
+
+/**
+ * @brief QDropbox: revalidated directory listings
+ * Lists a folder twice without a cache time to live. The second listing is sent
+ * with the hash of the first, answered with 304 and served from the cache. A
+ * listing that leaves the cache while it is revalidated is requested again.
+ */
+void QtDropboxTest::mockCase9()
+{
+    MockDropboxServer server;
+    QVERIFY2(server.start(), "mock server could not listen");
+    server.setListingSize(20);
+
+    QDropbox dropbox("mockkey", "mocksecret");
+    dropbox.setApiUrl(server.url());
+    dropbox.setToken("mocktoken");
+    dropbox.setTokenSecret("mocksecret");
+
+    QDropboxFileInfo first = dropbox.requestMetadataAndWait("dropbox/mock");
+    QVERIFY2(dropbox.error() == QDropbox::NoError, "error on first listing");
+    QVERIFY2(first.contents().size() == 20, "first listing does not match");
+
+    QDropboxFileInfo second = dropbox.requestMetadataAndWait("dropbox/mock");
+    QVERIFY2(dropbox.error() == QDropbox::NoError, "error on revalidated listing");
+    QVERIFY2(server.requestCount("metadata") == 2, "listing not revalidated");
+    QVERIFY2(second.hash() == first.hash(), "hash does not match");
+
+    QList<QDropboxFileInfo> before = first.contents();
+    QList<QDropboxFileInfo> after  = second.contents();
+    QVERIFY2(after.size() == before.size(), "revalidated listing does not match");
+    for(int i=0; i<after.size(); ++i)
+        QVERIFY2(after.at(i).path() == before.at(i).path(), "revalidated entry does not match");
+
+    // the cache is cleared while the server takes its time to answer 304
+    server.setLatency(50);
+    QFuture<QDropboxFileInfo> future = dropbox.requestMetadataAsync("dropbox/mock");
+    dropbox.clearMetadataCache();
+    QTRY_VERIFY2(future.isFinished(), "listing not received");
+    QVERIFY2(dropbox.error() == QDropbox::NoError, "error on listing that left the cache");
+    QVERIFY2(future.result().contents().size() == 20, "listing that left the cache does not match");
+    QVERIFY2(server.requestCount("metadata") == 4, "listing not requested again");
+    return;
+}
+
+/**
+ * @brief QDropbox: coalesced requests
+ * Identical metadata requests that are sent while the first one is still running
+ * share its answer. Every request still gets its own number and operationFinished(),
+ * an error of the shared request releases all callers.
+ */
+void QtDropboxTest::mockCase10()
+{
+    MockDropboxServer server;
+    QVERIFY2(server.start(), "mock server could not listen");
+    server.setListingSize(20);
+    server.setLatency(50);
+
+    QDropbox dropbox("mockkey", "mocksecret");
+    dropbox.setApiUrl(server.url());
+    dropbox.setToken("mocktoken");
+    dropbox.setTokenSecret("mocksecret");
+
+    QSignalSpy started(&dropbox, SIGNAL(operationStarted(int)));
+    QSignalSpy finished(&dropbox, SIGNAL(operationFinished(int)));
+
+    // two asynchronous callers
+    QFuture<QDropboxFileInfo> first  = dropbox.requestMetadataAsync("dropbox/mock");
+    QFuture<QDropboxFileInfo> second = dropbox.requestMetadataAsync("dropbox/mock");
+    QTRY_VERIFY2(first.isFinished() && second.isFinished(), "listings not received");
+    QVERIFY2(server.requestCount("metadata") == 1, "identical requests not coalesced");
+    QVERIFY2(first.result().contents().size() == 20, "listing does not match");
+    QVERIFY2(second.result().strContent() == first.result().strContent(), "coalesced listing does not match");
+
+    QVERIFY2(started.count() == 2 && finished.count() == 2, "operation signals do not match");
+    int nr = started.at(0).at(0).toInt();
+    int other = started.at(1).at(0).toInt();
+    QVERIFY2(nr != other, "coalesced request has no number of its own");
+    QVERIFY2((finished.at(0).at(0).toInt() == nr && finished.at(1).at(0).toInt() == other) ||
+             (finished.at(0).at(0).toInt() == other && finished.at(1).at(0).toInt() == nr),
+             "request not finished");
+
+    // an asynchronous and a blocking caller
+    QFuture<QDropboxFileInfo> async = dropbox.requestMetadataAsync("dropbox/other");
+    QDropboxFileInfo blocking = dropbox.requestMetadataAndWait("dropbox/other");
+    QVERIFY2(dropbox.error() == QDropbox::NoError, "error on blocking request");
+    QTRY_VERIFY2(async.isFinished(), "listing not received");
+    QVERIFY2(server.requestCount("metadata") == 2, "identical requests not coalesced");
+    QVERIFY2(blocking.contents().size() == 20, "listing does not match");
+    QVERIFY2(async.result().strContent() == blocking.strContent(), "coalesced listing does not match");
+
+    // the shared request fails, nobody waits forever
+    server.injectError(401);
+    QFuture<QDropboxFileInfo> failed = dropbox.requestMetadataAsync("dropbox/expired");
+    QDropboxFileInfo expired = dropbox.requestMetadataAndWait("dropbox/expired");
+    QVERIFY2(dropbox.error() == QDropbox::TokenExpired, "error of shared request not reported");
+    QVERIFY2(expired.contents().isEmpty(), "result of failed request not empty");
+    QTRY_VERIFY2(failed.isFinished(), "asynchronous caller not released");
+    QVERIFY2(failed.result().contents().isEmpty(), "result of failed request not empty");
+    QVERIFY2(server.requestCount("metadata") == 3, "identical requests not coalesced");
+    return;
+}
+
+/**
+ * @brief QDropbox: metadata cache
+ * Serves listings from the cache while they live, counts hits and misses and
+ * drops listings that changed by an upload or according to delta.
+ */
+void QtDropboxTest::mockCase11()
+{
+    MockDropboxServer server;
+    QVERIFY2(server.start(), "mock server could not listen");
+    server.setListingSize(20);
+
+    QDropbox dropbox("mockkey", "mocksecret");
+    dropbox.setApiUrl(server.url());
+    dropbox.setContentUrl(server.url());
+    dropbox.setToken("mocktoken");
+    dropbox.setTokenSecret("mocksecret");
+    dropbox.setMetadataCacheTtl(60000);
+
+    QDropboxFileInfo dir = dropbox.requestMetadataAndWait("dropbox/mock");
+    QVERIFY2(dropbox.error() == QDropbox::NoError, "error on listing");
+    QDropboxFileInfo cached = dropbox.requestMetadataAndWait("Dropbox/Mock/");
+    QVERIFY2(dropbox.error() == QDropbox::NoError, "error on cached listing");
+    QVERIFY2(cached.strContent() == dir.strContent(), "cached listing does not match");
+    QVERIFY2(server.requestCount("metadata") == 1, "listing not served from cache");
+    QVERIFY2(dropbox.metadataCacheMisses() == 1 && dropbox.metadataCacheHits() == 1, "cache counters do not match");
+
+    // an upload into the folder changes its listing
+    QDropboxFile file("dropbox/mock/new.txt", &dropbox);
+    QVERIFY2(file.open(QIODevice::WriteOnly), "file not opened for writing");
+    file.write("new content");
+    file.close();
+
+    int requests = server.requestCount("metadata");
+    int misses = dropbox.metadataCacheMisses();
+    dropbox.requestMetadataAndWait("dropbox/mock");
+    QVERIFY2(server.requestCount("metadata") == requests+1, "listing not invalidated by upload");
+    QVERIFY2(dropbox.metadataCacheMisses() == misses+1, "cache miss not counted");
+
+    // delta reports changes below one of two folders
+    dropbox.requestMetadataAndWait("dropbox/delta/page0");
+    dropbox.requestMetadataAndWait("dropbox/delta/other");
+    requests = server.requestCount("metadata");
+    int hits = dropbox.metadataCacheHits();
+
+    dropbox.requestDeltaAndWait("page0", "");
+    QVERIFY2(dropbox.error() == QDropbox::NoError, "error on delta");
+    dropbox.requestMetadataAndWait("dropbox/delta/other");
+    QVERIFY2(server.requestCount("metadata") == requests, "unchanged listing invalidated by delta");
+    QVERIFY2(dropbox.metadataCacheHits() == hits+1, "cache hit not counted");
+    dropbox.requestMetadataAndWait("dropbox/delta/page0");
+    QVERIFY2(server.requestCount("metadata") == requests+1, "listing not invalidated by delta");
+
+    // a delta without cursor resets the cache
+    dropbox.requestDeltaAndWait("", "");
+    QVERIFY2(dropbox.error() == QDropbox::NoError, "error on delta");
+    dropbox.requestMetadataAndWait("dropbox/delta/other");
+    QVERIFY2(server.requestCount("metadata") == requests+2, "cache not reset by delta");
+    return;
+}
+
+/**
+ * @brief QDropbox: request priorities
+ * With a single connection background requests queue up behind each other. An
+ * interactive request sent afterwards is the next one sent.
+ */
+void QtDropboxTest::mockCase12()
+{
+    MockDropboxServer server;
+    QVERIFY2(server.start(), "mock server could not listen");
+    server.setLatency(50);
+
+    QDropbox dropbox("mockkey", "mocksecret");
+    dropbox.setApiUrl(server.url());
+    dropbox.setToken("mocktoken");
+    dropbox.setTokenSecret("mocksecret");
+
+    dropbox.setMaxConnectionsPerHost(0);
+    QVERIFY2(dropbox.maxConnectionsPerHost() == 1, "connection limit not kept at 1");
+
+    QSignalSpy finished(&dropbox, SIGNAL(operationFinished(int)));
+
+    dropbox.setRequestPriority(QDropbox::BackgroundPriority);
+    for(int i=0; i<3; ++i)
+        QVERIFY2(dropbox.requestMetadata(QString("dropbox/background%1").arg(i)) >= 0, "request not sent");
+    QVERIFY2(dropbox.activeConnections("127.0.0.1") == 1, "active connections do not match");
+    QVERIFY2(dropbox.queuedRequests() == 2, "queued requests do not match");
+    QVERIFY2(dropbox.queuedRequests(QDropbox::BackgroundPriority) == 2, "queued background requests do not match");
+
+    dropbox.setRequestPriority(QDropbox::InteractivePriority);
+    int interactive = dropbox.requestMetadata("dropbox/interactive");
+    QVERIFY2(interactive >= 0, "request not sent");
+    QVERIFY2(dropbox.queuedRequests() == 3, "queued requests do not match");
+    QVERIFY2(dropbox.queuedRequests(QDropbox::InteractivePriority) == 1, "queued interactive requests do not match");
+
+    QTRY_VERIFY2(finished.count() == 4, "requests not finished");
+    QVERIFY2(finished.at(1).at(0).toInt() == interactive, "interactive request did not overtake queued requests");
+    QVERIFY2(dropbox.queuedRequests() == 0, "requests left in the queue");
+    QVERIFY2(server.requestCount("metadata") == 4, "request count does not match");
+    return;
+}
+
+/**
+ * @brief QDropbox: overlapping blocking calls
+ * A second blocking call is made from the event loop of the first one. The calls
+ * are answered while both wait, each of them has to return its own result and error.
+ */
+void QtDropboxTest::mockCase13()
+{
+    MockDropboxServer server;
+    QVERIFY2(server.start(), "mock server could not listen");
+    server.setListingSize(20);
+    server.setLatency(100);
+
+    QDropbox dropbox("mockkey", "mocksecret");
+    dropbox.setApiUrl(server.url());
+    dropbox.setToken("mocktoken");
+    dropbox.setTokenSecret("mocksecret");
+
+    // the second call fails, it is made as soon as the server has the first one
+    QDropboxAccount account;
+    QDropbox::Error accountError = QDropbox::NoError;
+    QTimer::singleShot(0, this, [&]{
+        for(int i=0; i<100 && server.requestCount("metadata") == 0; ++i)
+            QTest::qWait(10);
+        server.injectError(507);
+        account = dropbox.requestAccountInfoAndWait();
+        accountError = dropbox.error();
+    });
+
+    QDropboxFileInfo dir = dropbox.requestMetadataAndWait("dropbox/mock");
+    QVERIFY2(server.requestCount("account/info") == 1, "second call not made while the first one waited");
+    QVERIFY2(dropbox.error() == QDropbox::NoError, "error of the second call reported for the first");
+    QVERIFY2(dir.contents().size() == 20, "listing does not match");
+    QVERIFY2(accountError == QDropbox::UserOverQuota, "error of the second call not reported");
+    QVERIFY2(account.displayName().isEmpty(), "result of the failed call not empty");
+    return;
+}
+
+/**
+ * @brief QDropbox: asynchronous requests
+ * Waits on the futures of asynchronous requests. A failed request has to resolve
+ * its future with an empty result.
+ */
+void QtDropboxTest::mockCase14()
+{
+    MockDropboxServer server;
+    QVERIFY2(server.start(), "mock server could not listen");
+    server.setLatency(20);
+
+    QDropbox dropbox("mockkey", "mocksecret");
+    dropbox.setApiUrl(server.url());
+    dropbox.setToken("mocktoken");
+    dropbox.setTokenSecret("mocksecret");
+
+    QFutureWatcher<QDropboxAccount> accountWatcher;
+    QSignalSpy accountFinished(&accountWatcher, SIGNAL(finished()));
+    accountWatcher.setFuture(dropbox.requestAccountInfoAsync());
+    QVERIFY2(accountFinished.wait(), "account info future not resolved");
+    QVERIFY2(dropbox.error() == QDropbox::NoError, "error on request");
+    QVERIFY2(accountWatcher.result().displayName() == "Mock User", "account info does not match");
+
+    server.injectError(507);
+    QFutureWatcher<QDropboxFileInfo> metadataWatcher;
+    QSignalSpy metadataFinished(&metadataWatcher, SIGNAL(finished()));
+    metadataWatcher.setFuture(dropbox.requestMetadataAsync("dropbox/mock"));
+    QVERIFY2(metadataFinished.wait(), "future of failed request not resolved");
+    QVERIFY2(dropbox.error() == QDropbox::UserOverQuota, "error not reported");
+    QVERIFY2(metadataWatcher.future().resultCount() == 1, "future of failed request has no result");
+    QVERIFY2(metadataWatcher.result().path().isEmpty() &&
+             metadataWatcher.result().contents().isEmpty(), "result of failed request not empty");
+    return;
+}
+
+/**
+ * @brief QDropbox: request history
+ * Keeps the records of the last three requests. The oldest record is replaced by
+ * the fourth request, requestInfo() only knows the requests that are retained.
+ */
+void QtDropboxTest::mockCase15()
+{
+    MockDropboxServer server;
+    QVERIFY2(server.start(), "mock server could not listen");
+
+    QDropbox dropbox("mockkey", "mocksecret");
+    dropbox.setApiUrl(server.url());
+    dropbox.setToken("mocktoken");
+    dropbox.setTokenSecret("mocksecret");
+
+    dropbox.setRequestHistorySize(3);
+    QVERIFY2(dropbox.requestHistorySize() == 3, "history size does not match");
+
+    QSignalSpy finished(&dropbox, SIGNAL(operationFinished(int)));
+    QList<int> numbers;
+    for(int i=0; i<4; ++i)
+    {
+        numbers.append(dropbox.requestMetadata(QString("dropbox/history%1").arg(i)));
+        QTRY_VERIFY2(finished.count() == i+1, "request not finished");
+    }
+
+    QList<qdropbox_request> history = dropbox.requestHistory();
+    QVERIFY2(history.size() == 3, "number of records does not match");
+    QVERIFY2(history.first().number == numbers.at(1) && history.last().number == numbers.at(3),
+             "oldest record not replaced");
+
+    QVERIFY2(dropbox.requestInfo(numbers.at(0)).type == QDROPBOX_REQ_INVALID, "evicted request still known");
+    qdropbox_request retained = dropbox.requestInfo(numbers.at(3));
+    QVERIFY2(retained.type == QDROPBOX_REQ_METADAT, "retained request not known");
+    QVERIFY2(retained.path == "dropbox/history3" && retained.status == 200, "record does not match");
+
+    // shrinking keeps the most recent records
+    dropbox.setRequestHistorySize(2);
+    history = dropbox.requestHistory();
+    QVERIFY2(history.size() == 2 && history.first().number == numbers.at(2), "recent records not kept");
+    QVERIFY2(dropbox.requestInfo(numbers.at(1)).type == QDROPBOX_REQ_INVALID, "evicted request still known");
+
+    dropbox.setRequestHistorySize(0);
+    QVERIFY2(dropbox.requestHistory().isEmpty(), "history not cleared");
+    QVERIFY2(dropbox.requestInfo(numbers.at(3)).type == QDROPBOX_REQ_INVALID, "request of cleared history still known");
+    return;
+}
+
 /**
  * @brief Prompt the user for authorization.
  */
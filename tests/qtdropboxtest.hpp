@@ -5,7 +5,16 @@
 #include <QDesktopServices>
 #include <QThread>
 #include "qtdropbox.h"
+#include "mockdropboxserver.h"
+
+// the app keys are only needed by the tests that connect to Dropbox, they
+// are skipped if tests.pro did not find keys.hpp
+#ifdef QTDROPBOX_TEST_KEYS
 #include "keys.hpp"
+#else
+#define APP_KEY    ""
+#define APP_SECRET ""
+#endif
 
 class QtDropboxTest : public QObject
 {
@@ -32,10 +41,42 @@ private Q_SLOTS:
     void jsonCase13();
     void jsonCase14();
     void jsonCase15();
+    void jsonCase16();
+    void jsonCase17();
+    void jsonCase18();
+    void jsonCase19();
+    void jsonCase20();
 
   /* QDropbox */
     void dropboxCase1();
     void dropboxCase2();
+    void dropboxCase3();
+    void dropboxCase4();
+    void nonceBenchmark_data();
+    void nonceBenchmark();
+
+  /* QDropboxHistogram */
+    void statisticsCase1();
+
+  /* QDropboxTracer */
+    void tracerCase1();
+
+  /* MockDropboxServer */
+    void mockCase1();
+    void mockCase2();
+    void mockCase3();
+    void mockCase4();
+    void mockCase5();
+    void mockCase6();
+    void mockCase7();
+    void mockCase8();
+    void mockCase9();
+    void mockCase10();
+    void mockCase11();
+    void mockCase12();
+    void mockCase13();
+    void mockCase14();
+    void mockCase15();
 
 private:
     void authorizeApplication(QDropbox *d);
@@ -14,13 +14,20 @@ TEMPLATE = app
 
 
 SOURCES += \
-    qtdropboxtest.cpp
+    qtdropboxtest.cpp \
+    mockdropboxserver.cpp
 DEFINES += SRCDIR=\\\"$$PWD/\\\"
 
 HEADERS += \
     qtdropboxtest.hpp \
-    keys.hpp \
-    keys.hpp
+    mockdropboxserver.h
+
+# keys.hpp is not part of the repository (see README.md), without it the
+# tests that connect to Dropbox are skipped
+exists(keys.hpp) {
+    HEADERS += keys.hpp
+    DEFINES += QTDROPBOX_TEST_KEYS
+}
 
 LIBS += -L../../build-qtdropbox-Desktop-Debug
 INCLUDEPATH += ../src/